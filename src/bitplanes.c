@@ -0,0 +1,123 @@
+/* vim:expandtab:ts=2 sw=2:
+*/
+/*  Grafx2 - The Ultimate 256-color bitmap paint program
+
+    Copyright 2026 GrafX2 contributors
+
+    Grafx2 is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; version 2
+    of the License.
+
+    Grafx2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Grafx2; if not, see <http://www.gnu.org/licenses/>
+*/
+
+///@file bitplanes.c
+/// Planar to chunky and chunky to planar conversions.
+///
+/// Planar to chunky uses a lookup table expanding one plane byte to
+/// 8 pixel bytes, so 8 pixels are processed at once for each plane.
+/// Chunky to planar transposes the 8x8 bit matrix formed by 8 pixels
+/// in a 64 bits integer.
+
+#include <string.h>
+#include "struct.h"
+#include "bitplanes.h"
+
+/// For each value of a plane byte, the 8 pixels (0 or 1) in memory order.
+static qword Plane_byte_expand[256];
+static int Plane_byte_expand_ready = 0;
+
+static void Init_plane_byte_expand(void)
+{
+  int b, i;
+
+  for (b = 0; b < 256; b++)
+  {
+    byte pixels[8];
+    for (i = 0; i < 8; i++)
+      pixels[i] = (b >> (7 - i)) & 1;
+    memcpy(&Plane_byte_expand[b], pixels, 8);
+  }
+  Plane_byte_expand_ready = 1;
+}
+
+/**
+ * Transpose a 8x8 bit matrix.
+ *
+ * Row 0 is the most significant byte, and column 0 is the most significant
+ * bit of each byte. See "Hacker's Delight" 7-3.
+ */
+static qword Transpose_8x8(qword x)
+{
+  qword t;
+
+  t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+  x = x ^ t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+  x = x ^ t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+  x = x ^ t ^ (t << 28);
+  return x;
+}
+
+void Planar_to_chunky(const byte * planar, byte * chunky, int width, int nb_planes, int interleave)
+{
+  int n = 0;  // index of byte in the current interleave block
+
+  if (!Plane_byte_expand_ready)
+    Init_plane_byte_expand();
+
+  while (width > 0)
+  {
+    qword pixels;
+    int p;
+
+    pixels = Plane_byte_expand[planar[n]];
+    for (p = 1; p < nb_planes; p++)
+      pixels |= Plane_byte_expand[planar[p * interleave + n]] << p;
+    if (width >= 8)
+      memcpy(chunky, &pixels, 8);
+    else
+      memcpy(chunky, &pixels, width);
+    chunky += 8;
+    width -= 8;
+    if (++n >= interleave)
+    {
+      planar += interleave * nb_planes;
+      n = 0;
+    }
+  }
+}
+
+void Chunky_to_planar(const byte * chunky, byte * planar, int width, int nb_planes, int interleave)
+{
+  int n = 0;  // index of byte in the current interleave block
+
+  while (width > 0)
+  {
+    qword x = 0;
+    int i, p;
+
+    for (i = 0; i < 8 && i < width; i++)
+      x |= (qword)chunky[i] << (56 - 8 * i);
+    if (x != 0)
+      x = Transpose_8x8(x);
+    // now byte p (from the least significant) is plane p
+    for (p = 0; p < nb_planes; p++)
+      planar[p * interleave + n] = (byte)(x >> (8 * p));
+    chunky += 8;
+    width -= 8;
+    if (++n >= interleave)
+    {
+      planar += interleave * nb_planes;
+      n = 0;
+    }
+  }
+}
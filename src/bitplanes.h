@@ -0,0 +1,64 @@
+/* vim:expandtab:ts=2 sw=2:
+*/
+/*  Grafx2 - The Ultimate 256-color bitmap paint program
+
+    Copyright 2026 GrafX2 contributors
+
+    Grafx2 is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; version 2
+    of the License.
+
+    Grafx2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Grafx2; if not, see <http://www.gnu.org/licenses/>
+*/
+
+///@file bitplanes.h
+/// Planar to chunky and chunky to planar conversions.
+///
+/// Bitplanes are used by Amiga (ILBM), Atari ST, PCX, etc.
+/// In each byte of a plane, the leftmost pixel is the most significant bit.
+///
+/// The layout of planes in memory is described by the "interleave" :
+/// the number of consecutive bytes of one plane, before the bytes of the
+/// next plane. Byte n of plane p is at offset :
+/// <tt>(n / interleave) * interleave * nb_planes + p * interleave + (n % interleave)</tt>
+///
+/// - Atari ST screens interleave planes every word : interleave = 2
+/// - ILBM / PCX lines store one full plane line after the other :
+///   interleave = number of bytes of a plane line.
+
+#ifndef BITPLANES_H_INCLUDED
+#define BITPLANES_H_INCLUDED
+
+/**
+ * Planar to chunky conversion.
+ *
+ * @param planar     source bitplanes
+ * @param chunky     destination buffer, one byte per pixel
+ * @param width      number of pixels to convert
+ * @param nb_planes  number of planes, 1 to 8
+ * @param interleave number of bytes of a plane before the next plane
+ */
+void Planar_to_chunky(const byte * planar, byte * chunky, int width, int nb_planes, int interleave);
+
+/**
+ * Chunky to planar conversion.
+ *
+ * Only the nb_planes lower bits of each pixel are used. The unused bits of
+ * the last byte of each plane (when width is not a multiple of 8) are set to 0.
+ *
+ * @param chunky     source buffer, one byte per pixel
+ * @param planar     destination bitplanes
+ * @param width      number of pixels to convert
+ * @param nb_planes  number of planes, 1 to 8
+ * @param interleave number of bytes of a plane before the next plane
+ */
+void Chunky_to_planar(const byte * chunky, byte * planar, int width, int nb_planes, int interleave);
+
+#endif
@@ -254,6 +254,29 @@ void Display_paintbrush(short x,short y,byte color)
   }
 }
 
+/// Display in a single color the pixels of a brush shape which are not
+/// transparent. Each run of opaque pixels is drawn with Display_span().
+static void Display_brush_shape(short x, short y, short width, short height,
+                                const byte * shape, long shape_pitch, byte transp_color, byte color)
+{
+  short i, j, start;
+
+  for (j = 0; j < height; j++, shape += shape_pitch)
+  {
+    for (i = 0; i < width; )
+    {
+      if (shape[i] == transp_color)
+      {
+        i++;
+        continue;
+      }
+      for (start = i; i < width && shape[i] != transp_color; i++)
+        ;
+      Display_span(x + start, y + j, i - start, color);
+    }
+  }
+}
+
 /// Draw the paintbrush in the image buffer
 void Draw_paintbrush(short x,short y,byte color)
   // x,y: position du centre du pinceau
@@ -542,20 +565,13 @@ void Draw_paintbrush(short x,short y,byte color)
       else
       {
         if (Shade_table==Shade_table_left)
-          for (y_pos=start_y,counter_y=start_y_counter;counter_y<end_counter_y;y_pos++,counter_y++)
-            for (x_pos=start_x,counter_x=start_x_counter;counter_x<end_counter_x;x_pos++,counter_x++)
-            {
-              temp_color=Read_pixel_from_brush(counter_x,counter_y);
-              if (temp_color!=Back_color)
-                Display_pixel(x_pos,y_pos,temp_color);
-            }
+          Display_rect_masked(start_x,start_y,width,height,
+                              Brush+start_y_counter*Brush_width+start_x_counter,
+                              Brush_width,Back_color);
         else
-          for (y_pos=start_y,counter_y=start_y_counter;counter_y<end_counter_y;y_pos++,counter_y++)
-            for (x_pos=start_x,counter_x=start_x_counter;counter_x<end_counter_x;x_pos++,counter_x++)
-            {
-              if (Read_pixel_from_brush(counter_x,counter_y)!=Back_color)
-                Display_pixel(x_pos,y_pos,color);
-            }
+          Display_brush_shape(start_x,start_y,width,height,
+                              Brush+start_y_counter*Brush_width+start_x_counter,
+                              Brush_width,Back_color,color);
       }
       Update_part_of_screen(start_x,start_y,width,height);
       break;
@@ -612,12 +628,9 @@ void Draw_paintbrush(short x,short y,byte color)
       }
       else
       {
-        for (y_pos=start_y,counter_y=start_y_counter;counter_y<end_counter_y;y_pos++,counter_y++)
-          for (x_pos=start_x,counter_x=start_x_counter;counter_x<end_counter_x;x_pos++,counter_x++)
-          {
-            if (Read_pixel_from_brush(counter_x,counter_y)!=Back_color)
-              Display_pixel(x_pos,y_pos,color);
-          }
+        Display_brush_shape(start_x,start_y,width,height,
+                            Brush+start_y_counter*Brush_width+start_x_counter,
+                            Brush_width,Back_color,color);
         Update_part_of_screen(start_x,start_y,width,height);
       }
       break;
@@ -676,12 +689,9 @@ void Draw_paintbrush(short x,short y,byte color)
       }
       else
       {
-        for (y_pos=start_y,counter_y=start_y_counter;counter_y<end_counter_y;y_pos++,counter_y++)
-          for (x_pos=start_x,counter_x=start_x_counter;counter_x<end_counter_x;x_pos++,counter_x++)
-          {
-            if (Paintbrush_sprite[(MAX_PAINTBRUSH_SIZE*counter_y)+counter_x] != 0)
-              Display_pixel(x_pos,y_pos,color);
-          }
+        Display_brush_shape(start_x,start_y,width,height,
+                            Paintbrush_sprite+(MAX_PAINTBRUSH_SIZE*start_y_counter)+start_x_counter,
+                            MAX_PAINTBRUSH_SIZE,0,color);
         Update_part_of_screen(start_x,start_y,width,height);
       }
   }
@@ -74,6 +74,7 @@
 #include "input.h"
 #include "special.h"
 #include "tiles.h"
+#include "overview.h"
 #include "setup.h"
 #include "unicode.h"
 #include "keycodes.h"
@@ -794,6 +795,13 @@ const T_Lookup Lookup_SwapButtons[] = {
   {NULL,-1},
 };
 
+const T_Lookup Lookup_PNG_compression[] = {
+  {"Default",0},
+  {"Fast",1},
+  {"Best",2},
+  {NULL,-1},
+};
+
 const T_Lookup Lookup_VirtualKeyboard[] = {
   {"Auto",0},
   {"ON",1},
@@ -967,7 +975,7 @@ void Button_Settings(int btn)
   {"Separate colors:",1,&(selected_config.Separate_colors),0,1,0,Lookup_YesNo},
   {"Safety colors:",1,&(selected_config.Safety_colors),0,1,0,Lookup_YesNo},
   {"Sync views:",1,&(selected_config.Sync_views),0,1,0,Lookup_YesNo},
-  {"",0,NULL,0,0,0,NULL},
+  {"Anim cache (MB):",2,&(selected_config.Animation_cache_size),0,9999,4,NULL},
   {"",0,NULL,0,0,0,NULL},
   {"",0,NULL,0,0,0,NULL},
 
@@ -988,7 +996,7 @@ void Button_Settings(int btn)
 
   {"          --- Editing  ---",0,NULL,0,0,0,NULL},
   {"Adjust brush pick:",1,&(selected_config.Adjust_brush_pick),0,1,0,Lookup_YesNo},
-  {"Undo pages:",1,&(selected_config.Max_undo_pages),1,99,5,NULL},
+  {"Undo pages:",1,&(selected_config.Max_undo_pages),1,255,5,NULL},
   {"Vertices per polygon:",4,&(selected_config.Nb_max_vertices_per_polygon),2,16384,5,NULL},
   {"Fast zoom:",1,&(selected_config.Fast_zoom),0,1,0,Lookup_YesNo},
   {"Clear with stencil:",1,&(selected_config.Clear_with_stencil),0,1,0,Lookup_YesNo},
@@ -996,7 +1004,7 @@ void Button_Settings(int btn)
   {"Auto count colors:",1,&(selected_config.Auto_nb_used),0,1,0,Lookup_YesNo},
   {"Right click colorpick:",1,&(selected_config.Right_click_colorpick),0,1,0,Lookup_YesNo},
   {"Multi shortcuts:",1,&(selected_config.Allow_multi_shortcuts),0,1,0,Lookup_YesNo},
-  {"",0,NULL,0,0,0,NULL},
+  {"Undo memory (MB):",2,&(selected_config.Undo_memory),0,9999,4,NULL},
 
   {"      --- File selector  ---",0,NULL,0,0,0,NULL},
   {"Show in fileselector",0,NULL,0,0,0,NULL},
@@ -1014,8 +1022,8 @@ void Button_Settings(int btn)
   {"Screen size in GIF:",1,&(selected_config.Screen_size_in_GIF),0,1,0,Lookup_YesNo},
   {"Clear palette:",1,&(selected_config.Clear_palette),0,1,0,Lookup_YesNo},
   {"MO6/TO8 palette gamma",1,&(selected_config.MOTO_gamma),10,30,2,NULL},
-  {"",0,NULL,0,0,0,NULL},
-  {"",0,NULL,0,0,0,NULL},
+  {"Optimize GIF anims:",1,&(selected_config.Optimize_GIF_animations),0,1,0,Lookup_YesNo},
+  {"PNG compression:",1,&(selected_config.PNG_compression),0,2,0,Lookup_PNG_compression},
   {"",0,NULL,0,0,0,NULL},
   {"",0,NULL,0,0,0,NULL},
   {"",0,NULL,0,0,0,NULL},
@@ -3981,6 +3989,114 @@ void Button_Unselect_magnifier(int btn)
 }
 
 
+// -- Overview of the whole picture, click to go there ----------------------
+
+#define OVERVIEW_X 8
+#define OVERVIEW_Y 18
+#define OVERVIEW_WIDTH 256
+#define OVERVIEW_HEIGHT 128
+
+void Button_Overview(int btn)
+{
+  short clicked_button;
+  int level;
+  const byte * pixels;
+  word level_width;
+  word level_height;
+  word view_width, view_height;
+  short x_pos, y_pos;
+  short frame_x, frame_y, frame_w, frame_h;
+  int x = 0, y = 0;
+
+  (void)btn;
+  Open_window(OVERVIEW_WIDTH + 16, OVERVIEW_HEIGHT + 38, "Overview");
+
+  Window_set_normal_button((OVERVIEW_WIDTH + 16 - 64) / 2, OVERVIEW_Y + OVERVIEW_HEIGHT + 2,
+                           64, 14, "Close", 0, 1, KEY_ESC); // 1
+  Window_display_frame_in(OVERVIEW_X - 1, OVERVIEW_Y - 1, OVERVIEW_WIDTH + 2, OVERVIEW_HEIGHT + 2);
+  Window_rectangle(OVERVIEW_X, OVERVIEW_Y, OVERVIEW_WIDTH, OVERVIEW_HEIGHT, MC_Black);
+  Window_set_special_button(OVERVIEW_X, OVERVIEW_Y, OVERVIEW_WIDTH, OVERVIEW_HEIGHT, 0); // 2
+
+  // The smallest reduction that fits, only computed again where the
+  // picture changed since last time.
+  level = Overview_level_for_size(Main.image_width, Main.image_height, OVERVIEW_WIDTH, OVERVIEW_HEIGHT);
+  pixels = Overview_get_level(Main_screen, Main.image_width, Main.image_height, level, &level_width, &level_height);
+  x_pos = OVERVIEW_X + (OVERVIEW_WIDTH - level_width) / 2;
+  y_pos = OVERVIEW_Y + (OVERVIEW_HEIGHT - level_height) / 2;
+  if (pixels != NULL)
+  {
+    for (y = 0; y < level_height; y++)
+      for (x = 0; x < level_width; x++)
+        Pixel_in_window(x_pos + x, y_pos + y, pixels[y * level_width + x]);
+
+    // Frame the part of the picture shown in the normal view
+    view_width = Main.magnifier_mode ? Main.separator_position : Screen_width;
+    if (view_width > Main.image_width - Main.offset_X)
+      view_width = Main.image_width - Main.offset_X;
+    view_height = Menu_Y;
+    if (view_height > Main.image_height - Main.offset_Y)
+      view_height = Main.image_height - Main.offset_Y;
+    frame_x = x_pos + (Main.offset_X >> level);
+    frame_y = y_pos + (Main.offset_Y >> level);
+    frame_w = (view_width + (1 << level) - 1) >> level;
+    frame_h = (view_height + (1 << level) - 1) >> level;
+    if (frame_x + frame_w > x_pos + level_width)
+      frame_w = x_pos + level_width - frame_x;
+    if (frame_y + frame_h > y_pos + level_height)
+      frame_h = y_pos + level_height - frame_y;
+    if (frame_w > 0 && frame_h > 0)
+    {
+      Window_rectangle(frame_x, frame_y, frame_w, 1, MC_White);
+      Window_rectangle(frame_x, frame_y + frame_h - 1, frame_w, 1, MC_White);
+      Window_rectangle(frame_x, frame_y, 1, frame_h, MC_White);
+      Window_rectangle(frame_x + frame_w - 1, frame_y, 1, frame_h, MC_White);
+    }
+  }
+
+  Update_window_area(0,0,Window_width, Window_height);
+
+  Display_cursor();
+
+  do
+  {
+    clicked_button=Window_clicked_button();
+    if (clicked_button == 2)
+    {
+      x = ((Mouse_X-Window_pos_X)/Menu_factor_X) - x_pos;
+      y = ((Mouse_Y-Window_pos_Y)/Menu_factor_Y) - y_pos;
+      if (x < 0 || y < 0 || x >= level_width || y >= level_height)
+        clicked_button = 0;
+    }
+    else if (Is_shortcut(Key,SPECIAL_OVERVIEW))
+    {
+      Key=0;
+      clicked_button=1;
+    }
+  }
+  while (clicked_button<=0 && !Quit_is_required);
+
+  Close_window();
+  Display_cursor();
+
+  if (clicked_button == 2)
+  {
+    // Center the view on the middle of the clicked block
+    x = (x << level) + ((1 << level) >> 1);
+    y = (y << level) + ((1 << level) >> 1);
+    if (x >= Main.image_width)
+      x = Main.image_width - 1;
+    if (y >= Main.image_height)
+      y = Main.image_height - 1;
+    if (Main.magnifier_mode)
+      Scroll_magnifier(x - (Main.magnifier_offset_X + (Main.magnifier_width >> 1)),
+                       y - (Main.magnifier_offset_Y + (Main.magnifier_height >> 1)));
+    else
+      Scroll_screen(x - (Main.offset_X + (Screen_width >> 1)),
+                    y - (Main.offset_Y + (Menu_Y >> 1)));
+  }
+}
+
+
 // ----------------------- Modifications de brosse ---------------------------
 
 void Button_Brush_FX(int btn)
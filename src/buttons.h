@@ -497,6 +497,12 @@ void Button_Magnify_menu(int);
 */
 void Button_Unselect_magnifier(int);
 
+/*!
+    Displays a reduced view of the whole picture. Clicking in it moves
+    the view (or the magnifier) there.
+*/
+void Button_Overview(int);
+
 // Les différents effets sur la brosse
 
 /*!
@@ -30,6 +30,7 @@
 #include <string.h>
 
 #include "gfx2log.h"
+#include "gfx2mem.h"
 #include "brush.h"
 #include "buttons.h"
 #include "engine.h"
@@ -432,6 +433,109 @@ static void Convert_to_dhgr(void)
 }
 
 
+/// Tell if Convert_to_constraints() supports a mode
+static int Can_convert_to_constraints(enum IMAGE_MODES mode)
+{
+  switch (mode)
+  {
+    case IMAGE_MODE_ZX:
+    case IMAGE_MODE_THOMSON:
+    case IMAGE_MODE_C64HIRES:
+    case IMAGE_MODE_C64MULTI:
+    case IMAGE_MODE_C64FLI:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/// Convert the colors of the picture to respect the constraints of a mode
+///
+/// The layer checked by Button_Constraint_mode() is converted from the
+/// current palette to the palette of the machine. Thomson pictures are
+/// converted to the TO7/70 palette, the default one of the later machines.
+/// For C64 FLI, the 3 layers are created, and the background colors and
+/// Color RAM found by the conversion are written in the first two layers.
+static void Convert_to_constraints(enum IMAGE_MODES mode, int dither)
+{
+  T_Components target[256];
+  T_Components * source;
+  byte * pixels;
+  int layer = 0;
+  long i, count;
+
+  if (!Can_convert_to_constraints(mode))
+    return;
+  if (mode == IMAGE_MODE_C64FLI && (Main.image_width < 160 || Main.image_height < 200))
+    return; // Button_Constraint_mode() reports the error
+  memset(target, 0, sizeof(target));
+  switch (mode)
+  {
+    case IMAGE_MODE_ZX:
+      ZX_Spectrum_set_palette(target);
+      break;
+    case IMAGE_MODE_THOMSON:
+      MOTO_set_TO7_palette(target);
+      break;
+    case IMAGE_MODE_C64FLI:
+      layer = 2;
+      // fall through
+    default:
+      C64_set_palette(target);
+      break;
+  }
+  count = (long)Main.image_width * Main.image_height;
+  source = (T_Components *)GFX2_malloc(count * sizeof(T_Components));
+  if (source == NULL)
+    return;
+
+  // Backup before the layers are changed, so the whole conversion is undone at once.
+  Backup_layers(mode == IMAGE_MODE_C64FLI ? LAYER_ALL : layer);
+  if (mode == IMAGE_MODE_C64FLI)
+  {
+    // Same layers as Button_Constraint_mode() : background, Color RAM, bitmap
+    if (Main.backups->Pages->Image_mode != IMAGE_MODE_LAYERED)
+      Switch_layer_mode(IMAGE_MODE_LAYERED);
+    Main.backups->Pages->Transparent_color = 16;
+    while (Main.backups->Pages->Nb_layers < 3)
+      if (Add_layer(Main.backups, 0))
+      {
+        // Button_Constraint_mode() reports the error
+        free(source);
+        End_of_modification();
+        return;
+      }
+  }
+  pixels = Main.backups->Pages->Image[layer].Pixels;
+  for (i = 0; i < count; i++)
+    source[i] = Main.palette[pixels[i]];
+  if (mode == IMAGE_MODE_C64FLI)
+  {
+    byte color_ram[1000], background[200];
+    word x, y;
+
+    if (C64_truecolor_to_FLI(pixels, Main.image_width, color_ram, background,
+                             source, Main.image_width, target, dither) == 0)
+    {
+      // Button_Constraint_mode() takes them back from there
+      for (y = 0; y < 200; y++)
+      {
+        for (x = 0; x < 160; x++)
+        {
+          Pixel_in_layer(0, x, y, background[y]);
+          Pixel_in_layer(1, x, y, color_ram[(x >> 2) + (y >> 3)*40]);
+        }
+      }
+    }
+  }
+  else
+    Convert_to_constrained_mode(mode, pixels, Main.image_width,
+                                source, Main.image_width, Main.image_width, Main.image_height,
+                                target, dither);
+  free(source);
+  End_of_modification();
+}
+
 /// Constaint enforcer/checker
 ///
 /// A call toggles between constraint mode and Layered mode.
@@ -578,6 +682,8 @@ void Button_Constraint_menu(void)
   int set_palette = 1;
   int set_pic_size = 0;
   int set_grid = 1;
+  int convert = 0;
+  int dither = 0;
   short clicked_button;
   T_Dropdown_button* dropdown;
   const char * label;
@@ -604,10 +710,10 @@ void Button_Constraint_menu(void)
     {IMAGE_MODE_TMS9918G2,"TMS9918 Mode 2","MSX Screen2, etc.    ", 1},  // 256x192
   };
 
-  Open_window(194,95+36,"8-bit constraints");
+  Open_window(194,95+54,"8-bit constraints");
 
-  Window_set_normal_button(31,71+36,51,14,"Cancel",0,1,KEY_ESC);  // 1
-  Window_set_normal_button(112,71+36,51,14,"OK"    ,0,1,KEY_RETURN); // 2
+  Window_set_normal_button(31,71+54,51,14,"Cancel",0,1,KEY_ESC);  // 1
+  Window_set_normal_button(112,71+54,51,14,"OK"    ,0,1,KEY_RETURN); // 2
 
   label = "Constraints";
   summary = "";
@@ -633,6 +739,12 @@ void Button_Constraint_menu(void)
   Window_set_normal_button(10, 87, 14, 14, set_grid?"X":" ", 0, 1, KEY_g);  // 6
   Print_in_window_underscore(10+18, 87+3, "Enable grid", MC_Dark, MC_Light, 8);
 
+  Window_set_normal_button(10, 105, 14, 14, convert?"X":" ", 0, 1, KEY_c);  // 7
+  Print_in_window_underscore(10+18, 105+3, "Convert", MC_Dark, MC_Light, 1);
+
+  Window_set_normal_button(100, 105, 14, 14, dither?"X":" ", 0, 1, KEY_d);  // 8
+  Print_in_window_underscore(100+18, 105+3, "Dither", MC_Dark, MC_Light, 1);
+
   Update_window_area(0,0,Window_width, Window_height);
   Display_cursor();
 
@@ -660,6 +772,8 @@ void Button_Constraint_menu(void)
         }
       if (Selected_Constraint_Mode == IMAGE_MODE_GBC || Selected_Constraint_Mode == IMAGE_MODE_MEGADRIVE)
         set_palette = 0;
+      if (!Can_convert_to_constraints(Selected_Constraint_Mode))
+        convert = 0;
     }
     else if (clicked_button == 4) // palette
       set_palette = !set_palette;
@@ -667,6 +781,19 @@ void Button_Constraint_menu(void)
       set_pic_size = !set_pic_size;
     else if (clicked_button == 6) // enable grid
       set_grid = !set_grid;
+    else if (clicked_button == 7) // convert colors
+    {
+      if (!convert && !Can_convert_to_constraints(Selected_Constraint_Mode))
+        Warning_message("No conversion for this mode");
+      else
+      {
+        convert = !convert;
+        if (convert)
+          set_palette = 1;  // the converted picture uses the palette of the machine
+      }
+    }
+    else if (clicked_button == 8) // dithering of converted colors
+      dither = !dither;
 
     if (clicked_button > 0) // refresh buttons
     {
@@ -674,6 +801,8 @@ void Button_Constraint_menu(void)
       Print_in_window(10+3, 51+3, set_palette?"X":" ", MC_Black, MC_Light);
       Print_in_window(10+3, 69+3, set_pic_size?"X":" ", MC_Black, MC_Light);
       Print_in_window(10+3, 87+3, set_grid?"X":" ", MC_Black, MC_Light);
+      Print_in_window(10+3, 105+3, convert?"X":" ", MC_Black, MC_Light);
+      Print_in_window(100+3, 105+3, dither?"X":" ", MC_Black, MC_Light);
       Display_cursor();
     }
   }
@@ -736,6 +865,8 @@ void Button_Constraint_menu(void)
       }
       if (Main.backups->Pages->Image_mode > IMAGE_MODE_ANIMATION)
         Button_Constraint_mode();  // unactivate current mode
+      if (convert)
+        Convert_to_constraints(Selected_Constraint_Mode, dither);
       Button_Constraint_mode();  // activate selected Mode
       if (set_grid)
       {
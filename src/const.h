@@ -549,6 +549,7 @@ enum SPECIAL_ACTIONS
   SPECIAL_HOLD_PAN,
   SPECIAL_ZOOM_IN_MORE,
   SPECIAL_ZOOM_OUT_MORE,
+  SPECIAL_OVERVIEW,
   
   NB_SPECIAL_SHORTCUTS            ///< Number of special shortcuts
 };
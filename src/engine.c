@@ -62,6 +62,8 @@
 #define NO_KEYBOARD
 #endif
 
+/// Longest wait for events in the main loop, when nothing is going on (ms)
+#define MAIN_LOOP_IDLE_WAIT 250
 
 // we need this as global
 short Old_MX = -1;
@@ -767,7 +769,10 @@ void Main_handler(void)
       Drop_file_name_unicode=NULL;
     }
     
-    if(Get_input(0))
+    // Wait for events. During an operation, keep calling it regularly:
+    // some are time-driven (airbrush...). A safety backup being written
+    // also continues at each idle iteration.
+    if(Get_input((Operation_stack_size != 0 || Safety_backup_in_progress()) ? 10 : MAIN_LOOP_IDLE_WAIT))
     {
       action = 0;
 
@@ -1463,6 +1468,10 @@ void Main_handler(void)
               case SPECIAL_HOLD_PAN:
                 // already handled by Pan_shortcut_pressed
                 break;
+              case SPECIAL_OVERVIEW:
+                Button_Overview(-1);
+                action++;
+                break;
             }
           }
         } // End of special keys
@@ -1508,10 +1517,9 @@ void Main_handler(void)
     }
     else
     {
-#if defined(USE_SDL) || defined(USE_SDL2)
-      // Removed all SDL_Delay() timing here: relying on Get_input()
-      SDL_Delay(10);
-#endif
+      // Nothing to do : write the safety backup now, between two operations
+      if (Operation_stack_size==0 && Mouse_K==0)
+        Safety_backup_when_idle();
     }
 
     // Gestion de la souris
@@ -92,6 +92,8 @@ static T_Page * Main_backup_page;
 static byte * Main_backup_screen;
 static byte Cursor_is_visible;
 static byte Window_needs_update;
+static byte Main_view_was_altered;
+static byte Spare_view_was_altered;
 
 /// Helper function to clamp a double to 0-255 range
 static byte clamp_byte(double value)
@@ -243,11 +245,27 @@ void Backup_if_necessary(lua_State* L, int layer)
     {
       // Depth buffer etc to modify too ?
 
-      Register_main_writable(L);
+      if (layer == Main.current_layer)
+        Register_main_writable(L);
     }
   }
 }
 
+/// Redraw the composited images after pixels were written through views.
+static void Sync_image_views(void)
+{
+  if (Main_view_was_altered)
+  {
+    Redraw_layered_image();
+    Main_view_was_altered = 0;
+  }
+  if (Spare_view_was_altered)
+  {
+    Redraw_spare_image();
+    Spare_view_was_altered = 0;
+  }
+}
+
 // Wrapper functions to call C from Lua
 
 int L_SetBrushSize(lua_State* L)
@@ -288,18 +306,9 @@ int L_GetBrushSize(lua_State* L)
   return 2;
 }
 
-int L_PutBrushPixel(lua_State* L)
+/// Called before the script writes in the brush for the first time.
+static void Brush_begin_alteration(void)
 {
-  int x;
-  int y;
-  uint8_t c;
-  int nb_args=lua_gettop(L);
-  
-  LUA_ARG_LIMIT (3, "putbrushpixel");
-  LUA_ARG_NUMBER(1, "putbrushpixel", x, INT_MIN, INT_MAX);
-  LUA_ARG_NUMBER(2, "putbrushpixel", y, INT_MIN, INT_MAX);
-  LUA_ARG_NUMBER(3, "putbrushpixel", c, INT_MIN, INT_MAX);
-
   if (!Brush_was_altered)
   {
     int i;
@@ -313,6 +322,21 @@ int L_PutBrushPixel(lua_State* L)
     //--
     Brush_was_altered=1;
   }
+}
+
+int L_PutBrushPixel(lua_State* L)
+{
+  int x;
+  int y;
+  uint8_t c;
+  int nb_args=lua_gettop(L);
+  
+  LUA_ARG_LIMIT (3, "putbrushpixel");
+  LUA_ARG_NUMBER(1, "putbrushpixel", x, INT_MIN, INT_MAX);
+  LUA_ARG_NUMBER(2, "putbrushpixel", y, INT_MIN, INT_MAX);
+  LUA_ARG_NUMBER(3, "putbrushpixel", c, INT_MIN, INT_MAX);
+
+  Brush_begin_alteration();
   
   if (x<0 || y<0 || x>=Brush_width || y>=Brush_height)
   ;
@@ -665,6 +689,7 @@ int L_GetPicturePixel(lua_State* L)
   LUA_ARG_NUMBER(1, "getpicturepixel", x, INT_MIN, INT_MAX);
   LUA_ARG_NUMBER(2, "getpicturepixel", y, INT_MIN, INT_MAX);
   
+  Sync_image_views();
   // Bound check
   if (x<0 || y<0 || x>=Main.image_width || y>=Main.image_height)
   {
@@ -761,6 +786,7 @@ int L_GetSparePicturePixel(lua_State* L)
   LUA_ARG_NUMBER(1, "getsparepicturepixel", x, INT_MIN, INT_MAX);
   LUA_ARG_NUMBER(2, "getsparepicturepixel", y, INT_MIN, INT_MAX);
   
+  Sync_image_views();
   // Some bound checking is done by the function itself, here's the rest.
   if (x<0 || y<0)
   {
@@ -792,6 +818,294 @@ int L_GetSpareTransColor(lua_State* L)
   return 1;
 }
 
+// Image views
+
+/// Name of the metatable shared by all image view userdata.
+#define IMAGE_VIEW_METATABLE "grafx2.imageview"
+
+/// Pixel buffers that can be accessed through an image view.
+enum IMAGE_VIEW_TARGET
+{
+  IMAGE_VIEW_LAYER,       ///< A layer of the main page
+  IMAGE_VIEW_SPARE_LAYER, ///< A layer of the spare page
+  IMAGE_VIEW_BRUSH,       ///< The brush
+};
+
+///
+/// Lua userdata giving direct access to the pixels of a layer or of the brush.
+///
+/// Only the target is stored: the pixel buffer is looked up on each access,
+/// because it can be re-allocated during the script (backup, resize...)
+typedef struct
+{
+  enum IMAGE_VIEW_TARGET target;
+  int layer;
+} T_Image_view;
+
+///
+/// Get the pixel buffer of a view, and its dimensions.
+/// When for_writing is set, the buffer is made safe to modify : the main
+/// page is backed up if necessary, so the script's changes can be undone.
+static byte * Image_view_pixels(lua_State* L, T_Image_view * view, int for_writing, int * width, int * height)
+{
+  switch (view->target)
+  {
+    case IMAGE_VIEW_LAYER:
+      if (view->layer >= Main.backups->Pages->Nb_layers)
+      {
+        luaL_error(L, "imageview: Layer %d doesn't exist anymore.", view->layer);
+        return NULL;
+      }
+      if (for_writing)
+      {
+        if (!Is_backed_up && view->layer != Main.current_layer)
+        {
+          Backup_if_necessary(L, view->layer);
+          // getbackuppixel() reads the composited image, which will be
+          // redrawn from the altered layer : make it read the backup instead.
+          Main_backup_page = Main.backups->Pages->Next;
+          Main_backup_screen = Screen_backup;
+        }
+        else
+          Backup_if_necessary(L, view->layer);
+        Main_view_was_altered = 1;
+        Invalidate_cell_summaries();
+      }
+      *width = Main.image_width;
+      *height = Main.image_height;
+      return Main.backups->Pages->Image[view->layer].Pixels;
+    case IMAGE_VIEW_SPARE_LAYER:
+      if (view->layer >= Spare.backups->Pages->Nb_layers)
+      {
+        luaL_error(L, "imageview: Spare layer %d doesn't exist anymore.", view->layer);
+        return NULL;
+      }
+      // The spare is backed up at the start of the script.
+      if (for_writing)
+        Spare_view_was_altered = 1;
+      *width = Spare.image_width;
+      *height = Spare.image_height;
+      return Spare.backups->Pages->Image[view->layer].Pixels;
+    case IMAGE_VIEW_BRUSH:
+    default:
+      if (for_writing)
+        Brush_begin_alteration();
+      *width = Brush_width;
+      *height = Brush_height;
+      return Brush;
+  }
+}
+
+/// Create a new image view userdata on top of the Lua stack.
+static void Push_image_view(lua_State* L, enum IMAGE_VIEW_TARGET target, int layer)
+{
+  T_Image_view * view;
+
+  view = (T_Image_view *)lua_newuserdata(L, sizeof(T_Image_view));
+  view->target = target;
+  view->layer = layer;
+  luaL_getmetatable(L, IMAGE_VIEW_METATABLE);
+  lua_setmetatable(L, -2);
+}
+
+/// view:get(x, y) : returns the color of a pixel.
+static int L_ImageView_get(lua_State* L)
+{
+  T_Image_view * view = (T_Image_view *)luaL_checkudata(L, 1, IMAGE_VIEW_METATABLE);
+  lua_Integer x = luaL_checkinteger(L, 2);
+  lua_Integer y = luaL_checkinteger(L, 3);
+  int w, h;
+  byte * pixels = Image_view_pixels(L, view, 0, &w, &h);
+
+  if (x<0 || y<0 || x>=w || y>=h)
+    return luaL_error(L, "get: Pixel (%d,%d) is out of the image.", (int)x, (int)y);
+  lua_pushinteger(L, pixels[x + y * w]);
+  return 1;
+}
+
+/// view:set(x, y, color) : writes a pixel.
+static int L_ImageView_set(lua_State* L)
+{
+  T_Image_view * view = (T_Image_view *)luaL_checkudata(L, 1, IMAGE_VIEW_METATABLE);
+  lua_Integer x = luaL_checkinteger(L, 2);
+  lua_Integer y = luaL_checkinteger(L, 3);
+  byte c = (byte)luaL_checkinteger(L, 4);
+  int w, h;
+  byte * pixels;
+
+  // Check first, so that a bad call doesn't create an undo step
+  Image_view_pixels(L, view, 0, &w, &h);
+  if (x<0 || y<0 || x>=w || y>=h)
+    return luaL_error(L, "set: Pixel (%d,%d) is out of the image.", (int)x, (int)y);
+  pixels = Image_view_pixels(L, view, 1, &w, &h);
+  pixels[x + y * w] = c;
+  return 0;
+}
+
+/// view:getrow(y) : returns a whole line of pixels, as a string of bytes.
+static int L_ImageView_getrow(lua_State* L)
+{
+  T_Image_view * view = (T_Image_view *)luaL_checkudata(L, 1, IMAGE_VIEW_METATABLE);
+  lua_Integer y = luaL_checkinteger(L, 2);
+  int w, h;
+  byte * pixels = Image_view_pixels(L, view, 0, &w, &h);
+
+  if (y<0 || y>=h)
+    return luaL_error(L, "getrow: Line %d is out of the image.", (int)y);
+  lua_pushlstring(L, (const char *)(pixels + y * w), w);
+  return 1;
+}
+
+/// view:setrow(y, bytes [, x]) : writes a string of bytes in a line, starting at x (default 0).
+/// All the bytes must fit in the line.
+static int L_ImageView_setrow(lua_State* L)
+{
+  T_Image_view * view = (T_Image_view *)luaL_checkudata(L, 1, IMAGE_VIEW_METATABLE);
+  lua_Integer y = luaL_checkinteger(L, 2);
+  size_t len;
+  const char * bytes = luaL_checklstring(L, 3, &len);
+  lua_Integer x = luaL_optinteger(L, 4, 0);
+  int w, h;
+  byte * pixels;
+
+  // Check first, so that a bad call doesn't create an undo step
+  Image_view_pixels(L, view, 0, &w, &h);
+  if (y<0 || y>=h)
+    return luaL_error(L, "setrow: Line %d is out of the image.", (int)y);
+  if (x<0 || x>w || len > (size_t)(w - x))
+    return luaL_error(L, "setrow: %d bytes at %d don't fit in a line of %d pixels.", (int)len, (int)x, w);
+  pixels = Image_view_pixels(L, view, 1, &w, &h);
+  memcpy(pixels + y * w + x, bytes, len);
+  return 0;
+}
+
+/// view[i] : pixel at linear offset i (x + y*width), or a field/method.
+static int L_ImageView_index(lua_State* L)
+{
+  T_Image_view * view = (T_Image_view *)luaL_checkudata(L, 1, IMAGE_VIEW_METATABLE);
+  int w, h;
+  byte * pixels;
+
+  if (lua_type(L, 2) == LUA_TNUMBER)
+  {
+    lua_Integer i = lua_tointeger(L, 2);
+
+    pixels = Image_view_pixels(L, view, 0, &w, &h);
+    if (i < 0 || i >= (lua_Integer)w * h)
+      return luaL_error(L, "imageview: Index %d is out of the image.", (int)i);
+    lua_pushinteger(L, pixels[i]);
+    return 1;
+  }
+  if (lua_type(L, 2) == LUA_TSTRING)
+  {
+    const char * key = lua_tostring(L, 2);
+
+    if (!strcmp(key, "width") || !strcmp(key, "height"))
+    {
+      Image_view_pixels(L, view, 0, &w, &h);
+      lua_pushinteger(L, key[0] == 'w' ? w : h);
+      return 1;
+    }
+    if (!strcmp(key, "layer"))
+    {
+      if (view->target == IMAGE_VIEW_BRUSH)
+        lua_pushnil(L);
+      else
+        lua_pushinteger(L, view->layer);
+      return 1;
+    }
+    // methods
+    lua_getmetatable(L, 1);
+    lua_pushvalue(L, 2);
+    lua_rawget(L, -2);
+    return 1;
+  }
+  lua_pushnil(L);
+  return 1;
+}
+
+/// view[i] = color : writes the pixel at linear offset i (x + y*width).
+static int L_ImageView_newindex(lua_State* L)
+{
+  T_Image_view * view = (T_Image_view *)luaL_checkudata(L, 1, IMAGE_VIEW_METATABLE);
+  lua_Integer i = luaL_checkinteger(L, 2);
+  byte c = (byte)luaL_checkinteger(L, 3);
+  int w, h;
+  byte * pixels;
+
+  // Check first, so that a bad call doesn't create an undo step
+  Image_view_pixels(L, view, 0, &w, &h);
+  if (i < 0 || i >= (lua_Integer)w * h)
+    return luaL_error(L, "imageview: Index %d is out of the image.", (int)i);
+  pixels = Image_view_pixels(L, view, 1, &w, &h);
+  pixels[i] = c;
+  return 0;
+}
+
+/// #view : number of pixels.
+static int L_ImageView_len(lua_State* L)
+{
+  T_Image_view * view = (T_Image_view *)luaL_checkudata(L, 1, IMAGE_VIEW_METATABLE);
+  int w, h;
+
+  Image_view_pixels(L, view, 0, &w, &h);
+  lua_pushinteger(L, (lua_Integer)w * h);
+  return 1;
+}
+
+/// Create the metatable of image views.
+static void Register_image_view(lua_State* L)
+{
+  luaL_newmetatable(L, IMAGE_VIEW_METATABLE);
+  lua_pushcfunction(L, L_ImageView_index);
+  lua_setfield(L, -2, "__index");
+  lua_pushcfunction(L, L_ImageView_newindex);
+  lua_setfield(L, -2, "__newindex");
+  lua_pushcfunction(L, L_ImageView_len);
+  lua_setfield(L, -2, "__len");
+  lua_pushcfunction(L, L_ImageView_get);
+  lua_setfield(L, -2, "get");
+  lua_pushcfunction(L, L_ImageView_set);
+  lua_setfield(L, -2, "set");
+  lua_pushcfunction(L, L_ImageView_getrow);
+  lua_setfield(L, -2, "getrow");
+  lua_pushcfunction(L, L_ImageView_setrow);
+  lua_setfield(L, -2, "setrow");
+  lua_pop(L, 1);
+}
+
+int L_GetLayerView(lua_State* L)
+{
+  int layer = Main.current_layer;
+  int nb_args=lua_gettop(L);
+
+  if (nb_args > 0)
+    LUA_ARG_NUMBER(1, "getlayerview", layer, 0, Main.backups->Pages->Nb_layers - 1);
+  Push_image_view(L, IMAGE_VIEW_LAYER, layer);
+  return 1;
+}
+
+int L_GetSpareLayerView(lua_State* L)
+{
+  int layer = Spare.current_layer;
+  int nb_args=lua_gettop(L);
+
+  if (nb_args > 0)
+    LUA_ARG_NUMBER(1, "getsparelayerview", layer, 0, Spare.backups->Pages->Nb_layers - 1);
+  Push_image_view(L, IMAGE_VIEW_SPARE_LAYER, layer);
+  return 1;
+}
+
+int L_GetBrushView(lua_State* L)
+{
+  int nb_args=lua_gettop(L);
+
+  LUA_ARG_LIMIT (0, "getbrushview");
+  Push_image_view(L, IMAGE_VIEW_BRUSH, 0);
+  return 1;
+}
+
+
 
 int L_SetColor(lua_State* L)
 {
@@ -1860,6 +2174,7 @@ int L_UpdateScreen(lua_State* L)
   LUA_ARG_LIMIT (0, "updatescreen");
   
   Update_colors_during_script();
+  Sync_image_views();
   if (Cursor_is_visible)
     Hide_cursor();
   Display_all_screen();
@@ -1973,6 +2288,7 @@ int L_FinalizePicture(lua_State* L)
   LUA_ARG_LIMIT (0, "finalizepicture");
   
   Update_colors_during_script();
+  Sync_image_views();
   if (Is_backed_up)
   {
     End_of_modification();
@@ -2435,6 +2751,12 @@ void Run_script(const char *script_subdirectory, const char *script_filename)
   lua_register(L,"getsparelayerpixel",L_GetSpareLayerPixel);
   lua_register(L,"getsparepicturepixel",L_GetSparePicturePixel);
 
+  // Direct access to pixel buffers
+  Register_image_view(L);
+  lua_register(L,"getlayerview",L_GetLayerView);
+  lua_register(L,"getsparelayerview",L_GetSpareLayerView);
+  lua_register(L,"getbrushview",L_GetBrushView);
+
   // Sizes
   lua_register(L,"setbrushsize",L_SetBrushSize);
   lua_register(L,"setpicturesize",L_SetPictureSize);
@@ -2520,6 +2842,8 @@ void Run_script(const char *script_subdirectory, const char *script_filename)
 
   Palette_has_changed=0;
   Brush_was_altered=0;
+  Main_view_was_altered=0;
+  Spare_view_was_altered=0;
   Original_back_color=Back_color;
   Original_fore_color=Fore_color;
 
@@ -2568,6 +2892,7 @@ void Run_script(const char *script_subdirectory, const char *script_filename)
   free(Brush_backup);
   Brush_backup=NULL;
   Update_colors_during_script();
+  Sync_image_views();
   if (Is_backed_up)
     End_of_modification();
 	Print_in_menu("                        ",0);
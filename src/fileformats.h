@@ -51,6 +51,34 @@ void Test_GIF(T_IO_Context *, FILE *);
 void Load_GIF(T_IO_Context *);
 void Save_GIF(T_IO_Context *);
 
+/// GIF file being saved in several steps
+typedef struct T_GIF_writer T_GIF_writer;
+
+/**
+ * Start saving a GIF file : open it and write the header.
+ *
+ * The pixels of the layers are read by Save_GIF_step(), so they must not
+ * change until Save_GIF_end().
+ * @return the writer, or NULL in case of error (File_error is set)
+ */
+T_GIF_writer * Save_GIF_start(T_IO_Context * context);
+
+/**
+ * Write a part of the GIF file.
+ *
+ * @param writer the writer returned by Save_GIF_start()
+ * @param count  approximate number of pixels to compress
+ * @return 1 when the file is complete or in case of error, 0 if there is more to write
+ */
+int Save_GIF_step(T_GIF_writer * writer, long count);
+
+/**
+ * Close a GIF file and free the writer.
+ *
+ * An incomplete file is removed, and File_error is set.
+ */
+void Save_GIF_end(T_GIF_writer * writer);
+
 // -- PCX -------------------------------------------------------------------
 void Test_PCX(T_IO_Context *, FILE *);
 void Load_PCX(T_IO_Context *);
@@ -19,6 +19,15 @@
     along with Grafx2; if not, see <http://www.gnu.org/licenses/>
 */
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+// Scratch files need posix_fallocate(), not available on OpenBSD and macOS
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__)
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#define USE_SCRATCH_FILES
+#endif
 #include "gfx2mem.h"
 #include "gfx2log.h"
 
@@ -41,3 +50,112 @@ int GFX2_is_mem_filled_with(const void * p, unsigned char b, size_t len)
   }
   return 1;
 }
+
+/// Header of the buffers allocated by GFX2_malloc_large()
+typedef union
+{
+  size_t Mapped_size; ///< size of the mapping, or 0 for malloc()ed memory
+  double Align;
+} T_Large_header;
+
+#ifdef USE_SCRATCH_FILES
+static char * Scratch_directory = NULL;
+#endif
+
+void GFX2_set_scratch_directory(const char * directory)
+{
+#ifdef USE_SCRATCH_FILES
+  free(Scratch_directory);
+  Scratch_directory = (directory != NULL) ? strdup(directory) : NULL;
+#else
+  (void)directory;
+#endif
+}
+
+#ifdef USE_SCRATCH_FILES
+/// Map a new scratch file in memory.
+/// @return NULL if it failed, the caller then uses malloc()
+static T_Large_header * Map_scratch_file(size_t size)
+{
+  char * path;
+  size_t len;
+  int fd;
+  int err;
+  void * p;
+
+  if (Scratch_directory == NULL)
+    return NULL;
+  len = strlen(Scratch_directory);
+  path = malloc(len + 32);
+  if (path == NULL)
+    return NULL;
+  snprintf(path, len + 32, "%s%sgrafx2-scratch-XXXXXX", Scratch_directory,
+           (len > 0 && Scratch_directory[len - 1] == '/') ? "" : "/");
+  fd = mkstemp(path);
+  if (fd < 0)
+  {
+    GFX2_Log(GFX2_WARNING, "Cannot create scratch file %s\n", path);
+    free(path);
+    return NULL;
+  }
+  // Nobody else needs to open it : the file disappears with the mapping
+  unlink(path);
+  free(path);
+  // Reserve the disk blocks : writing to a hole of a sparse file when the
+  // disk is full would kill the program with SIGBUS.
+  err = posix_fallocate(fd, 0, (off_t)size);
+  if (err != 0)
+  {
+    GFX2_Log(GFX2_WARNING, "Cannot reserve %lu bytes for a scratch file : %s\n",
+             (unsigned long)size, strerror(err));
+    close(fd);
+    return NULL;
+  }
+  p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return NULL;
+  GFX2_Log(GFX2_DEBUG, "%lu bytes mapped from a scratch file\n", (unsigned long)size);
+  return (T_Large_header *)p;
+}
+#endif
+
+void * GFX2_malloc_large(size_t size)
+{
+  T_Large_header * header = NULL;
+
+  size += sizeof(T_Large_header);
+#ifdef USE_SCRATCH_FILES
+  if (size >= GFX2_SCRATCH_MIN_SIZE)
+  {
+    header = Map_scratch_file(size);
+    if (header != NULL)
+    {
+      header->Mapped_size = size;
+      return header + 1;
+    }
+  }
+#endif
+  header = GFX2_malloc(size);
+  if (header == NULL)
+    return NULL;
+  header->Mapped_size = 0;
+  return header + 1;
+}
+
+void GFX2_free_large(void * p)
+{
+  T_Large_header * header;
+
+  if (p == NULL)
+    return;
+  header = ((T_Large_header *)p) - 1;
+#ifdef USE_SCRATCH_FILES
+  if (header->Mapped_size != 0)
+  {
+    munmap(header, header->Mapped_size);
+    return;
+  }
+#endif
+  free(header);
+}
@@ -30,4 +30,23 @@ void * GFX2_malloc_and_log(size_t size, const char * file, unsigned line);
 /// checks if a memory zone is filled with the same byte value
 int GFX2_is_mem_filled_with(const void * p, unsigned char b, size_t len);
 
+/// Buffers at least this big are kept in a scratch file when possible.
+#define GFX2_SCRATCH_MIN_SIZE (64UL*1024*1024)
+
+/// Set the directory where the scratch files are created.
+void GFX2_set_scratch_directory(const char * directory);
+
+/// Allocate memory for a big picture buffer, and log in case of error.
+///
+/// Buffers of at least ::GFX2_SCRATCH_MIN_SIZE bytes are mapped from a
+/// deleted scratch file, so the system can write the parts which are not
+/// used back to disk instead of swapping. The memory is filled with 0 in
+/// that case only. The disk space is reserved when the file is created,
+/// if it is not available the buffer is allocated with malloc() instead.
+/// Free it with GFX2_free_large().
+void * GFX2_malloc_large(size_t size);
+
+/// Free memory allocated by GFX2_malloc_large()
+void GFX2_free_large(void * p);
+
 #endif
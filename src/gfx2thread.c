@@ -0,0 +1,145 @@
+/* vim:expandtab:ts=2 sw=2:
+*/
+/*  Grafx2 - The Ultimate 256-color bitmap paint program
+
+    Copyright 2026 GrafX2 contributors
+
+    Grafx2 is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; version 2
+    of the License.
+
+    Grafx2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Grafx2; if not, see <http://www.gnu.org/licenses/>
+*/
+
+///@file gfx2thread.c
+/// Worker threads : SDL threads, Windows threads or POSIX threads.
+
+#include <stdlib.h>
+#if defined(USE_SDL) || defined(USE_SDL2)
+#include <SDL.h>
+#include <SDL_thread.h>
+#endif
+#if defined(WIN32)
+#include <windows.h>
+#elif defined(__linux__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__) || defined(__macosx__)
+#include <unistd.h>
+#include <pthread.h>
+#define USE_PTHREAD
+#endif
+#include "gfx2thread.h"
+#include "gfx2mem.h"
+
+struct T_GFX2_Thread
+{
+  Func_thread Func;
+  void * Data;
+  int Result;
+#if defined(USE_SDL) || defined(USE_SDL2)
+  SDL_Thread * Thread;
+#elif defined(WIN32)
+  HANDLE Thread;
+#elif defined(USE_PTHREAD)
+  pthread_t Thread;
+#endif
+};
+
+#if defined(USE_SDL) || defined(USE_SDL2)
+static int SDLCALL Thread_main(void * p)
+{
+  T_GFX2_Thread * thread = (T_GFX2_Thread *)p;
+
+  return thread->Func(thread->Data);
+}
+#elif defined(WIN32)
+static DWORD WINAPI Thread_main(LPVOID p)
+{
+  T_GFX2_Thread * thread = (T_GFX2_Thread *)p;
+
+  thread->Result = thread->Func(thread->Data);
+  return 0;
+}
+#elif defined(USE_PTHREAD)
+static void * Thread_main(void * p)
+{
+  T_GFX2_Thread * thread = (T_GFX2_Thread *)p;
+
+  thread->Result = thread->Func(thread->Data);
+  return NULL;
+}
+#endif
+
+T_GFX2_Thread * GFX2_Thread_create(Func_thread func, void * data)
+{
+#if defined(USE_SDL) || defined(USE_SDL2) || defined(WIN32) || defined(USE_PTHREAD)
+  T_GFX2_Thread * thread = (T_GFX2_Thread *)GFX2_malloc(sizeof(T_GFX2_Thread));
+
+  if (thread == NULL)
+    return NULL;
+  thread->Func = func;
+  thread->Data = data;
+  thread->Result = 0;
+#if defined(USE_SDL2)
+  thread->Thread = SDL_CreateThread(Thread_main, "GrafX2 worker", thread);
+  if (thread->Thread != NULL)
+    return thread;
+#elif defined(USE_SDL)
+  thread->Thread = SDL_CreateThread(Thread_main, thread);
+  if (thread->Thread != NULL)
+    return thread;
+#elif defined(WIN32)
+  thread->Thread = CreateThread(NULL, 0, Thread_main, thread, 0, NULL);
+  if (thread->Thread != NULL)
+    return thread;
+#else
+  if (pthread_create(&thread->Thread, NULL, Thread_main, thread) == 0)
+    return thread;
+#endif
+  free(thread);
+#else
+  (void)func;
+  (void)data;
+#endif
+  return NULL;
+}
+
+int GFX2_Thread_wait(T_GFX2_Thread * thread)
+{
+  int result;
+
+#if defined(USE_SDL) || defined(USE_SDL2)
+  SDL_WaitThread(thread->Thread, &thread->Result);
+#elif defined(WIN32)
+  WaitForSingleObject(thread->Thread, INFINITE);
+  CloseHandle(thread->Thread);
+#elif defined(USE_PTHREAD)
+  pthread_join(thread->Thread, NULL);
+#endif
+  result = thread->Result;
+  free(thread);
+  return result;
+}
+
+int GFX2_CPU_count(void)
+{
+#if defined(USE_SDL2)
+  return SDL_GetCPUCount();
+#elif defined(WIN32)
+  SYSTEM_INFO info;
+
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+#elif defined(USE_PTHREAD) && defined(_SC_NPROCESSORS_ONLN)
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return (count > 0) ? (int)count : 1;
+#else
+  return 1;
+#endif
+}
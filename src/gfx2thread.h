@@ -0,0 +1,55 @@
+/* vim:expandtab:ts=2 sw=2:
+*/
+/*  Grafx2 - The Ultimate 256-color bitmap paint program
+
+    Copyright 2026 GrafX2 contributors
+
+    Grafx2 is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; version 2
+    of the License.
+
+    Grafx2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Grafx2; if not, see <http://www.gnu.org/licenses/>
+*/
+
+///@file gfx2thread.h
+/// Worker threads, to compress independent data on several cores.
+///
+/// On the platforms without threads, GFX2_Thread_create() returns NULL and
+/// the caller does the work itself.
+
+#ifndef GFX2THREAD_H_INCLUDED
+#define GFX2THREAD_H_INCLUDED
+
+/// A running thread
+typedef struct T_GFX2_Thread T_GFX2_Thread;
+
+/// Function run by a thread
+typedef int (* Func_thread)(void * data);
+
+/**
+ * Start a thread.
+ *
+ * @param func function to run
+ * @param data its argument
+ * @return the thread, or NULL if threads are not available
+ */
+T_GFX2_Thread * GFX2_Thread_create(Func_thread func, void * data);
+
+/**
+ * Wait for the end of a thread, and free it.
+ *
+ * @return the value returned by the function of the thread
+ */
+int GFX2_Thread_wait(T_GFX2_Thread * thread);
+
+/// Number of threads worth running at the same time
+int GFX2_CPU_count(void);
+
+#endif
@@ -27,6 +27,7 @@
 ///@file giformat.c
 /// Saving and loading GIF
 
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include "struct.h"
@@ -34,8 +35,10 @@
 #include "oldies.h"
 #include "io.h"
 #include "loadsave.h"
+#include "fileformats.h"
 #include "loadsavefuncs.h"
 #include "gfx2mem.h"
+#include "gfx2thread.h"
 #include "gfx2log.h"
 
 #ifndef MIN
@@ -771,608 +774,947 @@ void Load_GIF(T_IO_Context * context)
 
 // -- Sauver un fichier au format GIF ---------------------------------------
 
-/// Flush the buffer
-static void GIF_empty_buffer(FILE * file, T_GIF_context *gif, byte * GIF_buffer)
+/// A layer of a GIF file being saved : its pixels, the state of the LZW
+/// compressor, and its data waiting to be written in the file.
+///
+/// The layers don't depend on each other once their pixels are copied,
+/// so several of them can be compressed at the same time.
+typedef struct
+{
+  T_GIF_IDB IDB;
+  byte * Pixels;          ///< copy of the image block, NULL if the layer is not started
+  T_GIF_context GIF;
+  byte Buffer[256];       ///< block of compressed data being filled
+  dword * Hash_key;       ///< Strings of the alphabet : prefix code << 8 | suffix
+  word * Hash_code;       ///< Codes of the strings in Hash_key
+  word Alphabet_free;     ///< Position libre dans l'alphabet
+  word Alphabet_max;      ///< Nombre d'entrées possibles dans l'alphabet
+  word Current_string;    ///< Code de la chaîne en cours de traitement
+  word Clear;             ///< LZW clear code
+  byte * Output;          ///< Graphic Control Extension, Image Descriptor and compressed data
+  long Output_size;
+  long Output_capacity;
+  byte Error;             ///< failed to allocate Output
+} T_GIF_layer;
+
+/// Append bytes to the data of a layer
+static void GIF_output(T_GIF_layer * layer, const byte * data, long size)
 {
-  if (gif->remainder_byte)
+  if (layer->Output_size + size > layer->Output_capacity)
   {
-    GIF_buffer[0] = gif->remainder_byte;
+    long capacity = layer->Output_capacity * 2 + size + 4096;
+    byte * output = (byte *)realloc(layer->Output, capacity);
 
-    if (!Write_bytes(file, GIF_buffer, (size_t)gif->remainder_byte + 1))
-      File_error = 1;
+    if (output == NULL)
+    {
+      layer->Error = 1;
+      return;
+    }
+    layer->Output = output;
+    layer->Output_capacity = capacity;
+  }
+  memcpy(layer->Output + layer->Output_size, data, size);
+  layer->Output_size += size;
+}
 
-    gif->remainder_byte = 0;
+/// Flush the buffer
+static void GIF_empty_buffer(T_GIF_layer * layer)
+{
+  if (layer->GIF.remainder_byte)
+  {
+    layer->Buffer[0] = layer->GIF.remainder_byte;
+    GIF_output(layer, layer->Buffer, (long)layer->GIF.remainder_byte + 1);
+    layer->GIF.remainder_byte = 0;
   }
 }
 
 /// Write a code (GIF_nb_bits bits)
-static void GIF_set_code(FILE * GIF_file, T_GIF_context * gif, byte * GIF_buffer, word Code)
+static void GIF_set_code(T_GIF_layer * layer, word Code)
 {
-  word nb_bits_to_process = gif->nb_bits;
-  word nb_bits_processed  =0;
-  word current_nb_bits;
+  T_GIF_context * gif = &layer->GIF;
+  // the pending bits of last_byte, followed by the code
+  dword bits = gif->last_byte | ((dword)Code << gif->remainder_bits);
+  word nb_bits = gif->remainder_bits + gif->nb_bits;
 
-  while (nb_bits_to_process)
+  while (nb_bits >= 8)
   {
-    current_nb_bits = (nb_bits_to_process <= (8-gif->remainder_bits)) ?
-                          nb_bits_to_process: (8-gif->remainder_bits);
+    // Ecrire l'octet à balancer:
+    layer->Buffer[++(gif->remainder_byte)] = (byte)bits;
 
-    gif->last_byte |= (Code & ((1<<current_nb_bits)-1))<<gif->remainder_bits;
-    Code>>=current_nb_bits;
-    gif->remainder_bits    +=current_nb_bits;
-    nb_bits_processed  +=current_nb_bits;
-    nb_bits_to_process-=current_nb_bits;
+    // Si on a atteint la fin du bloc de Raster Data
+    if (gif->remainder_byte==255)
+      // On doit vider le buffer qui est maintenant plein
+      GIF_empty_buffer(layer);
 
-    if (gif->remainder_bits==8) // Il ne reste plus de bits à coder sur l'octet courant
-    {
-      // Ecrire l'octet à balancer:
-      GIF_buffer[++(gif->remainder_byte)] = gif->last_byte;
+    bits >>= 8;
+    nb_bits -= 8;
+  }
+  gif->last_byte = (byte)bits;
+  gif->remainder_bits = nb_bits;
+}
 
-      // Si on a atteint la fin du bloc de Raster Data
-      if (gif->remainder_byte==255)
-        // On doit vider le buffer qui est maintenant plein
-        GIF_empty_buffer(GIF_file, gif, GIF_buffer);
 
-      gif->last_byte=0;
-      gif->remainder_bits=0;
-    }
-  }
+/// Size of the hash table of the LZW compressor : a prime number, 20%
+/// larger than the 4096 codes
+#define GIF_HASH_SIZE 5003
+/// Empty entry of the hash table
+#define GIF_HASH_EMPTY 0xFFFFFFFF
+
+/// Reset the hash table of the LZW compressor
+static void GIF_clear_hash(dword * hash_key)
+{
+  memset(hash_key, 0xFF, GIF_HASH_SIZE * sizeof(dword));
 }
 
+/// Look for a string (prefix code + character) in the hash table of the
+/// LZW compressor.
+///
+/// @return the position of the string, or of the empty entry where to add it
+static int GIF_find_hash(const dword * hash_key, dword key, word prefix, byte suffix)
+{
+  int position = (suffix << 4) ^ prefix; // always < GIF_HASH_SIZE
+  int step = (position == 0) ? 1 : GIF_HASH_SIZE - position;
+
+  while (hash_key[position] != key && hash_key[position] != GIF_HASH_EMPTY)
+  {
+    position -= step;
+    if (position < 0)
+      position += GIF_HASH_SIZE;
+  }
+  return position;
+}
 
-/// Read the next pixel
-static byte GIF_next_pixel(T_IO_Context *context, T_GIF_context *gif, T_GIF_IDB *idb)
+/// Read the next pixel of the image block
+static byte GIF_next_pixel(const byte * pixels, T_GIF_context *gif, T_GIF_IDB *idb)
 {
   byte temp;
 
-  temp = Get_pixel(context, gif->pos_X, gif->pos_Y);
+  temp = pixels[(long)gif->pos_Y * idb->Image_width + gif->pos_X];
 
-  if (++gif->pos_X >= (idb->Image_width + idb->Pos_X))
+  if (++gif->pos_X >= idb->Image_width)
   {
-    gif->pos_X = idb->Pos_X;
-    if (++gif->pos_Y >= (idb->Image_height + idb->Pos_Y))
+    gif->pos_X = 0;
+    if (++gif->pos_Y >= idb->Image_height)
       gif->stop = 1;
   }
 
   return temp;
 }
 
+/// Pixels of an animation frame compared with the previous one
+typedef struct
+{
+  const byte * Frame;    ///< pixels of the frame
+  const byte * Previous; ///< pixels of the previous frame, NULL if the frame is not drawn over it
+  long Pitch;            ///< distance between 2 lines, in both buffers
+  int Check_backcol;     ///< pixels of the background color don't need to be saved
+  byte Backcol;          ///< background color
+} T_GIF_frame_delta;
+
+/// Tells if a pixel differs from the previous frame and from the background
+static int GIF_Pixel_needed(const T_GIF_frame_delta * delta, const byte * row, const byte * previous, int x)
+{
+  if (previous != NULL && row[x] == previous[x])
+    return 0;
+  if (delta->Check_backcol && row[x] == delta->Backcol)
+    return 0;
+  return 1;
+}
 
-/// Save a GIF file
-void Save_GIF(T_IO_Context * context)
+/// Look for the first pixel to save in the range [from, to[ of a line.
+/// Unchanged pixels are skipped 8 by 8.
+/// @return the position of the pixel, or to if there is none
+static int GIF_Row_first_change(const T_GIF_frame_delta * delta, word y, int from, int to)
 {
-  FILE * GIF_file;
-  byte GIF_buffer[256];   // buffer d'écriture de bloc de données compilées
+  const byte * row = delta->Frame + y * delta->Pitch;
+  const byte * previous = delta->Previous ? delta->Previous + y * delta->Pitch : NULL;
+  int x = from;
 
-  word * alphabet_prefix;  // Table des préfixes des codes
-  word * alphabet_suffix;  // Table des suffixes des codes
-  word * alphabet_daughter;    // Table des chaînes filles (plus longues)
-  word * alphabet_sister;    // Table des chaînes soeurs (même longueur)
-  word   alphabet_free;     // Position libre dans l'alphabet
-  word   alphabet_max;      // Nombre d'entrées possibles dans l'alphabet
-  word   start;            // Code précédent (sert au linkage des chaînes)
-  int    descend;          // Booléen "On vient de descendre"
+  if (previous != NULL)
+  {
+    while (x + 8 <= to && memcmp(row + x, previous + x, 8) == 0)
+      x += 8;
+  }
+  for (; x < to; x++)
+  {
+    if (GIF_Pixel_needed(delta, row, previous, x))
+      return x;
+  }
+  return to;
+}
 
-  T_GIF_context GIF;
-  T_GIF_LSDB LSDB;
-  T_GIF_IDB IDB;
+/// Look for the last pixel to save in the range [from, to[ of a line.
+/// Unchanged pixels are skipped 8 by 8.
+/// @return the position of the pixel, or from - 1 if there is none
+static int GIF_Row_last_change(const T_GIF_frame_delta * delta, word y, int from, int to)
+{
+  const byte * row = delta->Frame + y * delta->Pitch;
+  const byte * previous = delta->Previous ? delta->Previous + y * delta->Pitch : NULL;
+  int x = to;
 
+  if (previous != NULL)
+  {
+    while (x - 8 >= from && memcmp(row + x - 8, previous + x - 8, 8) == 0)
+      x -= 8;
+  }
+  while (--x >= from)
+  {
+    if (GIF_Pixel_needed(delta, row, previous, x))
+      return x;
+  }
+  return from - 1;
+}
 
-  byte block_identifier;  // Code indicateur du type de bloc en cours
-  word current_string;   // Code de la chaîne en cours de traitement
-  byte current_char;         // Caractère à coder
-  word index;            // index de recherche de chaîne
-  int current_layer;
+/// Find the bounding box of the pixels of a frame which need to be saved.
+///
+/// Unchanged lines at the top and the bottom are skipped, then only the
+/// parts of the other lines which are outside the current box are checked.
+/// @return 0 if no pixel needs to be saved
+static int GIF_Frame_changes(const T_GIF_frame_delta * delta, word width, word height, T_GIF_IDB * idb)
+{
+  int min_X, max_X, x;
+  word min_Y, max_Y, y;
 
-  word clear;   // LZW clear code
-  word eof;     // End of image code
+  for (min_Y = 0; min_Y < height; min_Y++)
+  {
+    min_X = GIF_Row_first_change(delta, min_Y, 0, width);
+    if (min_X < width)
+      break;
+  }
+  if (min_Y >= height)
+    return 0;
+  max_X = GIF_Row_last_change(delta, min_Y, min_X, width);
 
-  /////////////////////////////////////////////////// FIN DES DECLARATIONS //
+  for (max_Y = height - 1; max_Y > min_Y; max_Y--)
+  {
+    if (GIF_Row_first_change(delta, max_Y, 0, width) < width)
+      break;
+  }
 
-  File_error=0;
+  for (y = min_Y + 1; y <= max_Y; y++)
+  {
+    x = GIF_Row_first_change(delta, y, 0, min_X);
+    if (x < min_X)
+      min_X = x;
+    x = GIF_Row_last_change(delta, y, max_X + 1, width);
+    if (x > max_X)
+      max_X = x;
+  }
+
+  idb->Pos_X = (word)min_X;
+  idb->Pos_Y = min_Y;
+  idb->Image_width = (word)(max_X + 1 - min_X);
+  idb->Image_height = max_Y + 1 - min_Y;
+  return 1;
+}
 
-  if ((GIF_file=Open_file_write(context)))
+/// Replace the pixels which are unchanged from the previous frame by the
+/// transparent color, so they make long runs which LZW packs well.
+///
+/// This is only done if no pixel that changed uses the transparent color,
+/// and if the transparent color does not need more bits per pixel.
+/// @param delta      the frame, its previous frame must be set
+/// @param idb        position and size of the image block
+/// @param pixels     copy of the image block, modified
+/// @param transp     the transparent color
+/// @return 1 if pixels were replaced
+static int GIF_Unchanged_to_transparent(const T_GIF_frame_delta * delta, const T_GIF_IDB * idb, byte * pixels, byte transp)
+{
+  word x, y;
+  int replaced = 0;
+
+  if (transp >= (1 << idb->Nb_bits_pixel))
+    return 0;
+  for (y = 0; y < idb->Image_height; y++)
   {
-    // On écrit la signature du fichier
-    if (Write_bytes(GIF_file,"GIF89a",6))
+    const byte * row = delta->Frame + (idb->Pos_Y + y) * delta->Pitch + idb->Pos_X;
+    const byte * previous = delta->Previous + (idb->Pos_Y + y) * delta->Pitch + idb->Pos_X;
+    for (x = 0; x < idb->Image_width; x++)
     {
-      // La signature du fichier a été correctement écrite.
+      if (row[x] == transp && previous[x] != transp)
+        return 0; // this pixel would disappear
+    }
+  }
+  for (y = 0; y < idb->Image_height; y++)
+  {
+    const byte * previous = delta->Previous + (idb->Pos_Y + y) * delta->Pitch + idb->Pos_X;
+    byte * row = pixels + (long)y * idb->Image_width;
+    for (x = 0; x < idb->Image_width; x++)
+    {
+      if (row[x] == previous[x] && row[x] != transp)
+      {
+        row[x] = transp;
+        replaced = 1;
+      }
+    }
+  }
+  return replaced;
+}
 
-      // Allocation de mémoire pour les tables
-      alphabet_prefix = (word *)GFX2_malloc(4096*sizeof(word));
-      alphabet_suffix = (word *)GFX2_malloc(4096*sizeof(word));
-      alphabet_daughter = (word *)GFX2_malloc(4096*sizeof(word));
-      alphabet_sister = (word *)GFX2_malloc(4096*sizeof(word));
+/// Maximum number of layers of a GIF file compressed at the same time
+#define GIF_MAX_THREADS 16
 
-      // On initialise le LSDB du fichier
-      if (Config.Screen_size_in_GIF)
+/// GIF file being saved, see Save_GIF_start()
+struct T_GIF_writer
+{
+  T_IO_Context * Context;
+  FILE * File;
+  enum IMAGE_MODES Image_mode; ///< for CONTEXT_MAIN_IMAGE, IMAGE_MODE_LAYERED otherwise
+  byte Backcol;                ///< background color of the Logical Screen Descriptor
+  byte Complete;               ///< the whole file was written
+  int Layer;                   ///< next layer to start
+  int Nb_slots;                ///< number of layers compressed at the same time
+  T_GIF_layer * Slots;         ///< layers being compressed
+};
+
+/// Write the GIF header, the palette and the extensions which come before
+/// the first image.
+static void GIF_Write_header(T_GIF_writer * writer)
+{
+  T_IO_Context * context = writer->Context;
+  FILE * GIF_file = writer->File;
+  T_GIF_LSDB LSDB;
+
+  // On initialise le LSDB du fichier
+  if (Config.Screen_size_in_GIF)
+  {
+    LSDB.Width=Screen_width;
+    LSDB.Height=Screen_height;
+  }
+  else
+  {
+    LSDB.Width=context->Width;
+    LSDB.Height=context->Height;
+  }
+  LSDB.Resol  = 0xF7;  // Global palette of 256 entries, 256 color image
+  // 0xF7 = 1111 0111
+  // <Packed Fields>  =      Global Color Table Flag       1 Bit
+  //                         Color Resolution              3 Bits
+  //                         Sort Flag                     1 Bit
+  //                         Size of Global Color Table    3 Bits
+  LSDB.Backcol=context->Transparent_color;
+  writer->Backcol = LSDB.Backcol;
+  switch(context->Ratio)
+  {
+    case PIXEL_TALL:
+    case PIXEL_TALL2:
+      LSDB.Aspect = 17; // 1:2 = 2:4
+      break;
+    case PIXEL_TALL3:
+      LSDB.Aspect = 33; // 3:4
+      break;
+    case PIXEL_WIDE:
+    case PIXEL_WIDE2:
+      LSDB.Aspect = 113; // 2:1 = 4:2
+      break;
+    default:
+      LSDB.Aspect = 0; // undefined, which is most frequent.
+      // 49 would be 1:1 ratio
+  }
+
+  // On sauve le LSDB dans le fichier
+
+  if (Write_word_le(GIF_file,LSDB.Width) &&
+      Write_word_le(GIF_file,LSDB.Height) &&
+      Write_byte(GIF_file,LSDB.Resol) &&
+      Write_byte(GIF_file,LSDB.Backcol) &&
+      Write_byte(GIF_file,LSDB.Aspect) )
+  {
+    // Le LSDB a été correctement écrit.
+    int i;
+    // On sauve la palette
+    for(i=0;i<256 && !File_error;i++)
+    {
+      if (!Write_byte(GIF_file,context->Palette[i].R)
+        ||!Write_byte(GIF_file,context->Palette[i].G)
+        ||!Write_byte(GIF_file,context->Palette[i].B))
+        File_error=1;
+    }
+    if (!File_error)
+    {
+      // La palette a été correctement écrite.
+
+      /// - "Netscape" animation extension :
+      /// <pre>
+      ///   0x21       Extension Label
+      ///   0xFF       Application Extension Label
+      ///   0x0B       Block Size
+      ///   "NETSCAPE" Application Identifier (8 bytes)
+      ///   "2.0"      Application Authentication Code (3 bytes)
+      ///   0x03       Sub-block Data Size
+      ///   0xLL       01 to loop
+      ///   0xSSSS     (little endian) number of loops, 0 means infinite loop
+      ///   0x00 Block terminator </pre>
+      /// see http://www.vurdalakov.net/misc/gif/netscape-looping-application-extension
+      if (writer->Image_mode == IMAGE_MODE_ANIMATION)
       {
-        LSDB.Width=Screen_width;
-        LSDB.Height=Screen_height;
+        if (context->Nb_layers>1)
+          Write_bytes(GIF_file,"\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00",19);
       }
-      else
+      else if (writer->Image_mode > IMAGE_MODE_ANIMATION)
       {
-        LSDB.Width=context->Width;
-        LSDB.Height=context->Height;
+        /// - GrafX2 extension to store ::IMAGE_MODES :
+        /// <pre>
+        ///   0x21       Extension Label
+        ///   0xFF       Application Extension Label
+        ///   0x0B       Block Size
+        ///   "GFX2MODE" Application Identifier (8 bytes)
+        ///   "2.6"      Application Authentication Code (3 bytes)
+        ///   0xll       Sub-block Data Size
+        ///   string     label
+        ///   0x00 Block terminator </pre>
+        /// @see Constraint_mode_label()
+        const char * label = Constraint_mode_label(writer->Image_mode);
+        if (label != NULL)
+        {
+          size_t len = strlen(label);
+          // Write extension for storing IMAGE_MODE
+          Write_byte(GIF_file,0x21);  // Extension Introducer
+          Write_byte(GIF_file,0xff);  // Extension Label
+          Write_byte(GIF_file,  11);  // Block size
+          Write_bytes(GIF_file, "GFX2MODE2.6", 11); // Application Identifier + Appl. Authentication Code
+          Write_byte(GIF_file, (byte)len);    // Block size
+          Write_bytes(GIF_file, label, len);  // Data
+          Write_byte(GIF_file, 0);    // Block terminator
+        }
       }
-      LSDB.Resol  = 0xF7;  // Global palette of 256 entries, 256 color image
-      // 0xF7 = 1111 0111
-      // <Packed Fields>  =      Global Color Table Flag       1 Bit
-      //                         Color Resolution              3 Bits
-      //                         Sort Flag                     1 Bit
-      //                         Size of Global Color Table    3 Bits
-      LSDB.Backcol=context->Transparent_color;
-      switch(context->Ratio)
+
+      // Ecriture du commentaire
+      if (context->Comment[0])
       {
-        case PIXEL_TALL:
-        case PIXEL_TALL2:
-          LSDB.Aspect = 17; // 1:2 = 2:4
-          break;
-        case PIXEL_TALL3:
-          LSDB.Aspect = 33; // 3:4
-          break;
-        case PIXEL_WIDE:
-        case PIXEL_WIDE2:
-          LSDB.Aspect = 113; // 2:1 = 4:2
-          break;
-        default:
-          LSDB.Aspect = 0; // undefined, which is most frequent.
-          // 49 would be 1:1 ratio
+        Write_bytes(GIF_file,"\x21\xFE",2);
+        Write_byte(GIF_file, (byte)strlen(context->Comment));
+        Write_bytes(GIF_file,context->Comment,strlen(context->Comment)+1);
       }
-
-      // On sauve le LSDB dans le fichier
-
-      if (Write_word_le(GIF_file,LSDB.Width) &&
-          Write_word_le(GIF_file,LSDB.Height) &&
-          Write_byte(GIF_file,LSDB.Resol) &&
-          Write_byte(GIF_file,LSDB.Backcol) &&
-          Write_byte(GIF_file,LSDB.Aspect) )
+      /// - "CRNG" Color cycing extension :
+      /// <pre>
+      ///   0x21       Extension Label
+      ///   0xFF       Application Extension Label
+      ///   0x0B       Block Size
+      ///   "CRNG\0\0\0\0" "CRNG" Application Identifier (8 bytes)
+      ///   "1.0"      Application Authentication Code (3 bytes)
+      ///   0xll       Sub-block Data Size (6 bytes per color cycle)
+      ///   For each color cycle :
+      ///     0xRRRR   (big endian) Rate
+      ///     0xFFFF   (big endian) Flags
+      ///     0xSS     start (lower color index)
+      ///     0xEE     end (higher color index)
+      ///   0x00       Block terminator </pre>
+      if (context->Color_cycles)
       {
-        // Le LSDB a été correctement écrit.
-        int i;
-        // On sauve la palette
-        for(i=0;i<256 && !File_error;i++)
+        Write_bytes(GIF_file,"\x21\xff\x0B" "CRNG\0\0\0\0" "1.0",14);
+        Write_byte(GIF_file,context->Color_cycles*6);
+        for (i=0; i<context->Color_cycles; i++)
         {
-          if (!Write_byte(GIF_file,context->Palette[i].R)
-            ||!Write_byte(GIF_file,context->Palette[i].G)
-            ||!Write_byte(GIF_file,context->Palette[i].B))
-            File_error=1;
+          word flags=0;
+          flags|= context->Cycle_range[i].Speed?1:0; // Cycling or not
+          flags|= context->Cycle_range[i].Inverse?2:0; // Inverted
+
+          Write_word_be(GIF_file,context->Cycle_range[i].Speed*78); // Rate
+          Write_word_be(GIF_file,flags); // Flags
+          Write_byte(GIF_file,context->Cycle_range[i].Start); // Min color
+          Write_byte(GIF_file,context->Cycle_range[i].End); // Max color
         }
-        if (!File_error)
-        {
-          // La palette a été correctement écrite.
-
-          /// - "Netscape" animation extension :
-          /// <pre>
-          ///   0x21       Extension Label
-          ///   0xFF       Application Extension Label
-          ///   0x0B       Block Size
-          ///   "NETSCAPE" Application Identifier (8 bytes)
-          ///   "2.0"      Application Authentication Code (3 bytes)
-          ///   0x03       Sub-block Data Size
-          ///   0xLL       01 to loop
-          ///   0xSSSS     (little endian) number of loops, 0 means infinite loop
-          ///   0x00 Block terminator </pre>
-          /// see http://www.vurdalakov.net/misc/gif/netscape-looping-application-extension
-          if (context->Type == CONTEXT_MAIN_IMAGE && Main.backups->Pages->Image_mode == IMAGE_MODE_ANIMATION)
-          {
-            if (context->Nb_layers>1)
-              Write_bytes(GIF_file,"\x21\xFF\x0BNETSCAPE2.0\x03\x01\x00\x00\x00",19);
-          }
-          else if (context->Type == CONTEXT_MAIN_IMAGE && Main.backups->Pages->Image_mode > IMAGE_MODE_ANIMATION)
-          {
-            /// - GrafX2 extension to store ::IMAGE_MODES :
-            /// <pre>
-            ///   0x21       Extension Label
-            ///   0xFF       Application Extension Label
-            ///   0x0B       Block Size
-            ///   "GFX2MODE" Application Identifier (8 bytes)
-            ///   "2.6"      Application Authentication Code (3 bytes)
-            ///   0xll       Sub-block Data Size
-            ///   string     label
-            ///   0x00 Block terminator </pre>
-            /// @see Constraint_mode_label()
-            const char * label = Constraint_mode_label(Main.backups->Pages->Image_mode);
-            if (label != NULL)
-            {
-              size_t len = strlen(label);
-              // Write extension for storing IMAGE_MODE
-              Write_byte(GIF_file,0x21);  // Extension Introducer
-              Write_byte(GIF_file,0xff);  // Extension Label
-              Write_byte(GIF_file,  11);  // Block size
-              Write_bytes(GIF_file, "GFX2MODE2.6", 11); // Application Identifier + Appl. Authentication Code
-              Write_byte(GIF_file, (byte)len);    // Block size
-              Write_bytes(GIF_file, label, len);  // Data
-              Write_byte(GIF_file, 0);    // Block terminator
-            }
-          }
+        Write_byte(GIF_file,0);
+      }
+    } // On a pu écrire la palette
+  } // On a pu écrire le LSDB
+  else
+    File_error=1;
+}
 
-          // Ecriture du commentaire
-          if (context->Comment[0])
-          {
-            Write_bytes(GIF_file,"\x21\xFE",2);
-            Write_byte(GIF_file, (byte)strlen(context->Comment));
-            Write_bytes(GIF_file,context->Comment,strlen(context->Comment)+1);
-          }
-          /// - "CRNG" Color cycing extension :
-          /// <pre>
-          ///   0x21       Extension Label
-          ///   0xFF       Application Extension Label
-          ///   0x0B       Block Size
-          ///   "CRNG\0\0\0\0" "CRNG" Application Identifier (8 bytes)
-          ///   "1.0"      Application Authentication Code (3 bytes)
-          ///   0xll       Sub-block Data Size (6 bytes per color cycle)
-          ///   For each color cycle :
-          ///     0xRRRR   (big endian) Rate
-          ///     0xFFFF   (big endian) Flags
-          ///     0xSS     start (lower color index)
-          ///     0xEE     end (higher color index)
-          ///   0x00       Block terminator </pre>
-          if (context->Color_cycles)
-          {
-            int i;
+/// Prepare the next layer in a slot : put its Graphic Control Extension
+/// and its Image Descriptor in the output, copy its pixels and start
+/// the compression.
+///
+/// This reads the pages of the context, so it runs on the main thread.
+static void GIF_Start_layer(T_GIF_writer * writer, T_GIF_layer * layer)
+{
+  T_IO_Context * context = writer->Context;
+  T_GIF_IDB * idb = &layer->IDB;
+  int index = writer->Layer++;
+  // Write a Graphic Control Extension
+  T_GIF_GCE GCE;
+  byte disposal_method;
+  T_GIF_frame_delta delta;
+  byte * pixels;
+  byte max = 0;
+  word y;
 
-            Write_bytes(GIF_file,"\x21\xff\x0B" "CRNG\0\0\0\0" "1.0",14);
-            Write_byte(GIF_file,context->Color_cycles*6);
-            for (i=0; i<context->Color_cycles; i++)
-            {
-              word flags=0;
-              flags|= context->Cycle_range[i].Speed?1:0; // Cycling or not
-              flags|= context->Cycle_range[i].Inverse?2:0; // Inverted
-
-              Write_word_be(GIF_file,context->Cycle_range[i].Speed*78); // Rate
-              Write_word_be(GIF_file,flags); // Flags
-              Write_byte(GIF_file,context->Cycle_range[i].Start); // Min color
-              Write_byte(GIF_file,context->Cycle_range[i].End); // Max color
-            }
-            Write_byte(GIF_file,0);
-          }
+  Set_saving_layer(context, index);
 
-          // Loop on all layers
-          for (current_layer=0;
-            current_layer < context->Nb_layers && !File_error;
-            current_layer++)
-          {
-            // Write a Graphic Control Extension
-            T_GIF_GCE GCE;
-            byte disposal_method;
+  GCE.Block_identifier = 0x21;
+  GCE.Function = 0xF9;
+  GCE.Block_size=4;
 
-            Set_saving_layer(context, current_layer);
+  if (writer->Image_mode == IMAGE_MODE_ANIMATION)
+  {
+    // Animation frame
+    int duration;
+    if(context->Background_transparent)
+      disposal_method = DISPOSAL_METHOD_RESTORE_BGCOLOR;
+    else
+      disposal_method = DISPOSAL_METHOD_DO_NOT_DISPOSE;
+    GCE.Packed_fields=(disposal_method<<2)|(context->Background_transparent);
+    duration=Get_frame_duration(context)/10;
+    GCE.Delay_time=duration<0xFFFF?duration:0xFFFF;
+  }
+  else
+  {
+    // Layered image or brush
+    disposal_method = DISPOSAL_METHOD_DO_NOT_DISPOSE;
+    if (index==0)
+      GCE.Packed_fields=(disposal_method<<2)|(context->Background_transparent);
+    else
+      GCE.Packed_fields=(disposal_method<<2)|(1);
+    GCE.Delay_time=5; // Duration 5/100s (minimum viable value for current web browsers)
+    if (index == context->Nb_layers -1)
+      GCE.Delay_time=0xFFFF; // Infinity (10 minutes)
+  }
+  GCE.Transparent_color=context->Transparent_color;
+  GCE.Block_terminator=0x00;
+
+  idb->Pos_X=0;
+  idb->Pos_Y=0;
+  idb->Image_width=context->Width;
+  idb->Image_height=context->Height;
+  delta.Previous = NULL;
+  if(index > 0)
+  {
+    // find bounding box of changes for Animated GIFs
+    if(disposal_method == DISPOSAL_METHOD_DO_NOT_DISPOSE)
+    {
+      // pixels which have same value in previous layer don't need to be saved
+      Set_saving_layer(context, index - 1);
+      delta.Previous = context->Target_address;
+      Set_saving_layer(context, index);
+    }
+    delta.Frame = context->Target_address;
+    delta.Pitch = context->Pitch;
+    // pixels of the Backcol don't need to be saved
+    delta.Check_backcol = (disposal_method == DISPOSAL_METHOD_RESTORE_BGCOLOR
+                           || context->Background_transparent
+                           || writer->Image_mode != IMAGE_MODE_ANIMATION);
+    delta.Backcol = writer->Backcol;
+    if (!GIF_Frame_changes(&delta, context->Width, context->Height, idb))
+    {
+      // if no pixel changes, store a 1 pixel image
+      idb->Image_width = 1;
+      idb->Image_height = 1;
+    }
+  }
 
-            GCE.Block_identifier = 0x21;
-            GCE.Function = 0xF9;
-            GCE.Block_size=4;
+  // copy the pixels of the image block, and look for the maximum
+  // pixel value to decide how many bit per pixel are needed.
+  pixels = (byte *)GFX2_malloc((size_t)idb->Image_width * idb->Image_height);
+  if (pixels == NULL)
+  {
+    File_error = 1;
+    return;
+  }
+  for (y = 0; y < idb->Image_height; y++)
+  {
+    byte * row = pixels + (long)y * idb->Image_width;
+    word x;
 
-            if (context->Type == CONTEXT_MAIN_IMAGE && Main.backups->Pages->Image_mode == IMAGE_MODE_ANIMATION)
-            {
-              // Animation frame
-              int duration;
-              if(context->Background_transparent)
-                disposal_method = DISPOSAL_METHOD_RESTORE_BGCOLOR;
-              else
-                disposal_method = DISPOSAL_METHOD_DO_NOT_DISPOSE;
-              GCE.Packed_fields=(disposal_method<<2)|(context->Background_transparent);
-              duration=Get_frame_duration(context)/10;
-              GCE.Delay_time=duration<0xFFFF?duration:0xFFFF;
-            }
-            else
-            {
-              // Layered image or brush
-              disposal_method = DISPOSAL_METHOD_DO_NOT_DISPOSE;
-              if (current_layer==0)
-                GCE.Packed_fields=(disposal_method<<2)|(context->Background_transparent);
-              else
-                GCE.Packed_fields=(disposal_method<<2)|(1);
-              GCE.Delay_time=5; // Duration 5/100s (minimum viable value for current web browsers)
-              if (current_layer == context->Nb_layers -1)
-                GCE.Delay_time=0xFFFF; // Infinity (10 minutes)
-            }
-            GCE.Transparent_color=context->Transparent_color;
-            GCE.Block_terminator=0x00;
-
-            if (Write_byte(GIF_file,GCE.Block_identifier)
-             && Write_byte(GIF_file,GCE.Function)
-             && Write_byte(GIF_file,GCE.Block_size)
-             && Write_byte(GIF_file,GCE.Packed_fields)
-             && Write_word_le(GIF_file,GCE.Delay_time)
-             && Write_byte(GIF_file,GCE.Transparent_color)
-             && Write_byte(GIF_file,GCE.Block_terminator)
-             )
-            {
-              byte temp, max = 0;
+    memcpy(row, context->Target_address + (idb->Pos_Y + y) * context->Pitch + idb->Pos_X, idb->Image_width);
+    for (x = 0; x < idb->Image_width; x++)
+    {
+      if (row[x] > max)
+        max = row[x];
+    }
+  }
+  idb->Nb_bits_pixel=2;  // Find the minimum bpp value to fit all pixels
+  while((int)max >= (1 << idb->Nb_bits_pixel)) {
+    idb->Nb_bits_pixel++;
+  }
 
-              IDB.Pos_X=0;
-              IDB.Pos_Y=0;
-              IDB.Image_width=context->Width;
-              IDB.Image_height=context->Height;
-              if(current_layer > 0)
-              {
-                word min_X, max_X, min_Y, max_Y;
-                // find bounding box of changes for Animated GIFs
-                min_X = min_Y = 0xffff;
-                max_X = max_Y = 0;
-                for(GIF.pos_Y = 0; GIF.pos_Y < context->Height; GIF.pos_Y++) {
-                  for(GIF.pos_X = 0; GIF.pos_X < context->Width; GIF.pos_X++) {
-                    if (GIF.pos_X >= min_X && GIF.pos_X <= max_X && GIF.pos_Y >= min_Y && GIF.pos_Y <= max_Y)
-                      continue; // already in the box
-                    if(disposal_method == DISPOSAL_METHOD_DO_NOT_DISPOSE)
-                    {
-                      // if that pixel has same value in previous layer, no need to save it
-                      Set_saving_layer(context, current_layer - 1);
-                      temp = Get_pixel(context, GIF.pos_X, GIF.pos_Y);
-                      Set_saving_layer(context, current_layer);
-                      if(temp == Get_pixel(context, GIF.pos_X, GIF.pos_Y))
-                        continue;
-                    }
-                    if (disposal_method == DISPOSAL_METHOD_RESTORE_BGCOLOR
-                      || context->Background_transparent
-                      || Main.backups->Pages->Image_mode != IMAGE_MODE_ANIMATION)
-                    {
-                      // if that pixel is Backcol, no need to save it
-                      if (LSDB.Backcol == Get_pixel(context, GIF.pos_X, GIF.pos_Y))
-                        continue;
-                    }
-                    if(GIF.pos_X < min_X) min_X = GIF.pos_X;
-                    if(GIF.pos_X > max_X) max_X = GIF.pos_X;
-                    if(GIF.pos_Y < min_Y) min_Y = GIF.pos_Y;
-                    if(GIF.pos_Y > max_Y) max_Y = GIF.pos_Y;
-                  }
-                }
-                if((min_X <= max_X) && (min_Y <= max_Y))
-                {
-                  IDB.Pos_X = min_X;
-                  IDB.Pos_Y = min_Y;
-                  IDB.Image_width = max_X + 1 - min_X;
-                  IDB.Image_height = max_Y + 1 - min_Y;
-                }
-                else
-                {
-                  // if no pixel changes, store a 1 pixel image
-                  IDB.Image_width = 1;
-                  IDB.Image_height = 1;
-                }
-              }
+  // In animations, pixels which didn't change can be made
+  // transparent : the previous frame is not disposed.
+  if (Config.Optimize_GIF_animations
+   && delta.Previous != NULL
+   && writer->Image_mode == IMAGE_MODE_ANIMATION
+   && !(GCE.Packed_fields & 1))
+  {
+    if (GIF_Unchanged_to_transparent(&delta, idb, pixels, GCE.Transparent_color))
+      GCE.Packed_fields |= 1;
+  }
 
-              // look for the maximum pixel value
-              // to decide how many bit per pixel are needed.
-              for(GIF.pos_Y = IDB.Pos_Y; GIF.pos_Y < IDB.Image_height + IDB.Pos_Y; GIF.pos_Y++) {
-                for(GIF.pos_X = IDB.Pos_X; GIF.pos_X < IDB.Image_width + IDB.Pos_X; GIF.pos_X++) {
-                  temp=Get_pixel(context, GIF.pos_X, GIF.pos_Y);
-                  if(temp > max) max = temp;
-                }
-              }
-              IDB.Nb_bits_pixel=2;  // Find the minimum bpp value to fit all pixels
-              while((int)max >= (1 << IDB.Nb_bits_pixel)) {
-                IDB.Nb_bits_pixel++;
-              }
-              GFX2_Log(GFX2_DEBUG, "GIF image #%d %ubits (%u,%u) %ux%u\n",
-                       current_layer, IDB.Nb_bits_pixel, IDB.Pos_X, IDB.Pos_Y,
-                       IDB.Image_width, IDB.Image_height);
-
-              // On va écrire un block indicateur d'IDB et l'IDB du fichier
-              block_identifier=0x2C;
-              IDB.Indicator=0x07;    // Image non entrelacée, pas de palette locale.
-              clear = 1 << IDB.Nb_bits_pixel; // Clear Code
-              eof = clear + 1;                // End of Picture Code
-
-              if ( Write_byte(GIF_file,block_identifier) &&
-                   Write_word_le(GIF_file,IDB.Pos_X) &&
-                   Write_word_le(GIF_file,IDB.Pos_Y) &&
-                   Write_word_le(GIF_file,IDB.Image_width) &&
-                   Write_word_le(GIF_file,IDB.Image_height) &&
-                   Write_byte(GIF_file,IDB.Indicator) &&
-                   Write_byte(GIF_file,IDB.Nb_bits_pixel))
-              {
-                //   Le block indicateur d'IDB et l'IDB ont étés correctements
-                // écrits.
+  GFX2_Log(GFX2_DEBUG, "GIF image #%d %ubits (%u,%u) %ux%u\n",
+           index, idb->Nb_bits_pixel, idb->Pos_X, idb->Pos_Y,
+           idb->Image_width, idb->Image_height);
 
-                GIF.pos_X=IDB.Pos_X;
-                GIF.pos_Y=IDB.Pos_Y;
-                GIF.last_byte=0;
-                GIF.remainder_bits=0;
-                GIF.remainder_byte=0;
+  // On va écrire un block indicateur d'IDB et l'IDB du fichier
+  idb->Indicator=0x07;    // Image non entrelacée, pas de palette locale.
+  {
+    const byte header[19] = {
+      GCE.Block_identifier, GCE.Function, GCE.Block_size, GCE.Packed_fields,
+      (byte)GCE.Delay_time, (byte)(GCE.Delay_time >> 8),
+      GCE.Transparent_color, GCE.Block_terminator,
+      0x2C,
+      (byte)idb->Pos_X, (byte)(idb->Pos_X >> 8),
+      (byte)idb->Pos_Y, (byte)(idb->Pos_Y >> 8),
+      (byte)idb->Image_width, (byte)(idb->Image_width >> 8),
+      (byte)idb->Image_height, (byte)(idb->Image_height >> 8),
+      idb->Indicator, idb->Nb_bits_pixel
+    };
+    layer->Output_size = 0;
+    layer->Error = 0;
+    GIF_output(layer, header, sizeof(header));
+  }
 
-#define GIF_INVALID_CODE (65535)
-                index=GIF_INVALID_CODE;
-                File_error=0;
-                GIF.stop=0;
-
-                // Réintialisation de la table:
-                alphabet_free=clear + 2;  // 258 for 8bpp
-                GIF.nb_bits  =IDB.Nb_bits_pixel + 1; // 9 for 8 bpp
-                alphabet_max =clear+clear-1;  // 511 for 8bpp
-                GIF_set_code(GIF_file, &GIF, GIF_buffer, clear);  //256 for 8bpp
-                for (start=0;start<4096;start++)
-                {
-                  alphabet_daughter[start] = GIF_INVALID_CODE;
-                  alphabet_sister[start] = GIF_INVALID_CODE;
-                }
+  layer->Clear = 1 << idb->Nb_bits_pixel; // Clear Code
+  layer->GIF.pos_X=0;
+  layer->GIF.pos_Y=0;
+  layer->GIF.last_byte=0;
+  layer->GIF.remainder_bits=0;
+  layer->GIF.remainder_byte=0;
+  layer->GIF.stop=0;
+
+  // Réintialisation de la table:
+  layer->Alphabet_free=layer->Clear + 2;  // 258 for 8bpp
+  layer->GIF.nb_bits  =idb->Nb_bits_pixel + 1; // 9 for 8 bpp
+  layer->Alphabet_max =layer->Clear+layer->Clear-1;  // 511 for 8bpp
+  GIF_set_code(layer, layer->Clear);  //256 for 8bpp
+  GIF_clear_hash(layer->Hash_key);
+
+  layer->Current_string=GIF_next_pixel(pixels, &layer->GIF, idb);
+  layer->Pixels = pixels;
+}
 
-                ////////////////////////////////////////////// COMPRESSION LZW //
+/// LZW compression of the pixels of a layer
+///
+/// @param count maximum number of pixels to compress
+/// @return the number of pixels compressed
+static long GIF_Compress(T_GIF_layer * layer, long count)
+{
+  T_GIF_context * gif = &layer->GIF;
+  word current_string = layer->Current_string;
+  byte current_char;  // Caractère à coder
+  dword key;          // (current_string,current_char)
+  int position;       // position of key in the hash table
+  long done = 0;
+
+  while ((!gif->stop) && (!layer->Error) && done < count)
+  {
+    current_char=GIF_next_pixel(layer->Pixels, gif, &layer->IDB);
+    done++;
 
-                start=current_string=GIF_next_pixel(context, &GIF, &IDB);
-                descend=1;
+    // look for (current_string,current_char) in the alphabet
+    key = ((dword)current_string << 8) | current_char;
+    position = GIF_find_hash(layer->Hash_key, key, current_string, current_char);
 
-                while ((!GIF.stop) && (!File_error))
-                {
-                  current_char=GIF_next_pixel(context, &GIF, &IDB);
+    if (layer->Hash_key[position] == key)
+    {
+      // We have found (current_string,current_char) in the alphabet
+      // So go on and prepare for then next character
+      current_string=layer->Hash_code[position];
+    }
+    else
+    {
+      // (current_string,current_char) was not found in the alphabet
+      // so write current_string to the Gif stream
+      GIF_set_code(layer, current_string);
+
+      if(layer->Alphabet_free < 4096) {
+        // add (current_string,current_char) to the alphabet
+        layer->Hash_key[position]=key;
+        layer->Hash_code[position]=layer->Alphabet_free;
+        layer->Alphabet_free++;
+      }
 
-                  // look for (current_string,current_char) in the alphabet
-                  while ( (index != GIF_INVALID_CODE) &&
-                          ( (current_string!=alphabet_prefix[index]) ||
-                            (current_char      !=alphabet_suffix[index]) ) )
-                  {
-                    descend=0;
-                    start=index;
-                    index=alphabet_sister[index];
-                  }
+      if (layer->Alphabet_free >= 4096)
+      {
+        // clear alphabet
+        GIF_set_code(layer, layer->Clear);    // 256 for 8bpp
+        layer->Alphabet_free=layer->Clear+2;  // 258 for 8bpp
+        gif->nb_bits  =layer->IDB.Nb_bits_pixel + 1;  // 9 for 8bpp
+        layer->Alphabet_max =layer->Clear+layer->Clear-1;    // 511 for 8bpp
+        GIF_clear_hash(layer->Hash_key);
+      }
+      else if (layer->Alphabet_free>layer->Alphabet_max+1)
+      {
+        // On augmente le nb de bits
 
-                  if (index != GIF_INVALID_CODE)
-                  {
-                    // (current_string,current_char) == (alphabet_prefix,alphabet_suffix)[index]
-                    // We have found (current_string,current_char) in the alphabet
-                    // at the index position. So go on and prepare for then next character
+        gif->nb_bits++;
+        layer->Alphabet_max = (1<<gif->nb_bits)-1;
+      }
 
-                    descend=1;
-                    start=current_string=index;
-                    index=alphabet_daughter[index];
-                  }
-                  else
-                  {
-                    // (current_string,current_char) was not found in the alphabet
-                    // so write current_string to the Gif stream
-                    GIF_set_code(GIF_file, &GIF, GIF_buffer, current_string);
-
-                    if(alphabet_free < 4096) {
-                      // link current_string and the new one
-                      if (descend)
-                        alphabet_daughter[start]=alphabet_free;
-                      else
-                        alphabet_sister[start]=alphabet_free;
+      // initialize current_string as the string "current_char"
+      current_string=current_char;
+    }
+  }
+  layer->Current_string = current_string;
+  return done;
+}
 
-                      // add (current_string,current_char) to the alphabet
-                      alphabet_prefix[alphabet_free]=current_string;
-                      alphabet_suffix[alphabet_free]=current_char;
-                      alphabet_free++;
-                    }
+/// Write the last codes of a layer
+static void GIF_End_layer(T_GIF_layer * layer)
+{
+  T_GIF_context * gif = &layer->GIF;
 
-                    if (alphabet_free >= 4096)
-                    {
-                      // clear alphabet
-                      GIF_set_code(GIF_file, &GIF, GIF_buffer, clear);    // 256 for 8bpp
-                      alphabet_free=clear+2;  // 258 for 8bpp
-                      GIF.nb_bits  =IDB.Nb_bits_pixel + 1;  // 9 for 8bpp
-                      alphabet_max =clear+clear-1;    // 511 for 8bpp
-                      for (start=0;start<4096;start++)
-                      {
-                        alphabet_daughter[start] = GIF_INVALID_CODE;
-                        alphabet_sister[start] = GIF_INVALID_CODE;
-                      }
-                    }
-                    else if (alphabet_free>alphabet_max+1)
-                    {
-                      // On augmente le nb de bits
+  // Write the last code (before EOF)
+  GIF_set_code(layer, layer->Current_string);
 
-                      GIF.nb_bits++;
-                      alphabet_max = (1<<GIF.nb_bits)-1;
-                    }
+  // we need to update alphabet_free / GIF.nb_bits here because
+  // the decoder will update them after each code,
+  // so in very rare cases there might be a problem if we
+  // don't do it.
+  // see http://pulkomandy.tk/projects/GrafX2/ticket/125
+  if(layer->Alphabet_free < 4096)
+  {
+    layer->Alphabet_free++;
+    if ((layer->Alphabet_free > layer->Alphabet_max+1) && (gif->nb_bits < 12))
+    {
+      gif->nb_bits++;
+      layer->Alphabet_max = (1 << gif->nb_bits) - 1;
+    }
+  }
 
-                    // initialize current_string as the string "current_char"
-                    index=alphabet_daughter[current_char];
-                    start=current_string=current_char;
-                    descend=1;
-                  }
-                }
+  GIF_set_code(layer, layer->Clear + 1);  // 257 for 8bpp    // Code de End d'image
+  if (gif->remainder_bits!=0)
+  {
+    // Write last byte (this is an incomplete byte)
+    layer->Buffer[++gif->remainder_byte]=gif->last_byte;
+    gif->last_byte=0;
+    gif->remainder_bits=0;
+  }
+  GIF_empty_buffer(layer); // On envoie les dernières données du buffer GIF dans le buffer KM
 
-                if (!File_error)
-                {
-                  // Write the last code (before EOF)
-                  GIF_set_code(GIF_file, &GIF, GIF_buffer, current_string);
-
-                  // we need to update alphabet_free / GIF.nb_bits here because
-                  // the decoder will update them after each code,
-                  // so in very rare cases there might be a problem if we
-                  // don't do it.
-                  // see http://pulkomandy.tk/projects/GrafX2/ticket/125
-                  if(alphabet_free < 4096)
-                  {
-                    alphabet_free++;
-                    if ((alphabet_free > alphabet_max+1) && (GIF.nb_bits < 12))
-                    {
-                      GIF.nb_bits++;
-                      alphabet_max = (1 << GIF.nb_bits) - 1;
-                    }
-                  }
+  // On écrit un \0
+  GIF_output(layer, (const byte *)"", 1);
+}
 
-                  GIF_set_code(GIF_file, &GIF, GIF_buffer, eof);  // 257 for 8bpp    // Code de End d'image
-                  if (GIF.remainder_bits!=0)
-                  {
-                    // Write last byte (this is an incomplete byte)
-                    GIF_buffer[++GIF.remainder_byte]=GIF.last_byte;
-                    GIF.last_byte=0;
-                    GIF.remainder_bits=0;
-                  }
-                  GIF_empty_buffer(GIF_file, &GIF, GIF_buffer); // On envoie les dernières données du buffer GIF dans le buffer KM
+/// Compress a whole layer. Runs on a worker thread.
+static int GIF_Compress_layer(void * data)
+{
+  T_GIF_layer * layer = (T_GIF_layer *)data;
 
-                  // On écrit un \0
-                  if (! Write_byte(GIF_file,'\x00'))
-                    File_error=1;
-                }
+  GIF_Compress(layer, LONG_MAX);
+  GIF_End_layer(layer);
+  return layer->Error;
+}
 
-              } // On a pu écrire l'IDB
-              else
-                File_error=1;
-            }
-            else
-              File_error=1;
-          }
+/// Write the data of a compressed layer in the file, and free its pixels
+static void GIF_Write_layer(T_GIF_writer * writer, T_GIF_layer * layer)
+{
+  if (!File_error && (layer->Error || !Write_bytes(writer->File, layer->Output, layer->Output_size)))
+    File_error = 1;
+  free(layer->Pixels);
+  layer->Pixels = NULL;
+}
 
-          // After writing all layers
-          if (!File_error)
-          {
-            /// - If requested, write a specific extension for storing
-            /// original file path.
-            /// This is used by the backup system.
-            /// The format is :
-            /// <pre>
-            ///   0x21       Extension Label
-            ///   0xFF       Application Extension Label
-            ///   0x0B       Block Size
-            ///   "GFX2PATH" "GFX2PATH" Application Identifier (8 bytes)
-            ///   "\0\0\0"   Application Authentication Code (3 bytes)
-            ///   0xll       Sub-block Data Size : path size (including null)
-            ///   "..path.." path (null-terminated)
-            ///   0xll       Sub-block Data Size : filename size (including null)
-            ///   "..file.." file name (null-terminated)
-            ///   0x00       Block terminator </pre>
-            if (context->Original_file_name != NULL
-             && context->Original_file_directory != NULL)
-            {
-              long name_size = 1+strlen(context->Original_file_name);
-              long dir_size = 1+strlen(context->Original_file_directory);
-              if (name_size<256 && dir_size<256)
-              {
-                if (! Write_bytes(GIF_file,"\x21\xFF\x0BGFX2PATH\x00\x00\x00", 14)
-                || ! Write_byte(GIF_file,dir_size)
-                || ! Write_bytes(GIF_file, context->Original_file_directory, dir_size)
-                || ! Write_byte(GIF_file,name_size)
-                || ! Write_bytes(GIF_file, context->Original_file_name, name_size)
-                || ! Write_byte(GIF_file,0))
-                  File_error=1;
-              }
-            }
+/// Compress the layers by groups of T_GIF_writer::Nb_slots, each one on
+/// its own thread, and write them in order.
+static void GIF_Write_layers(T_GIF_writer * writer)
+{
+  T_GFX2_Thread * threads[GIF_MAX_THREADS];
+  int nb_layers = writer->Context->Nb_layers;
+  int i, n;
 
-            // On écrit un GIF TERMINATOR, exigé par SVGA et SEA.
-            if (! Write_byte(GIF_file,'\x3B'))
-              File_error=1;
-          }
+  while (writer->Layer < nb_layers && !File_error)
+  {
+    for (n = 0; n < writer->Nb_slots && writer->Layer < nb_layers && !File_error; n++)
+      GIF_Start_layer(writer, writer->Slots + n);
+    if (File_error)
+      n--;  // the last slot was not started
+    // the first layer of the group is compressed by this thread
+    for (i = 1; i < n; i++)
+      threads[i] = GFX2_Thread_create(GIF_Compress_layer, writer->Slots + i);
+    if (n > 0)
+      GIF_Compress_layer(writer->Slots);
+    for (i = 1; i < n; i++)
+    {
+      if (threads[i] != NULL)
+        GFX2_Thread_wait(threads[i]);
+      else
+        GIF_Compress_layer(writer->Slots + i);
+    }
+    for (i = 0; i < n; i++)
+      GIF_Write_layer(writer, writer->Slots + i);
+  }
+}
+
+/// Write the extensions which come after the last image, and the trailer
+static void GIF_Write_trailer(T_GIF_writer * writer)
+{
+  T_IO_Context * context = writer->Context;
+  FILE * GIF_file = writer->File;
+
+  /// - If requested, write a specific extension for storing
+  /// original file path.
+  /// This is used by the backup system.
+  /// The format is :
+  /// <pre>
+  ///   0x21       Extension Label
+  ///   0xFF       Application Extension Label
+  ///   0x0B       Block Size
+  ///   "GFX2PATH" "GFX2PATH" Application Identifier (8 bytes)
+  ///   "\0\0\0"   Application Authentication Code (3 bytes)
+  ///   0xll       Sub-block Data Size : path size (including null)
+  ///   "..path.." path (null-terminated)
+  ///   0xll       Sub-block Data Size : filename size (including null)
+  ///   "..file.." file name (null-terminated)
+  ///   0x00       Block terminator </pre>
+  if (context->Original_file_name != NULL
+   && context->Original_file_directory != NULL)
+  {
+    long name_size = 1+strlen(context->Original_file_name);
+    long dir_size = 1+strlen(context->Original_file_directory);
+    if (name_size<256 && dir_size<256)
+    {
+      if (! Write_bytes(GIF_file,"\x21\xFF\x0BGFX2PATH\x00\x00\x00", 14)
+      || ! Write_byte(GIF_file,dir_size)
+      || ! Write_bytes(GIF_file, context->Original_file_directory, dir_size)
+      || ! Write_byte(GIF_file,name_size)
+      || ! Write_bytes(GIF_file, context->Original_file_name, name_size)
+      || ! Write_byte(GIF_file,0))
+        File_error=1;
+    }
+  }
 
-        } // On a pu écrire la palette
-        else
-          File_error=1;
+  // On écrit un GIF TERMINATOR, exigé par SVGA et SEA.
+  if (! Write_byte(GIF_file,'\x3B'))
+    File_error=1;
+}
 
-      } // On a pu écrire le LSDB
+/// Open the file and write the header
+///
+/// @param nb_slots number of layers compressed at the same time
+static T_GIF_writer * GIF_Open_writer(T_IO_Context * context, int nb_slots)
+{
+  T_GIF_writer * writer;
+  int i;
+
+  File_error=0;
+  writer = (T_GIF_writer *)GFX2_malloc(sizeof(T_GIF_writer));
+  if (writer == NULL)
+  {
+    File_error=1;
+    return NULL;
+  }
+  memset(writer, 0, sizeof(T_GIF_writer));
+  writer->Context = context;
+  writer->Image_mode = (context->Type == CONTEXT_MAIN_IMAGE) ? Get_image_mode(context) : IMAGE_MODE_LAYERED;
+  writer->Slots = (T_GIF_layer *)GFX2_malloc(nb_slots * sizeof(T_GIF_layer));
+  if (writer->Slots == NULL)
+    File_error=1;
+  else
+  {
+    memset(writer->Slots, 0, nb_slots * sizeof(T_GIF_layer));
+    writer->Nb_slots = nb_slots;
+    // Allocation de mémoire pour les tables
+    for (i = 0; i < nb_slots; i++)
+    {
+      writer->Slots[i].Hash_key = (dword *)GFX2_malloc(GIF_HASH_SIZE*sizeof(dword));
+      writer->Slots[i].Hash_code = (word *)GFX2_malloc(GIF_HASH_SIZE*sizeof(word));
+      if (writer->Slots[i].Hash_key == NULL || writer->Slots[i].Hash_code == NULL)
+        File_error=1;
+    }
+  }
+  if (!File_error)
+  {
+    if ((writer->File=Open_file_write(context)) != NULL)
+    {
+      // On écrit la signature du fichier
+      if (Write_bytes(writer->File,"GIF89a",6))
+        GIF_Write_header(writer);
       else
         File_error=1;
+    }
+    else
+      File_error=1;
+  }
 
-      // Libération de la mémoire utilisée par les tables
-      free(alphabet_sister);
-      free(alphabet_daughter);
-      free(alphabet_suffix);
-      free(alphabet_prefix);
+  if (File_error)
+  {
+    Save_GIF_end(writer);
+    return NULL;
+  }
+  return writer;
+}
+
+T_GIF_writer * Save_GIF_start(T_IO_Context * context)
+{
+  return GIF_Open_writer(context, 1);
+}
+
+int Save_GIF_step(T_GIF_writer * writer, long count)
+{
+  T_GIF_layer * layer = writer->Slots;
 
-    } // On a pu écrire la signature du fichier
+  File_error=0;
+  while (count > 0 && !File_error)
+  {
+    if (layer->Pixels == NULL)
+    {
+      // Between two layers
+      if (writer->Layer >= writer->Context->Nb_layers)
+      {
+        GIF_Write_trailer(writer);
+        if (!File_error)
+          writer->Complete = 1;
+        break;
+      }
+      GIF_Start_layer(writer, layer);
+    }
     else
-      File_error=1;
+    {
+      count -= GIF_Compress(layer, count);
+      if (layer->GIF.stop || layer->Error)
+      {
+        GIF_End_layer(layer);
+        GIF_Write_layer(writer, layer);
+      }
+    }
+  }
+  return writer->Complete || File_error;
+}
 
-    fclose(GIF_file);
-    if (File_error)
-      Remove_file(context);
+void Save_GIF_end(T_GIF_writer * writer)
+{
+  int i;
 
-  } // On a pu ouvrir le fichier en écriture
-  else
-    File_error=1;
+  File_error = !writer->Complete;
+  if (writer->File != NULL)
+  {
+    fclose(writer->File);
+    if (File_error)
+      Remove_file(writer->Context);
+  }
+  // Libération de la mémoire utilisée par les tables
+  for (i = 0; i < writer->Nb_slots; i++)
+  {
+    free(writer->Slots[i].Pixels);
+    free(writer->Slots[i].Output);
+    free(writer->Slots[i].Hash_code);
+    free(writer->Slots[i].Hash_key);
+  }
+  free(writer->Slots);
+  free(writer);
+}
 
+/// Save a GIF file
+///
+/// The layers are compressed on as many threads as there are CPUs.
+void Save_GIF(T_IO_Context * context)
+{
+  T_GIF_writer * writer;
+  int nb_slots = GFX2_CPU_count();
+
+  if (nb_slots > GIF_MAX_THREADS)
+    nb_slots = GIF_MAX_THREADS;
+  if (nb_slots > context->Nb_layers)
+    nb_slots = context->Nb_layers;
+  if (nb_slots < 1)
+    nb_slots = 1;
+  writer = GIF_Open_writer(context, nb_slots);
+  if (writer == NULL)
+    return;
+  GIF_Write_layers(writer);
+  if (!File_error)
+    Save_GIF_step(writer, LONG_MAX); // writes the trailer
+  Save_GIF_end(writer);
 }
 
 /** @} */
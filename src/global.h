@@ -199,6 +199,7 @@ GFX2_GLOBAL Func_procsline Display_line_fast;
 /// Read a line of pixels from screen.
 GFX2_GLOBAL Func_procsline Read_line;
 /// Redraw all magnified part on screen, without overwriting the menu.
+/// The caller is responsible for the Update_rect().
 GFX2_GLOBAL Func_display_zoom Display_zoomed_screen;
 /// Display part of the brush on the magnified part of screen, color mode.
 GFX2_GLOBAL Func_display_brush_color_zoom Display_brush_color_zoom;
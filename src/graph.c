@@ -53,6 +53,7 @@
 #include "input.h"
 #include "brush.h"
 #include "tiles.h"
+#include "overview.h"
 #if defined(USE_SDL) || defined(USE_SDL2)
 #include "sdlscreen.h"
 #endif
@@ -152,6 +153,9 @@ void Update_part_of_screen(short x, short y, short width, short height)
   x &= 0xFFF8;
   y &= 0xFFF8;
 
+  // Keep the reduced copies of the picture up to date
+  Overview_invalidate(x, y, width, height);
+
   // Update "normal" view
   diff = x-Main.offset_X;
   if (diff<0)
@@ -1074,18 +1078,25 @@ void Fill_general(byte fill_color)
 
     for (y_pos=top_reached;y_pos<=bottom_reached;y_pos++)
     {
-      for (x_pos=left_reached;x_pos<=right_reached;x_pos++)
+      for (x_pos=left_reached;x_pos<=right_reached;)
       {
-        byte filled = Read_pixel_from_current_layer(x_pos,y_pos);
+        short run_start = x_pos;
 
         // First, restore the color.
-        Pixel_in_current_screen(x_pos,y_pos,Read_pixel_from_backup_layer(x_pos,y_pos));
-
-        if (filled==2)
+        if (Read_pixel_from_current_layer(x_pos,y_pos) != 2)
         {
-          // Update the color according to the fill color and all effects
-          Display_pixel(x_pos,y_pos,fill_color);
+          Pixel_in_current_screen(x_pos,y_pos,Read_pixel_from_backup_layer(x_pos,y_pos));
+          x_pos++;
+          continue;
         }
+        while (x_pos<=right_reached && Read_pixel_from_current_layer(x_pos,y_pos) == 2)
+        {
+          Pixel_in_current_screen(x_pos,y_pos,Read_pixel_from_backup_layer(x_pos,y_pos));
+          x_pos++;
+        }
+        // Update the color according to the fill color and all effects
+        // (effects read the backup, not the pixels restored above)
+        Display_span(run_start,y_pos,x_pos-run_start,fill_color);
       }
     }
 
@@ -1352,11 +1363,22 @@ void Draw_filled_circle(short center_x,short center_y,long sqradius,byte color)
   if (end_x>Limit_right)
     end_x=Limit_right;
 
-  // Affichage du cercle
+  // Affichage du cercle : the pixels of a line which are in the circle
+  // are contiguous, so each line is drawn as a single span.
   for (y_pos=start_y,y=(long)start_y-center_y;y_pos<=end_y;y_pos++,y++)
+  {
+    short span_end;
+
     for (x_pos=start_x,x=(long)start_x-center_x;x_pos<=end_x;x_pos++,x++)
       if (Pixel_in_circle(x, y, sqradius))
-        Display_pixel(x_pos,y_pos,color);
+        break;
+    if (x_pos > end_x)
+      continue;
+    for (span_end=end_x,x=(long)end_x-center_x;span_end>x_pos;span_end--,x--)
+      if (Pixel_in_circle(x, y, sqradius))
+        break;
+    Display_span(x_pos,y_pos,span_end-x_pos+1,color);
+  }
 
   Update_part_of_screen(start_x,start_y,end_x+1-start_x,end_y+1-start_y);
 }
@@ -1614,11 +1636,22 @@ void Draw_filled_ellipse(short center_x,short center_y,short horizontal_radius,s
   if (end_x>Limit_right)
     end_x=Limit_right;
 
-  // Affichage de l'ellipse
+  // Affichage de l'ellipse : the pixels of a line which are in the ellipse
+  // are contiguous, so each line is drawn as a single span.
   for (y_pos=start_y,y=start_y-center_y;y_pos<=end_y;y_pos++,y++)
+  {
+    short span_end;
+
     for (x_pos=start_x,x=start_x-center_x;x_pos<=end_x;x_pos++,x++)
       if (Pixel_in_ellipse(x, y, &Ellipse))
-        Display_pixel(x_pos,y_pos,color);
+        break;
+    if (x_pos > end_x)
+      continue;
+    for (span_end=end_x,x=end_x-center_x;span_end>x_pos;span_end--,x--)
+      if (Pixel_in_ellipse(x, y, &Ellipse))
+        break;
+    Display_span(x_pos,y_pos,span_end-x_pos+1,color);
+  }
   Update_part_of_screen(center_x-horizontal_radius,center_y-vertical_radius,2*horizontal_radius+1,2*vertical_radius+1);
 }
 
@@ -1948,7 +1981,6 @@ void Draw_empty_rectangle(short start_x,short start_y,short end_x,short end_y,by
 void Draw_filled_rectangle(short start_x,short start_y,short end_x,short end_y,byte color)
 {
   short temp;
-  short x_pos;
   short y_pos;
 
 
@@ -1973,11 +2005,11 @@ void Draw_filled_rectangle(short start_x,short start_y,short end_x,short end_y,b
     end_y=Limit_bottom;
 
   // On trace le rectangle:
-  for (y_pos=start_y;y_pos<=end_y;y_pos++)
-    for (x_pos=start_x;x_pos<=end_x;x_pos++)
-      // Display_pixel traite chaque pixel avec tous les effets ! (smear, ...)
-      // Donc on ne peut pas otimiser en traçant ligne par ligne avec memset :(
-      Display_pixel(x_pos,y_pos,color);
+  // Display_span() handles all the effects, and only uses memset when
+  // there is none.
+  if (start_x<=end_x)
+    for (y_pos=start_y;y_pos<=end_y;y_pos++)
+      Display_span(start_x,y_pos,end_x-start_x+1,color);
   Update_part_of_screen(start_x,start_y,end_x-start_x,end_y-start_y);
 
 }
@@ -2074,6 +2106,38 @@ void Hide_curve_preview(short x1, short y1,
 
   // -- Spray : un petit coup de Pschiitt! --
 
+/// One dot sprayed by the airbrush
+typedef struct
+{
+  short x;
+  short y;
+  byte  color;
+} T_Airbrush_dot;
+
+/// State of the airbrush random generator (xorshift32). Never 0.
+static dword Airbrush_random_state = 2463534242UL;
+/// Dots generated by the last call to Airbrush()
+static T_Airbrush_dot * Airbrush_dots = NULL;
+static long Airbrush_dots_size = 0;
+
+///
+/// Seed the airbrush random generator. Called at the start of each stroke.
+void Airbrush_seed(dword seed)
+{
+  Airbrush_random_state = seed ? seed : 2463534242UL;
+}
+
+/// Returns a random number in range [0, range-1]
+static short Airbrush_random(short range)
+{
+  dword x = Airbrush_random_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  Airbrush_random_state = x;
+  return (short)(((qword)x * (dword)range) >> 32);
+}
+
 void Airbrush(short clicked_button)
 {
   short x_pos,y_pos;
@@ -2082,24 +2146,67 @@ void Airbrush(short clicked_button)
   short index,count;
   byte  color_index;
   byte  direction;
+  long  nb_dots;
+  long  max_dots;
+  long  i;
+  short min_x, min_y, max_x, max_y; // range of useful dot positions
 
+  // Reserve room for the maximum number of dots
+  if (Airbrush_mode)
+    max_dots = Airbrush_mono_flow;
+  else
+    for (index=0, max_dots=0; index<256; index++)
+      max_dots += Airbrush_multi_flow[index];
+  if (max_dots == 0)
+    return;
+  if (max_dots > Airbrush_dots_size)
+  {
+    T_Airbrush_dot * new_dots = realloc(Airbrush_dots, max_dots * sizeof(T_Airbrush_dot));
+    if (new_dots == NULL)
+    {
+      GFX2_Log(GFX2_ERROR, "Airbrush(): failed to allocate %ld dots\n", max_dots);
+      return;
+    }
+    Airbrush_dots = new_dots;
+    Airbrush_dots_size = max_dots;
+  }
 
-  Hide_cursor();
+  // Dots whose paintbrush would be completely out of the image are skipped
+  if (Paintbrush_shape == PAINTBRUSH_SHAPE_COLOR_BRUSH
+   || Paintbrush_shape == PAINTBRUSH_SHAPE_MONO_BRUSH)
+  {
+    min_x = Brush_offset_X - Brush_width;
+    min_y = Brush_offset_Y - Brush_height;
+    max_x = Main.image_width + Brush_offset_X;
+    max_y = Main.image_height + Brush_offset_Y;
+  }
+  else
+  {
+    min_x = Paintbrush_offset_X - Paintbrush_width;
+    min_y = Paintbrush_offset_Y - Paintbrush_height;
+    max_x = Main.image_width + Paintbrush_offset_X;
+    max_y = Main.image_height + Paintbrush_offset_Y;
+  }
 
+  // First generate all the dots...
+  nb_dots = 0;
   if (Airbrush_mode)
   {
     for (count=1; count<=Airbrush_mono_flow; count++)
     {
-      x_pos=(rand()%Airbrush_size)-radius;
-      y_pos=(rand()%Airbrush_size)-radius;
+      x_pos=Airbrush_random(Airbrush_size)-radius;
+      y_pos=Airbrush_random(Airbrush_size)-radius;
       if ( (x_pos*x_pos)+(y_pos*y_pos) <= radius_squared )
       {
         x_pos+=Paintbrush_X;
         y_pos+=Paintbrush_Y;
-        if (clicked_button==1)
-          Draw_paintbrush(x_pos,y_pos,Fore_color);
-        else
-          Draw_paintbrush(x_pos,y_pos,Back_color);
+        if (x_pos > min_x && x_pos < max_x && y_pos > min_y && y_pos < max_y)
+        {
+          Airbrush_dots[nb_dots].x = x_pos;
+          Airbrush_dots[nb_dots].y = y_pos;
+          Airbrush_dots[nb_dots].color = (clicked_button==1) ? Fore_color : Back_color;
+          nb_dots++;
+        }
       }
     }
   }
@@ -2108,21 +2215,24 @@ void Airbrush(short clicked_button)
     //   On essaye de se balader dans la table des flux de façon à ce que ce
     // ne soit pas toujours la dernière couleur qui soit affichée en dernier
     // Pour ça, on part d'une couleur au pif dans une direction aléatoire.
-    direction=rand()&1;
-    for (index=0,color_index=rand()/*%256*/; index<256; index++)
+    direction=Airbrush_random(2);
+    for (index=0,color_index=(byte)Airbrush_random(256); index<256; index++)
     {
       for (count=1; count<=Airbrush_multi_flow[color_index]; count++)
       {
-        x_pos=(rand()%Airbrush_size)-radius;
-        y_pos=(rand()%Airbrush_size)-radius;
+        x_pos=Airbrush_random(Airbrush_size)-radius;
+        y_pos=Airbrush_random(Airbrush_size)-radius;
         if ( (x_pos*x_pos)+(y_pos*y_pos) <= radius_squared )
         {
           x_pos+=Paintbrush_X;
           y_pos+=Paintbrush_Y;
-          if (clicked_button==LEFT_SIDE)
-            Draw_paintbrush(x_pos,y_pos,color_index);
-          else
-            Draw_paintbrush(x_pos,y_pos,Back_color);
+          if (x_pos > min_x && x_pos < max_x && y_pos > min_y && y_pos < max_y)
+          {
+            Airbrush_dots[nb_dots].x = x_pos;
+            Airbrush_dots[nb_dots].y = y_pos;
+            Airbrush_dots[nb_dots].color = (clicked_button==LEFT_SIDE) ? color_index : Back_color;
+            nb_dots++;
+          }
         }
       }
       if (direction)
@@ -2132,6 +2242,11 @@ void Airbrush(short clicked_button)
     }
   }
 
+  // ...then draw them in the order they were generated : overlapping
+  // dots, and the effects which read the pixels already drawn, depend on it.
+  Hide_cursor();
+  for (i=0; i<nb_dots; i++)
+    Draw_paintbrush(Airbrush_dots[i].x, Airbrush_dots[i].y, Airbrush_dots[i].color);
   Display_cursor();
 }
 
@@ -2791,8 +2906,14 @@ void Polyfill_general(int vertices, short * points, int color)
           x_pos=Limit_left;
         if (end_x>Limit_right)
           end_x=Limit_right;
-        for (; x_pos<=end_x; x_pos++)
-          Pixel_figure(x_pos,c,color);
+        if (Pixel_figure == Pixel_clipped)
+        {
+          if (x_pos<=end_x)
+            Display_span(x_pos,c,end_x-x_pos+1,color);
+        }
+        else
+          for (; x_pos<=end_x; x_pos++)
+            Pixel_figure(x_pos,c,color);
         edge = edge->next->next;
       }
     }
@@ -3282,10 +3403,275 @@ static void Pixel_in_layer_with_opt_preview(int layer, word x,word y,byte color,
   }
 }
 
+/// How Display_span() and Display_rect_masked() draw their pixels
+enum SPAN_MODE
+{
+  SPAN_PER_PIXEL, ///< each pixel goes through Display_pixel()
+  SPAN_DIRECT,    ///< no effect : like Pixel_in_screen_direct_with_opt_preview()
+  SPAN_LAYERED,   ///< no effect : like Pixel_in_screen_layered_with_opt_preview()
+};
+
+/// Check if the pixels can be written without sieve, stencil, mask nor effect.
+static enum SPAN_MODE Get_span_mode(void)
+{
+  if (Sieve_mode || Stencil_mode || Mask_mode || Main.tilemap_mode || Effect_function != No_effect)
+    return SPAN_PER_PIXEL;
+  if (Pixel_in_current_screen_with_opt_preview == Pixel_in_screen_direct_with_opt_preview)
+    return SPAN_DIRECT;
+  if (Pixel_in_current_screen_with_opt_preview == Pixel_in_screen_layered_with_opt_preview)
+    return SPAN_LAYERED;
+  return SPAN_PER_PIXEL;
+}
+
+/// Update the screen for pixels just written in the current layer, in layered mode
+static void Span_layered_preview(word x, word y, word width, const byte * colors)
+{
+  const byte * depth = Main_visible_image_depth_buffer.Image + x + y*Main.image_width;
+  byte * screen = Main_screen + x + y*Main.image_width;
+  word i;
+
+  for (i = 0; i < width; i++)
+  {
+    if (depth[i] <= Main.current_layer)
+    {
+      byte color = colors[i];
+      if (color == Main.backups->Pages->Transparent_color) // transparent color
+        // fetch pixel color from the topmost visible layer
+        color = Read_pixel_from_layer(depth[i], x + i, y);
+      screen[i] = color;
+      Pixel_preview(x + i, y, color);
+    }
+  }
+}
+
+void Display_span(word x, word y, word width, byte color)
+{
+  byte * pixels = Main.backups->Pages->Image[Main.current_layer].Pixels + x + y*Main.image_width;
+  word i;
+
+  switch (Get_span_mode())
+  {
+    case SPAN_DIRECT:
+      memset(pixels, color, width);
+      for (i = 0; i < width; i++)
+        Pixel_preview(x + i, y, color);
+      break;
+    case SPAN_LAYERED:
+      memset(pixels, color, width);
+      Span_layered_preview(x, y, width, pixels);
+      break;
+    default:
+      for (i = 0; i < width; i++)
+        Display_pixel(x + i, y, color);
+  }
+}
+
+void Display_rect_masked(word x, word y, word width, word height, const byte * source, long source_pitch, byte transp_color)
+{
+  enum SPAN_MODE mode = Get_span_mode();
+  word i, j;
+
+  for (j = 0; j < height; j++, y++, source += source_pitch)
+  {
+    byte * pixels = Main.backups->Pages->Image[Main.current_layer].Pixels + y*Main.image_width;
+
+    if (mode == SPAN_PER_PIXEL)
+    {
+      for (i = 0; i < width; i++)
+        if (source[i] != transp_color)
+          Display_pixel(x + i, y, source[i]);
+    }
+    else
+    {
+      // Draw each run of opaque pixels at once
+      for (i = 0; i < width; )
+      {
+        word start;
+
+        while (i < width && source[i] == transp_color)
+          i++;
+        for (start = i; i < width && source[i] != transp_color; i++)
+          pixels[x + i] = source[i];
+        if (i == start)
+          continue;
+        if (mode == SPAN_LAYERED)
+          Span_layered_preview(x + start, y, i - start, pixels + x + start);
+        else
+        {
+          word k;
+          for (k = start; k < i; k++)
+            Pixel_preview(x + k, y, source[k]);
+        }
+      }
+    }
+  }
+}
+
 /// @defgroup constraints Special constaints drawing modes
 /// For 8bits machines modes (ZX Spectrum, C64, etc.)
 /// @{
 
+/// Maximum number of distinct colors in a ::T_Cell_summary
+#define CELL_SUMMARY_COLORS 8
+/// T_Cell_summary::Nb_colors value when the cell has more colors than
+/// ::CELL_SUMMARY_COLORS : it must be scanned.
+#define CELL_SUMMARY_OVERFLOW 0xFE
+/// T_Cell_summary::Nb_colors value when the summary must be computed
+#define CELL_SUMMARY_UNKNOWN 0xFF
+
+/// Colors used in a cell (attribute block) of the current layer,
+/// with their number of pixels.
+typedef struct
+{
+  byte Nb_colors;
+  byte Color[CELL_SUMMARY_COLORS];
+  byte Count[CELL_SUMMARY_COLORS];
+} T_Cell_summary;
+
+/// Summaries of the cells of the current layer, so the constraint checks
+/// don't need to read the whole cell for each pixel written.
+///
+/// They are computed when a cell is first drawn in, and updated by
+/// Pixel_in_summarized_cell(). Any other change of the layer must call
+/// Invalidate_cell_summaries().
+static struct
+{
+  T_Cell_summary * Cells;
+  long Allocated;      ///< number of allocated cells
+  const byte * Pixels; ///< summarized layer, NULL when the summaries are invalid
+  word Image_width;
+  word Image_height;
+  byte Cell_width;
+  byte Cell_height;
+} Cell_cache;
+
+void Invalidate_cell_summaries(void)
+{
+  Cell_cache.Pixels = NULL;
+}
+
+/// Count one more pixel of a color in a cell summary
+static void Cell_summary_add(T_Cell_summary * cell, byte color)
+{
+  int i;
+
+  if (cell->Nb_colors > CELL_SUMMARY_COLORS)
+    return;
+  for (i = 0; i < cell->Nb_colors; i++)
+  {
+    if (cell->Color[i] == color)
+    {
+      cell->Count[i]++;
+      return;
+    }
+  }
+  if (cell->Nb_colors == CELL_SUMMARY_COLORS)
+  {
+    cell->Nb_colors = CELL_SUMMARY_OVERFLOW;
+    return;
+  }
+  cell->Color[cell->Nb_colors] = color;
+  cell->Count[cell->Nb_colors] = 1;
+  cell->Nb_colors++;
+}
+
+/// Count one less pixel of a color in a cell summary
+static void Cell_summary_remove(T_Cell_summary * cell, byte color)
+{
+  int i;
+
+  if (cell->Nb_colors > CELL_SUMMARY_COLORS)
+  {
+    // the cell may have few enough colors now
+    cell->Nb_colors = CELL_SUMMARY_UNKNOWN;
+    return;
+  }
+  for (i = 0; i < cell->Nb_colors; i++)
+  {
+    if (cell->Color[i] == color)
+    {
+      if (--cell->Count[i] == 0)
+      {
+        cell->Nb_colors--;
+        cell->Color[i] = cell->Color[cell->Nb_colors];
+        cell->Count[i] = cell->Count[cell->Nb_colors];
+      }
+      return;
+    }
+  }
+  // The summary doesn't match the layer
+  cell->Nb_colors = CELL_SUMMARY_UNKNOWN;
+}
+
+/// Get the summary of the cell of the current layer containing a pixel.
+///
+/// @return NULL if the cell is not completely in the image
+static T_Cell_summary * Get_cell_summary(word x, word y, byte cell_width, byte cell_height)
+{
+  const byte * pixels = Main.backups->Pages->Image[Main.current_layer].Pixels;
+  long cells_per_line = (Main.image_width + cell_width - 1) / cell_width;
+  word start_x = x - x % cell_width;
+  word start_y = y - y % cell_height;
+  T_Cell_summary * cell;
+
+  if (start_x + cell_width > Main.image_width || start_y + cell_height > Main.image_height)
+    return NULL;
+
+  if (Cell_cache.Pixels != pixels
+   || Cell_cache.Image_width != Main.image_width
+   || Cell_cache.Image_height != Main.image_height
+   || Cell_cache.Cell_width != cell_width
+   || Cell_cache.Cell_height != cell_height)
+  {
+    long nb_cells = cells_per_line * ((Main.image_height + cell_height - 1) / cell_height);
+    long i;
+
+    if (nb_cells > Cell_cache.Allocated)
+    {
+      T_Cell_summary * cells = (T_Cell_summary *)realloc(Cell_cache.Cells, nb_cells * sizeof(T_Cell_summary));
+      if (cells == NULL)
+        return NULL;
+      Cell_cache.Cells = cells;
+      Cell_cache.Allocated = nb_cells;
+    }
+    for (i = 0; i < nb_cells; i++)
+      Cell_cache.Cells[i].Nb_colors = CELL_SUMMARY_UNKNOWN;
+    Cell_cache.Pixels = pixels;
+    Cell_cache.Image_width = Main.image_width;
+    Cell_cache.Image_height = Main.image_height;
+    Cell_cache.Cell_width = cell_width;
+    Cell_cache.Cell_height = cell_height;
+  }
+
+  cell = Cell_cache.Cells + (y / cell_height) * cells_per_line + x / cell_width;
+  if (cell->Nb_colors == CELL_SUMMARY_UNKNOWN)
+  {
+    word x2, y2;
+
+    cell->Nb_colors = 0;
+    for (y2 = start_y; y2 < start_y + cell_height; y2++)
+      for (x2 = start_x; x2 < start_x + cell_width; x2++)
+        Cell_summary_add(cell, pixels[x2 + y2 * Main.image_width]);
+  }
+  return cell;
+}
+
+/// Paint a pixel in layered mode, and update the summary of its cell.
+/// @param cell  summary of the cell of the pixel, as returned by Get_cell_summary()
+static void Pixel_in_summarized_cell(T_Cell_summary * cell, word x, word y, byte color, int preview)
+{
+  if (cell != NULL)
+  {
+    byte old_color = Read_pixel_from_current_layer(x, y);
+    if (old_color != color)
+    {
+      Cell_summary_remove(cell, old_color);
+      Cell_summary_add(cell, color);
+    }
+  }
+  Pixel_in_screen_layered_with_opt_preview(x, y, color, preview);
+}
+
 /// Paint a pixel in CPC EGX mode
 ///
 /// even lines have 2x more pixel than odd lines, but less colors
@@ -3317,6 +3703,8 @@ static void Pixel_in_screen_thomson_with_opt_preview(word x,word y,byte color,in
   word start = x & 0xFFF8;
   word x2;
   uint8_t c1, c2;
+  T_Cell_summary * cell;
+  int i;
 
   // The color we are going to replace
   c1 = Read_pixel_from_current_layer(x, y);
@@ -3324,19 +3712,38 @@ static void Pixel_in_screen_thomson_with_opt_preview(word x,word y,byte color,in
   if (c1 == color)
     return;
 
-  for (x2 = 0; x2 < 8; x2++)
+  cell = Get_cell_summary(x, y, 8, 1);
+  if (cell == NULL)
+    Invalidate_cell_summaries(); // pixels outside of the cell can be modified
+  if (cell != NULL && cell->Nb_colors <= CELL_SUMMARY_COLORS)
   {
-    c2 = Read_pixel_from_current_layer(start+x2, y);
-    if (c2 == color)
-      continue;
-    if (c2 != c1)
-      break;
+    // look for a third color
+    c2 = c1;
+    for (i = 0; i < cell->Nb_colors; i++)
+    {
+      if (cell->Color[i] != color && cell->Color[i] != c1)
+      {
+        c2 = cell->Color[i];
+        break;
+      }
+    }
+  }
+  else
+  {
+    for (x2 = 0; x2 < 8; x2++)
+    {
+      c2 = Read_pixel_from_current_layer(start+x2, y);
+      if (c2 == color)
+        continue;
+      if (c2 != c1)
+        break;
+    }
   }
 
   if (c2 == c1 || c2 == color)
   {
     // There was only one color, so we can add a second one.
-    Pixel_in_screen_layered_with_opt_preview(x,y,color,preview);
+    Pixel_in_summarized_cell(cell,x,y,color,preview);
     return;
   }
 
@@ -3344,7 +3751,7 @@ static void Pixel_in_screen_thomson_with_opt_preview(word x,word y,byte color,in
   {
     c2 = Read_pixel_from_current_layer(start+x2, y);
     if (c2 == c1) {
-      Pixel_in_screen_layered_with_opt_preview(x2+start,y,color,preview);
+      Pixel_in_summarized_cell(cell,x2+start,y,color,preview);
     }
   }
 }
@@ -3359,6 +3766,8 @@ static void Pixel_in_screen_zx_with_opt_preview(word x,word y,byte color,int pre
   word starty = y & 0xFFF8;
   word x2, y2;
   uint8_t c1, c2;
+  T_Cell_summary * cell;
+  int i;
 
   // The color we are going to replace
   c1 = Read_pixel_from_current_layer(x, y);
@@ -3367,19 +3776,39 @@ static void Pixel_in_screen_zx_with_opt_preview(word x,word y,byte color,int pre
   if (c1 == color)
     return;
 
-  // Check the whole cell
-  for (x2 = 0; x2 < 8; x2++)
-  for (y2 = 0; y2 < 8; y2++)
+  cell = Get_cell_summary(x, y, 8, 8);
+  if (cell == NULL)
+    Invalidate_cell_summaries(); // pixels outside of the cell can be modified
+  if (cell != NULL && cell->Nb_colors <= CELL_SUMMARY_COLORS)
   {
-    c2 = Read_pixel_from_current_layer(x2 + start, y2 + starty);
-    // Pixel is already of the color we are going to add, it is no problem
-    if (c2 == color)
-      continue;
-    // We have found another color, which is the one we will keep from the cell
-    if (c2 != c1)
-      goto done;
+    // Look for another color, which is the one we will keep from the cell
+    for (i = 0; i < cell->Nb_colors; i++)
+    {
+      if (cell->Color[i] != color && cell->Color[i] != c1)
+        break;
+    }
+    if (i < cell->Nb_colors)
+      c2 = cell->Color[i];
+    else // same as the end of the scan below
+      c2 = Read_pixel_from_current_layer(start + 7, starty + 7);
   }
+  else
+  {
+    // Check the whole cell
+    for (x2 = 0; x2 < 8; x2++)
+    for (y2 = 0; y2 < 8; y2++)
+    {
+      c2 = Read_pixel_from_current_layer(x2 + start, y2 + starty);
+      // Pixel is already of the color we are going to add, it is no problem
+      if (c2 == color)
+        continue;
+      // We have found another color, which is the one we will keep from the cell
+      if (c2 != c1)
+        goto done;
+    }
 done:
+    ;
+  }
 
   if ((c2 == c1 || c2 == color))
   {
@@ -3392,11 +3821,11 @@ done:
       for (x2 = 0; x2 < 8; x2++)
       for (y2 = 0; y2 < 8; y2++)
       {
-        Pixel_in_screen_layered_with_opt_preview(x2+start,y2+starty,c2 ^ 8,preview);
+        Pixel_in_summarized_cell(cell,x2+start,y2+starty,c2 ^ 8,preview);
       }
     }
 
-    Pixel_in_screen_layered_with_opt_preview(x,y,color,preview);
+    Pixel_in_summarized_cell(cell,x,y,color,preview);
     return;
   }
 
@@ -3406,9 +3835,9 @@ done:
   {
     c2 = Read_pixel_from_current_layer(x2 + start, y2 + starty);
     if (c2 == c1)
-      Pixel_in_screen_layered_with_opt_preview(x2+start,y2+starty,color,preview);
+      Pixel_in_summarized_cell(cell,x2+start,y2+starty,color,preview);
     else if (Main.backups->Pages->Image_mode == IMAGE_MODE_ZX)  // Force the brightness bit
-      Pixel_in_screen_layered_with_opt_preview(x2+start,y2+starty,(c2 & ~8) | (color & 8),preview);
+      Pixel_in_summarized_cell(cell,x2+start,y2+starty,(c2 & ~8) | (color & 8),preview);
   }
 }
 
@@ -3424,6 +3853,8 @@ static void Pixel_in_screen_gbc_with_opt_preview(word x,word y,byte color,int pr
   word x2, y2;
   byte palette;
   byte col_mask, pal_mask;
+  T_Cell_summary * cell;
+  int i;
 
   if (Main.backups->Pages->Image_mode == IMAGE_MODE_MEGADRIVE)
     col_mask = 15;
@@ -3431,9 +3862,23 @@ static void Pixel_in_screen_gbc_with_opt_preview(word x,word y,byte color,int pr
     col_mask = 3;
   pal_mask = ~col_mask;
 
+  cell = Get_cell_summary(x, y, 8, 8);
+  if (cell == NULL)
+    Invalidate_cell_summaries(); // pixels outside of the cell can be modified
   // first set the pixel
-  Pixel_in_screen_layered_with_opt_preview(x,y,color,preview);
+  Pixel_in_summarized_cell(cell,x,y,color,preview);
   palette = color & pal_mask;
+  if (cell != NULL && cell->Nb_colors <= CELL_SUMMARY_COLORS)
+  {
+    // nothing to do if the block already uses a single palette
+    for (i = 0; i < cell->Nb_colors; i++)
+    {
+      if ((cell->Color[i] & pal_mask) != palette)
+        break;
+    }
+    if (i == cell->Nb_colors)
+      return;
+  }
   // force all pixels of the block to the same palette
   for (y2 = 0; y2 < 8; y2++)
   {
@@ -3441,7 +3886,7 @@ static void Pixel_in_screen_gbc_with_opt_preview(word x,word y,byte color,int pr
     {
       byte col = Read_pixel_from_current_layer(startx+x2, starty+y2);
       if ((col & pal_mask) != palette)
-        Pixel_in_screen_layered_with_opt_preview(startx+x2, starty+y2, palette | (col & col_mask), preview);
+        Pixel_in_summarized_cell(cell, startx+x2, starty+y2, palette | (col & col_mask), preview);
     }
   }
 }
@@ -3460,11 +3905,36 @@ static void Pixel_in_screen_c64multi_with_opt_preview(word x,word y,byte color,i
   byte col, old_color;
   byte c[4] = { 0, 0, 0, 0 };  // palette of 4 colors for the block
   int i, n;
+  T_Cell_summary * cell;
 
   old_color = Read_pixel_from_current_layer(x, y);
   if (old_color == color)
     return; // nothing to do if the color doesn't change !
 
+  cell = Get_cell_summary(x, y, 4, 8);
+  if (cell == NULL)
+    Invalidate_cell_summaries(); // pixels outside of the cell can be modified
+  else if (cell->Nb_colors <= CELL_SUMMARY_COLORS)
+  {
+    // count the colors of the block, besides the background 0
+    int others = 0;
+    int has_color = (color == 0);
+
+    for (i = 0; i < cell->Nb_colors; i++)
+    {
+      if (cell->Color[i] != 0)
+        others++;
+      if (cell->Color[i] == color)
+        has_color = 1;
+    }
+    if (others < 3 || (others == 3 && has_color))
+    {
+      // the new color fits in the 4 colors of the block
+      Pixel_in_summarized_cell(cell,x,y,color,preview);
+      return;
+    }
+  }
+
   c[0] = 0; // assume background is 0
   n = 1;  // counted colors
   for (y2 = 0; y2 < 8; y2++)
@@ -3483,21 +3953,21 @@ static void Pixel_in_screen_c64multi_with_opt_preview(word x,word y,byte color,i
         if (n < 4)
           c[n++] = col; // set color in palette
         else  // already more than 3 colors (+ background) in the block. Fix it
-          Pixel_in_screen_layered_with_opt_preview(startx+x2,starty+y2,color,preview);
+          Pixel_in_summarized_cell(cell,startx+x2,starty+y2,color,preview);
       }
     }
   }
   if (n < 4)
   {
     // there is less than 4 colors in the block : nothing special to do
-    Pixel_in_screen_layered_with_opt_preview(x,y,color,preview);
+    Pixel_in_summarized_cell(cell,x,y,color,preview);
     return;
   }
   for (i = 0; i < n; i++)
     if (color == c[i])
     {
       // The new color is already in the palette, nothing special to do
-      Pixel_in_screen_layered_with_opt_preview(x,y,color,preview);
+      Pixel_in_summarized_cell(cell,x,y,color,preview);
       return;
     }
   // The execution reaches this point only if plotting the new color
@@ -3512,7 +3982,7 @@ static void Pixel_in_screen_c64multi_with_opt_preview(word x,word y,byte color,i
     {
       col = Read_pixel_from_current_layer(startx+x2, starty+y2);
       if (col == old_color)
-        Pixel_in_screen_layered_with_opt_preview(startx+x2,starty+y2,color,preview);
+        Pixel_in_summarized_cell(cell,startx+x2,starty+y2,color,preview);
     }
   }
 }
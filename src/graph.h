@@ -49,6 +49,29 @@ void Display_foreback(void);
 
 void Display_pixel(word x,word y,byte color);
 
+/// Display a horizontal line of pixels of the same color.
+///
+/// Same result as calling Display_pixel() for each pixel, but when no
+/// sieve, stencil, mask or effect is active, the pixels are written at once.
+/// The line must be within the limits.
+void Display_span(word x, word y, word width, byte color);
+
+/// Display a rectangle of pixels, skipping those of the transparent color.
+///
+/// Same result as calling Display_pixel() for each opaque pixel, but when no
+/// sieve, stencil, mask or effect is active, the pixels are written at once.
+/// The rectangle must be within the limits.
+/// @param source       first pixel to display
+/// @param source_pitch distance between 2 lines of the source, in bytes
+/// @param transp_color pixels of this color are not displayed
+void Display_rect_masked(word x, word y, word width, word height, const byte * source, long source_pitch, byte transp_color);
+
+/// Forget the colors counted in the cells of the constrained drawing modes.
+///
+/// Must be called when the pixels of the current layer are modified
+/// without going through the drawing functions.
+void Invalidate_cell_summaries(void);
+
 void Display_paintbrush(short x,short y,byte color);
 void Draw_paintbrush(short x,short y,byte color);
 void Hide_paintbrush(short x,short y);
@@ -99,6 +122,7 @@ void Draw_curve_permanent(short x1, short y1, short x2, short y2, short x3, shor
 void Draw_curve_preview  (short x1, short y1, short x2, short y2, short x3, short y3, short x4, short y4, byte color);
 void Hide_curve_preview (short x1, short y1, short x2, short y2, short x3, short y3, short x4, short y4, byte color);
 
+void Airbrush_seed(dword seed);
 void Airbrush(short clicked_button);
 
 void Gradient_basic           (long index,short x_pos,short y_pos);
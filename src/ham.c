@@ -0,0 +1,182 @@
+/* vim:expandtab:ts=2 sw=2:
+*/
+/*  Grafx2 - The Ultimate 256-color bitmap paint program
+
+    Copyright 2026 GrafX2 contributors
+
+    Grafx2 is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; version 2
+    of the License.
+
+    Grafx2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Grafx2; if not, see <http://www.gnu.org/licenses/>
+*/
+
+///@file ham.c
+/// Amiga HAM (Hold And Modify) decoding and encoding.
+///
+/// The decoder works on whole spans of control codes, as returned by
+/// Planar_to_chunky(), and keeps the current color packed in a dword so
+/// a modify operation is a mask and an or.
+///
+/// The encoder looks up the nearest base color in a table indexed by the
+/// 12 bits (4 bits per component) approximation of the target color, built
+/// once per palette, instead of searching the whole palette for each pixel.
+
+#include "struct.h"
+#include "ham.h"
+
+void HAM_Pack_palette(dword * base, const T_Components * palette, int count)
+{
+  int i;
+
+  for (i = 0; i < count; i++)
+    base[i] = HAM_RGB(palette[i].R, palette[i].G, palette[i].B);
+}
+
+dword HAM_Decode(const byte * codes, dword * rgb, int count, byte bitplanes, const dword * base, dword color)
+{
+  int i;
+
+  if (bitplanes == 6)
+  {
+    for (i = 0; i < count; i++)
+    {
+      byte code = codes[i];
+      dword value = (code & 0x0F) * 0x11;
+
+      switch (code & 0x30)
+      {
+        case 0x10: // blue
+          color = (color & 0xFFFF00) | value;
+          break;
+        case 0x20: // red
+          color = (color & 0x00FFFF) | (value << 16);
+          break;
+        case 0x30: // green
+          color = (color & 0xFF00FF) | (value << 8);
+          break;
+        default:   // base color
+          color = base[code & 0x0F];
+      }
+      rgb[i] = color;
+    }
+  }
+  else
+  {
+    for (i = 0; i < count; i++)
+    {
+      byte code = codes[i];
+      // 6 bits value : the 2 upper bits are copied to the lower bits
+      dword value = ((code & 0x3F) << 2) | ((code & 0x30) >> 4);
+
+      switch (code >> 6)
+      {
+        case 1:   // blue
+          color = (color & 0xFFFF00) | value;
+          break;
+        case 2:   // red
+          color = (color & 0x00FFFF) | (value << 16);
+          break;
+        case 3:   // green
+          color = (color & 0xFF00FF) | (value << 8);
+          break;
+        default:  // base color
+          color = base[code & 0x3F];
+      }
+      rgb[i] = color;
+    }
+  }
+  return color;
+}
+
+/// Squared distance between two packed colors
+static dword HAM_Distance(dword c1, dword c2)
+{
+  int dr = (int)HAM_R(c1) - (int)HAM_R(c2);
+  int dg = (int)HAM_G(c1) - (int)HAM_G(c2);
+  int db = (int)HAM_B(c1) - (int)HAM_B(c2);
+
+  return (dword)(dr * dr + dg * dg + db * db);
+}
+
+void HAM_Encoder_init(T_HAM_encoder * encoder, const T_Components * palette, byte bitplanes)
+{
+  int i, index;
+
+  encoder->Bitplanes = bitplanes;
+  encoder->Base_count = (bitplanes == 6) ? 16 : 64;
+  HAM_Pack_palette(encoder->Base, palette, encoder->Base_count);
+
+  for (index = 0; index < 4096; index++)
+  {
+    dword target = HAM_RGB((index >> 8) * 0x11, ((index >> 4) & 15) * 0x11, (index & 15) * 0x11);
+    dword best_distance = HAM_Distance(target, encoder->Base[0]);
+    byte best = 0;
+
+    for (i = 1; i < encoder->Base_count && best_distance > 0; i++)
+    {
+      dword distance = HAM_Distance(target, encoder->Base[i]);
+      if (distance < best_distance)
+      {
+        best_distance = distance;
+        best = (byte)i;
+      }
+    }
+    encoder->Nearest[index] = best;
+  }
+}
+
+void HAM_Encode_line(const T_HAM_encoder * encoder, const dword * rgb, byte * codes, int count)
+{
+  int i, component;
+  dword color = encoder->Base[0];
+  // for blue, red and green : control code and position in the packed color
+  static const byte modify_code[2][3] = { { 0x10, 0x20, 0x30 }, { 0x40, 0x80, 0xC0 } };
+  static const byte modify_shift[3] = { 0, 16, 8 };
+  int ham8 = (encoder->Bitplanes != 6);
+
+  for (i = 0; i < count; i++)
+  {
+    dword target = rgb[i];
+    int index = (((HAM_R(target) + 8) / 17) << 8) | (((HAM_G(target) + 8) / 17) << 4) | ((HAM_B(target) + 8) / 17);
+    byte best_code = encoder->Nearest[index];
+    dword best_color = encoder->Base[best_code];
+    dword best_distance = HAM_Distance(target, best_color);
+
+    for (component = 0; component < 3 && best_distance > 0; component++)
+    {
+      byte shift = modify_shift[component];
+      byte wanted = (byte)(target >> shift);
+      byte level;
+      dword value, candidate, distance;
+
+      if (ham8)
+      {
+        level = (byte)((wanted * 63 + 127) / 255);
+        value = (level << 2) | (level >> 4);
+      }
+      else
+      {
+        level = (byte)((wanted + 8) / 17);
+        value = level * 0x11;
+      }
+      candidate = (color & ~((dword)0xFF << shift)) | (value << shift);
+      distance = HAM_Distance(target, candidate);
+      if (distance < best_distance)
+      {
+        best_distance = distance;
+        best_color = candidate;
+        best_code = modify_code[ham8][component] | level;
+      }
+    }
+    codes[i] = best_code;
+    color = best_color;
+  }
+}
@@ -0,0 +1,95 @@
+/* vim:expandtab:ts=2 sw=2:
+*/
+/*  Grafx2 - The Ultimate 256-color bitmap paint program
+
+    Copyright 2026 GrafX2 contributors
+
+    Grafx2 is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; version 2
+    of the License.
+
+    Grafx2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Grafx2; if not, see <http://www.gnu.org/licenses/>
+*/
+
+///@file ham.h
+/// Amiga HAM (Hold And Modify) decoding and encoding.
+///
+/// HAM pixels are control codes : the 2 upper bits tell whether the pixel
+/// is a base color from the palette, or the previous pixel with its blue,
+/// red or green component modified. HAM6 uses 6 bitplanes (16 base colors
+/// and 4 bits components), HAM8 uses 8 bitplanes (64 base colors and
+/// 6 bits components).
+///
+/// Colors are handled as packed 0x00RRGGBB values.
+
+#ifndef HAM_H_INCLUDED
+#define HAM_H_INCLUDED
+
+#define HAM_RGB(r,g,b) (((dword)(r) << 16) | ((dword)(g) << 8) | (dword)(b))
+#define HAM_R(rgb) ((byte)((rgb) >> 16))
+#define HAM_G(rgb) ((byte)((rgb) >> 8))
+#define HAM_B(rgb) ((byte)(rgb))
+
+/**
+ * Pack palette colors to 0x00RRGGBB values.
+ *
+ * @param base    destination
+ * @param palette source palette
+ * @param count   number of colors
+ */
+void HAM_Pack_palette(dword * base, const T_Components * palette, int count);
+
+/**
+ * Decode a span of HAM control codes.
+ *
+ * A line is started with the color base[0], longer lines can be decoded
+ * in several spans by passing the value returned for the previous span.
+ *
+ * @param codes     control codes, one byte per pixel
+ * @param rgb       destination, one 0x00RRGGBB value per pixel
+ * @param count     number of pixels
+ * @param bitplanes 6 for HAM6, 8 for HAM8
+ * @param base      base colors, as returned by HAM_Pack_palette()
+ * @param color     color of the pixel preceding the span
+ * @return the color of the last pixel of the span
+ */
+dword HAM_Decode(const byte * codes, dword * rgb, int count, byte bitplanes, const dword * base, dword color);
+
+/// Precomputed state of the HAM encoder for one palette
+typedef struct
+{
+  byte Bitplanes;          ///< 6 for HAM6, 8 for HAM8
+  byte Base_count;         ///< 16 or 64
+  dword Base[64];          ///< base colors
+  byte Nearest[4096];      ///< nearest base color of each 0xRGB 12 bits color
+} T_HAM_encoder;
+
+/**
+ * Prepare the encoder for a palette.
+ *
+ * @param encoder   state to initialize
+ * @param palette   palette, only the first 16 (HAM6) or 64 (HAM8) colors are used
+ * @param bitplanes 6 for HAM6, 8 for HAM8
+ */
+void HAM_Encoder_init(T_HAM_encoder * encoder, const T_Components * palette, byte bitplanes);
+
+/**
+ * Encode a line of 24 bits pixels to HAM control codes.
+ *
+ * Each pixel uses the code giving the color closest to the target.
+ *
+ * @param encoder state prepared by HAM_Encoder_init()
+ * @param rgb     source pixels, 0x00RRGGBB values
+ * @param codes   destination control codes, one byte per pixel
+ * @param count   number of pixels
+ */
+void HAM_Encode_line(const T_HAM_encoder * encoder, const dword * rgb, byte * codes, int count);
+
+#endif
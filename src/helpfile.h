@@ -229,6 +229,7 @@ static const T_Help_table helptable_help[] =
   HELP_LINK ("  Zoom in more:      %s",   SPECIAL_ZOOM_IN_MORE)
   HELP_LINK ("  Zoom out:          %s",   SPECIAL_ZOOM_OUT)
   HELP_LINK ("  Zoom out more:     %s",   SPECIAL_ZOOM_OUT_MORE)
+  HELP_LINK ("  Overview:          %s",   SPECIAL_OVERVIEW)
   HELP_LINK ("  1:1 (off)          %s",   SPECIAL_ZOOM_1)
   HELP_LINK ("  2:1                %s",   SPECIAL_ZOOM_2)
   HELP_LINK ("  3:1                %s",   SPECIAL_ZOOM_3)
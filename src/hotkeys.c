@@ -1840,6 +1840,14 @@ T_Key_config ConfigKey[NB_SHORTCUTS] = {
   true,
   KEY_KP_MINUS|GFX2_MOD_SHIFT, // Shift+-
   KEY_MOUSEWHEELDOWN|GFX2_MOD_SHIFT},
+  {211,
+  "Overview",
+  "Shows a reduced view of the whole",
+  "picture. Click in it to scroll",
+  "there.",
+  true,
+  KEY_o|GFX2_MOD_CTRL, // Ctrl + O
+  0},
 };
 
 word Ordering[NB_SHORTCUTS]=
@@ -2056,4 +2064,5 @@ word Ordering[NB_SHORTCUTS]=
   SPECIAL_HOLD_PAN,
   SPECIAL_ZOOM_IN_MORE,             // Zoom in more
   SPECIAL_ZOOM_OUT_MORE,            // Zoom out more
+  SPECIAL_OVERVIEW,                 // Overview
 };
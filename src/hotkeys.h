@@ -32,7 +32,7 @@
     #define bool char
 #endif
 
-#define NB_SHORTCUTS 212   ///< Number of actions that can have a key combination associated to it.
+#define NB_SHORTCUTS 213   ///< Number of actions that can have a key combination associated to it.
 
 /*** Types definitions and structs ***/
 
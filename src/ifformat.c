@@ -29,11 +29,16 @@
 
 #include <stdlib.h>
 #include <string.h>
+#ifndef _MSC_VER
+#include <strings.h>
+#endif
 #include "fileformats.h"
 #include "loadsavefuncs.h"
 #include "io.h"
 #include "misc.h"
 #include "packbits.h"
+#include "bitplanes.h"
+#include "ham.h"
 #include "gfx2mem.h"
 #include "gfx2log.h"
 
@@ -184,6 +189,7 @@ void Test_ACBM(T_IO_Context * context, FILE * f)
 typedef struct T_IFF_PCHG_Palette {
   struct T_IFF_PCHG_Palette * Next;
   short StartLine;
+  word Nb_colors;             ///< number of entries in Palette
   T_Components Palette[1];
 } T_IFF_PCHG_Palette;
 
@@ -224,30 +230,6 @@ static byte IFF_Wait_for(FILE * file, const char * expected_section)
 // Les images ILBM sont stockés en bitplanes donc on doit trifouiller les bits pour
 // en faire du chunky
 
-///
-/// Decodes the color of one pixel from the ILBM line buffer.
-/// Planar to chunky conversion
-/// @param buffer          Planar buffer
-/// @param x_pos           Position of the pixel in graphic line
-/// @param real_line_size  Width of one bitplane in memory, in bytes
-/// @param bitplanes       Number of bitplanes
-static dword Get_IFF_color(const byte * buffer, word x_pos, word real_line_size, byte bitplanes)
-{
-  byte shift = 7 - (x_pos & 7);
-  int address,masked_bit,plane;
-  dword color=0;
-
-  for(plane=bitplanes-1;plane>=0;plane--)
-  {
-    address = (real_line_size * plane + x_pos) >> 3;
-    masked_bit = (buffer[address] >> shift) & 1;
-
-    color = (color << 1) + masked_bit;
-  }
-
-  return color;
-}
-
 /// chunky to planar
 static void Set_IFF_color(byte * buffer, word x_pos, byte color, word real_line_size, byte bitplanes)
 {
@@ -262,6 +244,9 @@ static void Set_IFF_color(byte * buffer, word x_pos, byte color, word real_line_
   }
 }
 
+/// Number of pixels converted at once by Draw_IFF_line() etc.
+#define IFF_CONVERSION_BLOCK 256
+
 // ----------------------- Afficher une ligne ILBM ------------------------
 /// Planar to chunky conversion of a line
 /// @param context         the IO context
@@ -271,110 +256,117 @@ static void Set_IFF_color(byte * buffer, word x_pos, byte color, word real_line_
 /// @param bitplanes       Number of bitplanes
 void Draw_IFF_line(T_IO_Context *context, const byte * buffer, short y_pos, short real_line_size, byte bitplanes)
 {
-  short x_pos;
-
-  if (bitplanes > 8)
+  short x_pos, x_start;
+  int count, i;
+  int plane_line_size = real_line_size >> 3;
+  byte pixels[3][IFF_CONVERSION_BLOCK];
+
+  // pixels are converted by blocks, as x_start is a multiple of 8 bits,
+  // planes keep the same interleave
+  for (x_start = 0; x_start < context->Width; x_start += IFF_CONVERSION_BLOCK)
   {
-    for (x_pos=0; x_pos<context->Width; x_pos++)
+    count = context->Width - x_start;
+    if (count > IFF_CONVERSION_BLOCK)
+      count = IFF_CONVERSION_BLOCK;
+    if (bitplanes > 8)
     {
       // Default standard deep ILBM bit ordering:
       // saved first -----------------------------------------------> saved last
       // R0 R1 R2 R3 R4 R5 R6 R7 G0 G1 G2 G3 G4 G5 G6 G7 B0 B1 B2 B3 B4 B5 B6 B7
-      dword rgb = Get_IFF_color(buffer, x_pos,real_line_size, bitplanes);
-      Set_pixel_24b(context, x_pos,y_pos, rgb, rgb >> 8, rgb >> 16);  // R is 8 LSB, etc.
+      memset(pixels, 0, sizeof(pixels));
+      for (i = 0; i < 3 && i * 8 < bitplanes; i++)
+        Planar_to_chunky(buffer + (x_start >> 3) + i * 8 * plane_line_size, pixels[i], count,
+                         (bitplanes - i * 8) > 8 ? 8 : (bitplanes - i * 8), plane_line_size);
+      for (x_pos = 0; x_pos < count; x_pos++)
+        Set_pixel_24b(context, x_start + x_pos, y_pos, pixels[0][x_pos], pixels[1][x_pos], pixels[2][x_pos]);
+    }
+    else
+    {
+      Planar_to_chunky(buffer + (x_start >> 3), pixels[0], count, bitplanes, plane_line_size);
+      for (x_pos = 0; x_pos < count; x_pos++)
+        Set_pixel(context, x_start + x_pos, y_pos, pixels[0][x_pos]);
     }
   }
-  else for (x_pos=0; x_pos<context->Width; x_pos++)
+}
+
+/// Find the palette of a line in a PCHG palette list.
+///
+/// Lines are decoded from top to bottom, so the search continues from the
+/// palette found for the previous line instead of the start of the list.
+/// @param cursor  palette of the previous line, updated
+/// @param y_pos   Current line
+static const T_IFF_PCHG_Palette * IFF_PCHG_line_palette(const T_IFF_PCHG_Palette ** cursor, short y_pos)
+{
+  const T_IFF_PCHG_Palette * palette = *cursor;
+
+  if (palette != NULL)
   {
-    Set_pixel(context, x_pos, y_pos, Get_IFF_color(buffer, x_pos,real_line_size, bitplanes));
+    while (palette->Next != NULL && palette->Next->StartLine <= y_pos)
+      palette = palette->Next;
+    *cursor = palette;
   }
+  return palette;
 }
 
 /// decode pixels with palette changes per line (copper list:)
-static void Draw_IFF_line_PCHG(T_IO_Context *context, const byte * buffer, short y_pos, short real_line_size, byte bitplanes, const T_IFF_PCHG_Palette * PCHG_palettes)
+static void Draw_IFF_line_PCHG(T_IO_Context *context, const byte * buffer, short y_pos, short real_line_size, byte bitplanes, const T_IFF_PCHG_Palette ** PCHG_cursor)
 {
   const T_IFF_PCHG_Palette * palette;
-  short x_pos;
+  short x_pos, x_start;
+  int count;
+  byte pixels[IFF_CONVERSION_BLOCK];
 
-  palette = PCHG_palettes;  // find the palette to use for the line
+  palette = IFF_PCHG_line_palette(PCHG_cursor, y_pos);
   if (palette == NULL)
     return;
-  while (palette->Next != NULL && palette->Next->StartLine <= y_pos)
-    palette = palette->Next;
 
-  for (x_pos=0; x_pos<context->Width; x_pos++)
+  for (x_start = 0; x_start < context->Width; x_start += IFF_CONVERSION_BLOCK)
   {
-    dword c = Get_IFF_color(buffer, x_pos,real_line_size, bitplanes);
-    Set_pixel_24b(context, x_pos,y_pos, palette->Palette[c].R, palette->Palette[c].G, palette->Palette[c].B);
+    count = context->Width - x_start;
+    if (count > IFF_CONVERSION_BLOCK)
+      count = IFF_CONVERSION_BLOCK;
+    Planar_to_chunky(buffer + (x_start >> 3), pixels, count, bitplanes, real_line_size >> 3);
+    for (x_pos = 0; x_pos < count; x_pos++)
+    {
+      byte c = pixels[x_pos];
+      Set_pixel_24b(context, x_start + x_pos, y_pos, palette->Palette[c].R, palette->Palette[c].G, palette->Palette[c].B);
+    }
   }
 }
 
 /// Decode a HAM line to 24bits pixels
-static void Draw_IFF_line_HAM(T_IO_Context *context, const byte * buffer, short y_pos, short real_line_size, byte bitplanes, const T_IFF_PCHG_Palette * PCHG_palettes)
+static void Draw_IFF_line_HAM(T_IO_Context *context, const byte * buffer, short y_pos, short real_line_size, byte bitplanes, const T_IFF_PCHG_Palette ** PCHG_cursor)
 {
-  short x_pos;
-  byte red, green, blue, temp;
-  const T_Components * palette;
-
-  if (PCHG_palettes == NULL)
-    palette = context->Palette;
+  short x_pos, x_start;
+  int count;
+  dword color;
+  dword base[64];
+  int base_count = (bitplanes == 6) ? 16 : 64;
+  byte codes[IFF_CONVERSION_BLOCK];
+  dword rgb[IFF_CONVERSION_BLOCK];
+  const T_IFF_PCHG_Palette * line_palette;
+
+  line_palette = IFF_PCHG_line_palette(PCHG_cursor, y_pos);
+  if (line_palette == NULL)
+    HAM_Pack_palette(base, context->Palette, base_count);
   else
   {
-    // find the palette to use for the line
-    while (PCHG_palettes->Next != NULL && PCHG_palettes->Next->StartLine <= y_pos)
-      PCHG_palettes = PCHG_palettes->Next;
-    palette = PCHG_palettes->Palette;
-  }
-  red = palette[0].R;
-  green = palette[0].G;
-  blue = palette[0].B;
-  if (bitplanes == 6)
-  {
-    for (x_pos=0; x_pos<context->Width; x_pos++)         // HAM6
-    {
-      temp=Get_IFF_color(buffer, x_pos,real_line_size, bitplanes);
-      switch (temp & 0x30)
-      {
-        case 0x10: // blue
-          blue=(temp&0x0F)*0x11;
-          break;
-        case 0x20: // red
-          red=(temp&0x0F)*0x11;
-          break;
-        case 0x30: // green
-          green=(temp&0x0F)*0x11;
-          break;
-        default:   // Nouvelle couleur
-          red=palette[temp].R;
-          green =palette[temp].G;
-          blue =palette[temp].B;
-      }
-      Set_pixel_24b(context, x_pos,y_pos,red,green,blue);
-    }
+    // the PCHG palettes may have less entries than the HAM base colors
+    count = (line_palette->Nb_colors < base_count) ? line_palette->Nb_colors : base_count;
+    HAM_Pack_palette(base, line_palette->Palette, count);
+    memset(base + count, 0, (base_count - count) * sizeof(dword));
   }
-  else
+  color = base[0];
+
+  for (x_start = 0; x_start < context->Width; x_start += IFF_CONVERSION_BLOCK)
   {
-    for (x_pos=0; x_pos<context->Width; x_pos++)         // HAM8
-    {
-      temp=Get_IFF_color(buffer,x_pos,real_line_size, bitplanes);
-      switch (temp >> 6)
-      {
-        case 0x01: // blue
-          blue= (temp << 2) | ((temp & 0x30) >> 4);
-          break;
-        case 0x02: // red
-          red= (temp << 2) | ((temp & 0x30) >> 4);
-          break;
-        case 0x03: // green
-          green= (temp << 2) | ((temp & 0x30) >> 4);
-          break;
-        default:   // Nouvelle couleur
-          red=palette[temp].R;
-          green =palette[temp].G;
-          blue =palette[temp].B;
-      }
-      Set_pixel_24b(context, x_pos,y_pos,red,green,blue);
-    }
+    count = context->Width - x_start;
+    if (count > IFF_CONVERSION_BLOCK)
+      count = IFF_CONVERSION_BLOCK;
+    Planar_to_chunky(buffer + (x_start >> 3), codes, count, bitplanes, real_line_size >> 3);
+    color = HAM_Decode(codes, rgb, count, bitplanes, base, color);
+    for (x_pos = 0; x_pos < count; x_pos++)
+      Set_pixel_24b(context, x_start + x_pos, y_pos, HAM_R(rgb[x_pos]), HAM_G(rgb[x_pos]), HAM_B(rgb[x_pos]));
   }
 }
 
@@ -462,6 +454,7 @@ static void LBM_Decode(T_IO_Context * context, FILE * file, byte compression, by
   int real_line_size = (context->Width+15) & ~15; // size in bit for one bit plane
   int plane_line_size = real_line_size >> 3;      // size in byte for one bit plane
   int line_size = plane_line_size * stored_bit_planes; // size in byte for all bitplanes
+  const T_IFF_PCHG_Palette * line_palette = PCHG_palettes;
 
   switch(compression)
   {
@@ -477,9 +470,9 @@ static void LBM_Decode(T_IO_Context * context, FILE * file, byte compression, by
         if (Read_bytes(file,buffer,line_size))
         {
           if (Image_HAM > 1)
-            Draw_IFF_line_HAM(context, buffer, y_pos,real_line_size, real_bit_planes, PCHG_palettes);
+            Draw_IFF_line_HAM(context, buffer, y_pos,real_line_size, real_bit_planes, &line_palette);
           else if (PCHG_palettes)
-            Draw_IFF_line_PCHG(context, buffer, y_pos,real_line_size, real_bit_planes, PCHG_palettes);
+            Draw_IFF_line_PCHG(context, buffer, y_pos,real_line_size, real_bit_planes, &line_palette);
           else
             Draw_IFF_line(context, buffer, y_pos,real_line_size, real_bit_planes);
         }
@@ -545,9 +538,9 @@ static void LBM_Decode(T_IO_Context * context, FILE * file, byte compression, by
         if (!File_error)
         {
           if (Image_HAM > 1)
-            Draw_IFF_line_HAM(context, buffer, y_pos,real_line_size, real_bit_planes, PCHG_palettes);
+            Draw_IFF_line_HAM(context, buffer, y_pos,real_line_size, real_bit_planes, &line_palette);
           else if (PCHG_palettes)
-            Draw_IFF_line_PCHG(context, buffer, y_pos,real_line_size, real_bit_planes, PCHG_palettes);
+            Draw_IFF_line_PCHG(context, buffer, y_pos,real_line_size, real_bit_planes, &line_palette);
           else
             Draw_IFF_line(context, buffer, y_pos,real_line_size,real_bit_planes);
         }
@@ -690,6 +683,7 @@ static void RAST_chunk_decode(T_IO_Context * context, FILE * file, dword section
       }
       memcpy(new_pal->Palette, palette, sizeof(T_Components) * 16);
       new_pal->StartLine = line;
+      new_pal->Nb_colors = 16;
       new_pal->Next = NULL;
       if (prev_pal != NULL)
       {
@@ -712,6 +706,7 @@ static void RAST_chunk_decode(T_IO_Context * context, FILE * file, dword section
         }
         memcpy(prev_pal->Palette, context->Palette, sizeof(T_Components) * 16);
         prev_pal->StartLine = 0;
+        prev_pal->Nb_colors = 16;
         prev_pal->Next = new_pal;
         *PCHG_palettes = prev_pal;
         prev_pal = new_pal;
@@ -1574,7 +1569,7 @@ void Load_IFF(T_IO_Context * context)
           // SHAM_palette_count should be the image height, or height/2 for "interlaced" images
           for (y_pos = 0; y_pos < header.Height && section_size >= 32; y_pos += (SHAM_palette_count < header.Height ? 2 : 1))
           {
-            new_pal = GFX2_malloc(sizeof(T_IFF_PCHG_Palette) + nb_colors*sizeof(T_Components));
+            new_pal = GFX2_malloc(sizeof(T_IFF_PCHG_Palette) + 16*sizeof(T_Components));
             if (new_pal == NULL)
             {
               File_error = 1;
@@ -1582,6 +1577,7 @@ void Load_IFF(T_IO_Context * context)
             }
             new_pal->Next = NULL;
             new_pal->StartLine = y_pos;
+            new_pal->Nb_colors = 16;
             for (i = 0; i < 16; i++)
             {
               Read_byte(IFF_file, &temp_byte);  // 0R
@@ -1634,6 +1630,7 @@ void Load_IFF(T_IO_Context * context)
                 }
                 prev_pal->Next = NULL;
                 prev_pal->StartLine = 0;
+                prev_pal->Nb_colors = nb_colors;
                 memcpy(prev_pal->Palette, palette, nb_colors*sizeof(T_Components));
                 PCHG_palettes = prev_pal;
               }
@@ -1647,6 +1644,7 @@ void Load_IFF(T_IO_Context * context)
                 }
                 new_pal->Next = NULL;
                 new_pal->StartLine = y_pos;
+                new_pal->Nb_colors = nb_colors;
                 memcpy(new_pal->Palette, palette, nb_colors*sizeof(T_Components));
                 prev_pal->Next = new_pal;
                 prev_pal = new_pal;
@@ -1760,6 +1758,7 @@ void Load_IFF(T_IO_Context * context)
             prev_pal = malloc(sizeof(T_IFF_PCHG_Palette) + nb_colors*sizeof(T_Components));
             prev_pal->Next = NULL;
             prev_pal->StartLine = 0;
+            prev_pal->Nb_colors = nb_colors;
             memcpy(prev_pal->Palette, context->Palette, nb_colors*sizeof(T_Components));
             PCHG_palettes = prev_pal;
 
@@ -1790,6 +1789,7 @@ void Load_IFF(T_IO_Context * context)
                   curr_pal = malloc(sizeof(T_IFF_PCHG_Palette) + nb_colors*sizeof(T_Components));
                   curr_pal->Next = NULL;
                   curr_pal->StartLine = StartLine + y_pos;
+                  curr_pal->Nb_colors = nb_colors;
                   memcpy(curr_pal->Palette, prev_pal->Palette, nb_colors*sizeof(T_Components));
                   prev_pal->Next = curr_pal;
                 }
@@ -1910,12 +1910,14 @@ void Load_IFF(T_IO_Context * context)
           }
           if (File_error == 0)
           {
+            const T_IFF_PCHG_Palette * line_palette = PCHG_palettes;
+
             for (y_pos = 0; y_pos < context->Height; y_pos++)
             {
               if (Image_HAM <= 1)
                 Draw_IFF_line(context, buffer+y_pos*line_size, y_pos,real_line_size, real_bit_planes);
               else
-                Draw_IFF_line_HAM(context, buffer+y_pos*line_size, y_pos,real_line_size, real_bit_planes, PCHG_palettes);
+                Draw_IFF_line_HAM(context, buffer+y_pos*line_size, y_pos,real_line_size, real_bit_planes, &line_palette);
             }
           }
           free(buffer);
@@ -2009,6 +2011,9 @@ void Load_IFF(T_IO_Context * context)
 // -- Sauver un fichier au format IFF ---------------------------------------
 
 /// Save IFF file (LBM or PBM)
+///
+/// LBM files named *.ham, *.ham6 or *.ham8 are saved in Hold And Modify
+/// mode : the first 16 or 64 colors of the palette are the base colors.
 void Save_IFF(T_IO_Context * context)
 {
   FILE * IFF_file;
@@ -2021,8 +2026,26 @@ void Save_IFF(T_IO_Context * context)
   byte bit_depth;
   long body_offset = -1;
   int is_ehb = 0; // Extra half-bright
+  byte ham = 0;   // 6 or 8 for HAM6 / HAM8
 
   if (context->Format == FORMAT_LBM)
+  {
+    const char * ext = strrchr(context->File_name, '.');
+    if (ext != NULL)
+    {
+      if (strcasecmp(ext, ".ham") == 0 || strcasecmp(ext, ".ham6") == 0)
+        ham = 6;
+      else if (strcasecmp(ext, ".ham8") == 0)
+        ham = 8;
+    }
+  }
+  if (ham)
+  {
+    bit_depth = ham;
+    palette_entries = 1 << (ham - 2);
+    GFX2_Log(GFX2_DEBUG, "Saving ILBM HAM%d\n", ham);
+  }
+  else if (context->Format == FORMAT_LBM)
   {
     // Check how many bits are used by pixel colors
     temp_byte = 0;
@@ -2079,10 +2102,10 @@ void Save_IFF(T_IO_Context * context)
     header.X_org=0;
     header.Y_org=0;
     header.BitPlanes=bit_depth;
-    header.Mask=context->Background_transparent ? 2 : 0;
+    header.Mask=(context->Background_transparent && !ham) ? 2 : 0;
     header.Compression=1;
     header.Pad1=0;
-    header.Transp_col=context->Background_transparent ? context->Transparent_color : 0;
+    header.Transp_col=(context->Background_transparent && !ham) ? context->Transparent_color : 0;
     header.X_aspect=10; // Amiga files are usually 10:11
     header.Y_aspect=10;
     switch (context->Ratio)
@@ -2128,6 +2151,7 @@ void Save_IFF(T_IO_Context * context)
     {
       dword ViewMode = 0; // HIRES=0x8000 LACE=0x4  HAM=0x800  HALFBRITE=0x80
       if (is_ehb) ViewMode |= 0x80;
+      if (ham) ViewMode |= 0x800;
       if (context->Width > 400)
       {
         ViewMode |= 0x8000;
@@ -2180,16 +2204,29 @@ void Save_IFF(T_IO_Context * context)
     if (context->Format == FORMAT_LBM)
     {
       byte * buffer;
+      byte * pixels;  // one line of chunky pixels
       short line_size; // Size of line in bytes
       short plane_line_size;  // Size of line in bytes for 1 plane
       short real_line_size; // Size of line in pixels
       T_PackBits_data pb_data;
+      T_HAM_encoder * encoder = NULL;
+      dword * rgb = NULL;   // one line of 24 bits pixels, for HAM
       
       // Calcul de la taille d'une ligne ILBM (pour les images ayant des dimensions exotiques)
       real_line_size = (context->Width+15) & ~15;
       plane_line_size = real_line_size >> 3;  // 8bits per byte
       line_size = plane_line_size * header.BitPlanes;
-      buffer=(byte *)malloc(line_size);
+      buffer=(byte *)malloc(line_size + context->Width);
+      pixels = buffer + line_size;
+      if (ham)
+      {
+        encoder = (T_HAM_encoder *)GFX2_malloc(sizeof(T_HAM_encoder));
+        rgb = (dword *)GFX2_malloc(context->Width * sizeof(dword));
+        if (encoder == NULL || rgb == NULL)
+          File_error = 1;
+        else
+          HAM_Encoder_init(encoder, context->Palette, ham);
+      }
       
       // Start encoding
       PackBits_pack_init(&pb_data, IFF_file);
@@ -2198,10 +2235,17 @@ void Save_IFF(T_IO_Context * context)
         // Dispatch the pixel into planes
         memset(buffer,0,line_size);
         for (x_pos=0; x_pos<context->Width; x_pos++)
-          Set_IFF_color(buffer, x_pos, Get_pixel(context, x_pos,y_pos), real_line_size, header.BitPlanes);
-          
-        if (context->Width&1) // odd width fix
-          Set_IFF_color(buffer, x_pos, 0, real_line_size, header.BitPlanes);
+          pixels[x_pos] = Get_pixel(context, x_pos,y_pos);
+        if (ham)
+        {
+          for (x_pos=0; x_pos<context->Width; x_pos++)
+          {
+            const T_Components * c = context->Palette + pixels[x_pos];
+            rgb[x_pos] = HAM_RGB(c->R, c->G, c->B);
+          }
+          HAM_Encode_line(encoder, rgb, pixels, context->Width);
+        }
+        Chunky_to_planar(pixels, buffer, context->Width, header.BitPlanes, plane_line_size);
         
         // encode the resulting sequence of bytes
         if (header.Compression)
@@ -2231,6 +2275,8 @@ void Save_IFF(T_IO_Context * context)
             File_error = 1;
         }
       }
+      free(rgb);
+      free(encoder);
       free(buffer);
     }
     else // PBM = chunky 8bpp
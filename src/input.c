@@ -41,6 +41,7 @@
 #ifdef USE_X11
 #include <unistd.h>
 #include <stdlib.h>
+#include <sys/select.h>
 #include <X11/Xlib.h>
 #include <X11/XKBlib.h>
 #include <X11/Xutil.h>
@@ -134,6 +135,9 @@ long Directional_first_move;
 long Directional_last_move;
 int  Mouse_moved; ///< Boolean, Set to true if any cursor movement occurs.
 
+T_Input_sample Input_samples[INPUT_SAMPLES_MAX];
+int Input_samples_count = 0;
+
 byte Pan_shortcut_pressed;
 
 // Joystick/pad configurations for the various console ports.
@@ -335,6 +339,12 @@ int Move_cursor_with_constraints(int x, int y)
     Mouse_moved++;
     Mouse_X = Input_new_mouse_X;
     Mouse_Y = Input_new_mouse_Y;
+    // Record the position. When the queue is full, the last one is replaced.
+    if (Input_samples_count < INPUT_SAMPLES_MAX)
+      Input_samples_count++;
+    Input_samples[Input_samples_count - 1].X = Mouse_X;
+    Input_samples[Input_samples_count - 1].Y = Mouse_Y;
+    Input_samples[Input_samples_count - 1].Time = GFX2_GetTicks();
 
     if (Mouse_moved > Config.Mouse_merge_movement
       && !Operation[Current_operation][Mouse_K_unique]
@@ -614,6 +624,8 @@ static int Handle_SelectionNotify(const XSelectionEvent* xselection)
 #ifndef __no_tifflib__
         Atom tiff = XInternAtom(X11_display, "image/tiff", False);
 #endif
+        Atom gif = XInternAtom(X11_display, "image/gif", False);
+        Atom bmp = XInternAtom(X11_display, "image/bmp", False);
         Atom urilist = XInternAtom(X11_display, "text/uri-list", False);
         Atom utf8string = XInternAtom(X11_display, "UTF8_STRING", False);
         // by order of preference
@@ -624,6 +636,8 @@ static int Handle_SelectionNotify(const XSelectionEvent* xselection)
 #ifndef __no_tifflib__
           { tiff, X11_CLIPBOARD_TIFF },
 #endif
+          { gif, X11_CLIPBOARD_GIF },
+          { bmp, X11_CLIPBOARD_BMP },
           { urilist, X11_CLIPBOARD_URILIST },
           { utf8string, X11_CLIPBOARD_UTF8STRING },
           { None, X11_CLIPBOARD_NONE }
@@ -719,7 +733,7 @@ static void Handle_SelectionRequest(const XSelectionRequestEvent* xselectionrequ
   XSelectionEvent xselection; 
   char * target_name;
   char * property_name;
-  Atom png;
+  Atom image;
 #if defined(SDL_VIDEO_DRIVER_X11)
   Display * X11_display;
   Window X11_window;
@@ -731,7 +745,8 @@ static void Handle_SelectionRequest(const XSelectionRequestEvent* xselectionrequ
   }
 #endif
 
-  png = XInternAtom(X11_display, "image/png", False);
+  // see Save_ClipBoard_Image()
+  image = XInternAtom(X11_display, (X11_clipboard_type == X11_CLIPBOARD_GIF) ? "image/gif" : "image/png", False);
 
   target_name = XGetAtomName(X11_display, xselectionrequest->target);
   property_name = XGetAtomName(X11_display, xselectionrequest->property);
@@ -749,15 +764,15 @@ static void Handle_SelectionRequest(const XSelectionRequestEvent* xselectionrequ
   if (xselectionrequest->target == XInternAtom(X11_display, "TARGETS", False))
   {
     Atom targets[1];
-    targets[0] = png;   // Advertise image/png as the only supported format
+    targets[0] = image;   // Advertise image/png (or image/gif) as the only supported format
     XChangeProperty(X11_display, xselectionrequest->requestor, xselectionrequest->property,
                     XA_ATOM, 32, PropModeReplace,
                     (unsigned char *)targets, 1);
   }
-  else if (xselectionrequest->target == png)
+  else if (xselectionrequest->target == image)
   {
     XChangeProperty(X11_display, xselectionrequest->requestor, xselectionrequest->property,
-                    png, 8, PropModeReplace,
+                    image, 8, PropModeReplace,
                     (unsigned char *)X11_clipboard, X11_clipboard_size);
   }
   else
@@ -1500,7 +1515,117 @@ static void Mouse_Emulation()
 
 // Main input handling function
 
+/// Input latency statistics, logged every INPUT_STATS_PERIOD milliseconds
+#define INPUT_STATS_PERIOD 10000
+
+static struct
+{
+  dword Period_start;  ///< start of the current period
+  dword Last_input;    ///< when Get_input() last reported an event. 0 once it was measured
+  long Calls;          ///< number of Get_input() calls
+  long Inputs;         ///< number of events reported
+  dword Total_latency; ///< time spent between reporting an event and the next call (which displays the result)
+  dword Max_latency;
+} Input_stats;
+
+static void Update_input_stats(void)
+{
+  dword now = GFX2_GetTicks();
+
+  Input_stats.Calls++;
+  if (Input_stats.Last_input != 0)
+  {
+    dword latency = now - Input_stats.Last_input;
+    Input_stats.Total_latency += latency;
+    if (latency > Input_stats.Max_latency)
+      Input_stats.Max_latency = latency;
+    Input_stats.Last_input = 0;
+  }
+  if (now - Input_stats.Period_start >= INPUT_STATS_PERIOD)
+  {
+    if (Input_stats.Period_start != 0 && Input_stats.Inputs > 0)
+      GFX2_Log(GFX2_DEBUG, "Input: %ld calls, %ld events, latency avg %lums max %lums\n",
+               Input_stats.Calls, Input_stats.Inputs,
+               (unsigned long)(Input_stats.Total_latency / Input_stats.Inputs),
+               (unsigned long)Input_stats.Max_latency);
+    memset(&Input_stats, 0, sizeof(Input_stats));
+    Input_stats.Period_start = now;
+  }
+}
+
+/// Returns how long Get_input() may block when there are no events,
+/// so that time-driven things (color cycling, cursor emulation...) keep going.
+static int Input_wait_time(int sleep_time)
+{
+  // Pending requests, to be handled by the main loop right away
+  if (Quit_is_required || Resize_width || Resize_height || Drop_file_name != NULL)
+    return 0;
+  // Cursor moved by keys or joystick
+  if (Digital_joystick_state || Directional_emulated)
+    return Min(sleep_time, 10);
+#if defined(USE_JOYSTICK)
+  if (Joystick_vertical != 0 || Joystick_horizontal != 0)
+    return Min(sleep_time, 10);
+#endif
+  // Color cycling: the palette changes at most 50 times per second
+  if (Allow_colorcycling && Cycling_mode)
+    return Min(sleep_time, 20);
+  return sleep_time;
+}
+
+#if defined(USE_SDL) || defined(USE_SDL2) || defined(USE_X11)
+/// Blocks until an event arrives, or timeout milliseconds have elapsed.
+static void Wait_for_events(int timeout)
+{
+  if (timeout <= 0)
+    return;
+#if defined(USE_SDL2)
+  SDL_WaitEventTimeout(NULL, timeout);
+#elif defined(USE_SDL)
+  // SDL 1.2 cannot wait for events with a timeout: keep polling
+  SDL_Delay(Min(timeout, 10));
+#else
+  {
+    fd_set fds;
+    struct timeval tv;
+    int fd;
+
+    if (X11_display == NULL)
+    {
+      usleep(1000 * timeout);
+      return;
+    }
+    XFlush(X11_display);
+    if (XPending(X11_display) > 0)
+      return;
+    fd = ConnectionNumber(X11_display);
+    FD_ZERO(&fds);
+    FD_SET(fd, &fds);
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    select(fd + 1, &fds, NULL, NULL, &tv);
+  }
+#endif
+}
+#endif
+
+static int Get_input_events(int sleep_time);
+
 int Get_input(int sleep_time)
+{
+  int feedback;
+
+  Update_input_stats();
+  feedback = Get_input_events(sleep_time);
+  if (feedback)
+  {
+    Input_stats.Inputs++;
+    Input_stats.Last_input = GFX2_GetTicks();
+  }
+  return feedback;
+}
+
+static int Get_input_events(int sleep_time)
 {
 #if defined(USE_SDL) || defined(USE_SDL2)
     SDL_Event event;
@@ -1522,6 +1647,7 @@ int Get_input(int sleep_time)
     memset(Key_Text, 0, sizeof(Key_Text));
 #endif
     Mouse_moved = 0;
+    Input_samples_count = 0;
     Input_new_mouse_X = Mouse_X;
     Input_new_mouse_Y = Mouse_Y;
     Input_new_mouse_K = Mouse_K;
@@ -1589,6 +1715,10 @@ int Get_input(int sleep_time)
                   if (Resize_width != event.window.data1 || Resize_height != event.window.data2)
                     SDL_SetWindowSize(SDL_GetWindowFromID(event.window.windowID), Resize_width, Resize_height);
                   break;
+                case SDL_WINDOWEVENT_EXPOSED:
+                  // the texture is only presented when it changed : force it
+                  Update_rect(0, 0, 0, 0);
+                  break;
                 case SDL_WINDOWEVENT_CLOSE:
                   GFX2_Log(GFX2_DEBUG, "SDL_WINDOWEVENT_CLOSE %d\n", event.window.windowID);
                   Quit_is_required = 1;
@@ -1899,9 +2029,8 @@ int Get_input(int sleep_time)
 #if defined(USE_SDL2)
     GFX2_UpdateScreen();
 #endif
-    // Nothing significant happened
-    if (sleep_time)
-      SDL_Delay(sleep_time);
+    // Nothing significant happened: wait for the next event
+    Wait_for_events(Input_wait_time(sleep_time));
 #elif defined(WIN32)
     MSG msg;
 
@@ -1910,6 +2039,7 @@ int Get_input(int sleep_time)
     Key_UNICODE = 0;
     Key = 0;
     Mouse_moved=0;
+    Input_samples_count = 0;
     Input_new_mouse_X = Mouse_X;
     Input_new_mouse_Y = Mouse_Y;
     Input_new_mouse_K = Mouse_K;
@@ -1952,6 +2082,8 @@ int Get_input(int sleep_time)
     if (sleep_time == 0)
       sleep_time = 20;  // default of 20 ms
     // TODO : we should check where Get_input(0) is called
+    sleep_time = Input_wait_time(sleep_time);
+    if (sleep_time > 0)
     {
       UINT_PTR timerId = SetTimer(NULL, 0, sleep_time, NULL);
       WaitMessage();
@@ -1970,6 +2102,7 @@ int Get_input(int sleep_time)
     Key_UNICODE = 0;
     Key = 0;
     Mouse_moved=0;
+    Input_samples_count = 0;
     Input_new_mouse_X = Mouse_X;
     Input_new_mouse_Y = Mouse_Y;
     Input_new_mouse_K = Mouse_K;
@@ -2154,7 +2287,8 @@ int Get_input(int sleep_time)
           GFX2_Log(GFX2_DEBUG, "X11 MapNotify\n");
           break;
         default:
-          GFX2_Log(GFX2_INFO, "X11 event.type = %d not handled\n", event.type);
+          if (!X11_Shm_completion(&event))
+            GFX2_Log(GFX2_INFO, "X11 event.type = %d not handled\n", event.type);
       }
     }
 
@@ -2170,9 +2304,8 @@ int Get_input(int sleep_time)
     }
     if (user_feedback_required)
       return 1;
-    // Nothing significant happened
-    if (sleep_time)
-      usleep(1000 * sleep_time);
+    // Nothing significant happened: wait for the next event
+    Wait_for_events(Input_wait_time(sleep_time));
 #endif
     return 0;
 }
@@ -52,6 +52,26 @@ void Adjust_mouse_sensitivity(word fullscreen);
 int Move_cursor_with_constraints(int x, int y);
 int Handle_mouse_btn_change(void);
 
+/// A cursor position read from the input devices
+typedef struct
+{
+  word X;     ///< Screen coordinates, like ::Mouse_X
+  word Y;     ///< Screen coordinates, like ::Mouse_Y
+  dword Time; ///< GFX2_GetTicks() when the position was read
+} T_Input_sample;
+
+/// Maximum number of cursor positions kept by one call of ::Get_input()
+#define INPUT_SAMPLES_MAX 256
+
+///
+/// All the cursor positions read during the last call of ::Get_input(),
+/// oldest first. The last one is the current ::Mouse_X, ::Mouse_Y.
+/// Operations which merge mouse movements (Fast_mouse) can use them to
+/// follow a fast stroke exactly, in a single pass.
+extern T_Input_sample Input_samples[INPUT_SAMPLES_MAX];
+/// Number of positions in ::Input_samples
+extern int Input_samples_count;
+
 ///
 /// This holds the ID of the GUI control that the mouse
 /// is manipulating. The input system will reset it to zero 
@@ -82,6 +102,8 @@ enum X11_CLIPBOARD_TYPES {
   X11_CLIPBOARD_UNKNOWN,
   X11_CLIPBOARD_PNG,
   X11_CLIPBOARD_TIFF,
+  X11_CLIPBOARD_GIF,
+  X11_CLIPBOARD_BMP,
   X11_CLIPBOARD_URILIST,
   X11_CLIPBOARD_UTF8STRING
 };
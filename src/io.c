@@ -609,9 +609,130 @@ unsigned long File_length_file(FILE * file)
   return (unsigned long)file_length;
 #else
   struct stat infos_fichier;
-  if (fstat(fileno(file),&infos_fichier))
+  long offset_backup;
+  long file_length;
+  if (fileno(file) >= 0 && fstat(fileno(file),&infos_fichier) == 0)
+    return infos_fichier.st_size;
+  // no file descriptor (memory stream) : seek to the end
+  offset_backup = ftell(file);
+  if (offset_backup < 0)
+    return 0;
+  if (fseek(file, 0, SEEK_END) < 0)
+    return 0;
+  file_length = ftell(file);
+  if (file_length < 0)
+    file_length = 0;
+  fseek(file, offset_backup, SEEK_SET);
+  return (unsigned long)file_length;
+#endif
+}
+
+void Memory_buffer_init_read(T_Memory_buffer * buffer, const void * data, unsigned long size)
+{
+  buffer->Data = (byte *)data;
+  buffer->Size = size;
+  buffer->Offset = 0;
+  buffer->Alloc_size = 0;
+}
+
+unsigned long Memory_read(T_Memory_buffer * buffer, void * dest, unsigned long count)
+{
+  if (buffer->Offset >= buffer->Size)
+    return 0;
+  if (count > buffer->Size - buffer->Offset)
+    count = buffer->Size - buffer->Offset;
+  memcpy(dest, buffer->Data + buffer->Offset, count);
+  buffer->Offset += count;
+  return count;
+}
+
+/// Make sure at least size bytes are allocated, doubling the allocation.
+static int Memory_reserve(T_Memory_buffer * buffer, unsigned long size)
+{
+  unsigned long new_size;
+  byte * tmp;
+
+  if (size <= buffer->Alloc_size)
+    return 1;
+  if (buffer->Alloc_size == 0 && buffer->Data != NULL)
+  {
+    GFX2_Log(GFX2_ERROR, "Memory_reserve() buffer is read only\n");
+    return 0;
+  }
+  new_size = buffer->Alloc_size < 4096 ? 4096 : buffer->Alloc_size;
+  while (new_size < size)
+  {
+    if (new_size * 2 < new_size)  // overflow
       return 0;
-  return infos_fichier.st_size;
+    new_size *= 2;
+  }
+  tmp = realloc(buffer->Data, new_size);
+  if (tmp == NULL)
+  {
+    GFX2_Log(GFX2_ERROR, "Memory_reserve() failed to allocate %lu bytes\n", new_size);
+    return 0;
+  }
+  buffer->Data = tmp;
+  buffer->Alloc_size = new_size;
+  return 1;
+}
+
+int Memory_write(T_Memory_buffer * buffer, const void * src, unsigned long count)
+{
+  if (buffer->Offset + count < buffer->Offset)
+    return 0;
+  if (!Memory_reserve(buffer, buffer->Offset + count))
+    return 0;
+  memcpy(buffer->Data + buffer->Offset, src, count);
+  buffer->Offset += count;
+  if (buffer->Offset > buffer->Size)
+    buffer->Size = buffer->Offset;
+  return 1;
+}
+
+int Memory_seek(T_Memory_buffer * buffer, unsigned long offset)
+{
+  if (offset > buffer->Size)
+  {
+    if (!Memory_reserve(buffer, offset))
+      return 0;
+    memset(buffer->Data + buffer->Size, 0, offset - buffer->Size);
+    buffer->Size = offset;
+  }
+  buffer->Offset = offset;
+  return 1;
+}
+
+FILE * Open_memory_read(const void * data, unsigned long size)
+{
+#if defined(_POSIX_C_SOURCE) && (_POSIX_C_SOURCE >= 200809L)
+  if (size == 0)
+    return NULL;
+  return fmemopen((void *)data, size, "rb");
+#else
+  // no fmemopen() : go through a temporary file
+  FILE * f = tmpfile();
+  if (f == NULL)
+    return NULL;
+  if (size > 0 && fwrite(data, 1, size, f) != size)
+  {
+    fclose(f);
+    return NULL;
+  }
+  rewind(f);
+  return f;
+#endif
+}
+
+FILE * Open_memory_write(char * * data, size_t * size)
+{
+  *data = NULL;
+  *size = 0;
+#if defined(_POSIX_C_SOURCE) && (_POSIX_C_SOURCE >= 200809L)
+  return open_memstream(data, size);
+#else
+  GFX2_Log(GFX2_ERROR, "Open_memory_write() not implemented on this platform\n");
+  return NULL;
 #endif
 }
 
@@ -86,6 +86,44 @@ unsigned long File_length_file(FILE * file);
 /** @}*/
 
 
+/** @defgroup memio Memory input/output
+ * Files held in memory, for clipboard and the formats libraries that
+ * read or write through callbacks.
+ * @{ */
+
+/// A file in memory.
+///
+/// When writing, the buffer grows geometrically so that a long sequence of
+/// small writes is amortized O(1) per byte. The data stays contiguous so it
+/// can be handed as-is to the clipboard APIs.
+typedef struct
+{
+  byte * Data;              ///< the bytes of the file
+  unsigned long Size;       ///< size of the file
+  unsigned long Offset;     ///< current read/write position
+  unsigned long Alloc_size; ///< allocated size of Data. 0 when Data belongs to the caller (read only)
+} T_Memory_buffer;
+
+/// Setup a read only memory buffer on existing data. The data is not copied.
+void Memory_buffer_init_read(T_Memory_buffer * buffer, const void * data, unsigned long size);
+/// Reads up to count bytes. Returns the number of bytes actually read.
+unsigned long Memory_read(T_Memory_buffer * buffer, void * dest, unsigned long count);
+/// Writes count bytes at the current position. Returns true if OK, false if out of memory.
+int Memory_write(T_Memory_buffer * buffer, const void * src, unsigned long count);
+/// Moves the current position. Seeking past the end of a writable buffer fills with zeros.
+/// Returns true if OK, false if the position is not reachable.
+int Memory_seek(T_Memory_buffer * buffer, unsigned long offset);
+/// Opens a memory block as a read only FILE, so any Test_XXX() / Load_XXX()
+/// function can read it. The data must stay valid until the file is closed.
+FILE * Open_memory_read(const void * data, unsigned long size);
+/// Opens a FILE which writes to memory, so any Save_XXX() function can
+/// write to it. Once the file is closed, *data points to the bytes written,
+/// allocated with malloc(), and *size is their count.
+/// Returns NULL if the platform can't write to memory (no open_memstream()).
+FILE * Open_memory_write(char * * data, size_t * size);
+/** @}*/
+
+
 /** @defgroup filename File path and name
  * Functions used to manipulate files path and names
  * @{ */
@@ -642,72 +642,191 @@ void Button_Anim_last_frame(int btn)
   Display_cursor();
 }
 
-void Button_Anim_continuous_next(int btn)
+/// Screen images of the animation frames, kept during the playback.
+///
+/// Each one is a copy of the drawing area of the screen, so it depends on
+/// the zoom, scrolling and pixel ratio : the cache only lives while
+/// a playback button is held.
+static struct
 {
-  dword time_start;
-  int time_in_current_frame=0;
+  byte * Frame[MAX_NB_FRAMES];
+  dword Last_use[MAX_NB_FRAMES]; ///< for the Least Recently Used eviction
+  dword Use_count;
+  size_t Frame_size;             ///< bytes per cached frame
+  qword Size;                    ///< bytes used by all cached frames
+} Anim_cache;
+
+/// Maximum size of the cache, in bytes. Up to 9999 MB : more than a long
+/// holds on the platforms where it is 32 bits.
+static qword Anim_cache_limit(void)
+{
+  return (qword)Config.Animation_cache_size << 20;
+}
 
-  time_start = GFX2_GetTicks();
-  
-  do
+static void Anim_cache_free(void)
+{
+  int i;
+
+  for (i = 0; i < MAX_NB_FRAMES; i++)
   {
-    int target_frame;
-    dword time_now;
-  
-    Get_input(20);
-    
-    time_now=GFX2_GetTicks();
-    time_in_current_frame += time_now-time_start;
-    time_start=time_now;
-    target_frame = Main.current_layer;
-    while (time_in_current_frame > Main.backups->Pages->Image[target_frame].Duration)
-    {
-      time_in_current_frame -= Interpret_delay(Main.backups->Pages->Image[target_frame].Duration);
-      target_frame = (target_frame+1) % Main.backups->Pages->Nb_layers;
-    }
-    if (target_frame != Main.current_layer)
-    {
-      Layer_activate(target_frame,LEFT_SIDE);
-    }
-    
-  } while (Mouse_K);
+    free(Anim_cache.Frame[i]);
+    Anim_cache.Frame[i] = NULL;
+  }
+  Anim_cache.Size = 0;
+}
+
+/// Copy the drawing area of the screen to or from a cached frame
+static void Anim_cache_copy(byte * buffer, int to_screen)
+{
+  int y;
+  int width = Screen_width * Pixel_width;
+
+  for (y = 0; y < Menu_Y * Pixel_height; y++)
+  {
+    if (to_screen)
+      memcpy(Get_Screen_pixel_ptr(0, y), buffer + (long)y * width, width);
+    else
+      memcpy(buffer + (long)y * width, Get_Screen_pixel_ptr(0, y), width);
+  }
+}
+
+/// Keep a copy of the screen, which displays a frame
+/// @param evict 1 to evict the least recently used frames if the cache is
+///              full, 0 to only use free space.
+static void Anim_cache_store(int frame, int evict)
+{
+  qword limit = Anim_cache_limit();
+
+  if (Anim_cache.Frame[frame] != NULL)
+    return;
+  while (Anim_cache.Size + Anim_cache.Frame_size > limit)
+  {
+    int i, oldest = -1;
+
+    if (!evict)
+      return;
+    for (i = 0; i < MAX_NB_FRAMES; i++)
+      if (Anim_cache.Frame[i] != NULL && (oldest < 0 || Anim_cache.Last_use[i] < Anim_cache.Last_use[oldest]))
+        oldest = i;
+    if (oldest < 0)
+      return; // not even room for one frame
+    free(Anim_cache.Frame[oldest]);
+    Anim_cache.Frame[oldest] = NULL;
+    Anim_cache.Size -= Anim_cache.Frame_size;
+  }
+  Anim_cache.Frame[frame] = malloc(Anim_cache.Frame_size);
+  if (Anim_cache.Frame[frame] == NULL)
+    return;
+  Anim_cache.Size += Anim_cache.Frame_size;
+  Anim_cache_copy(Anim_cache.Frame[frame], 0);
+  Anim_cache.Last_use[frame] = ++Anim_cache.Use_count;
+}
+
+/// Make a frame the current one, without refreshing the screen
+static void Anim_select_frame(int frame)
+{
+  Main.current_layer = frame;
+  Main.layers_visible = 1<<frame;
+  Redraw_layered_image();
+}
 
+/// Display a frame during the playback, from the cache when possible.
+///
+/// Same as Layer_activate(), for the animation mode.
+static void Anim_show_frame(int frame)
+{
+  Anim_select_frame(frame);
   Hide_cursor();
-  Unselect_button(btn);
+  if (Anim_cache.Frame[frame] != NULL)
+  {
+    Anim_cache_copy(Anim_cache.Frame[frame], 1);
+    Update_rect(0, 0, Screen_width, Menu_Y);
+    Anim_cache.Last_use[frame] = ++Anim_cache.Use_count;
+  }
+  else
+  {
+    Display_all_screen();
+    Anim_cache_store(frame, 1);
+  }
+  Display_layerbar();
   Display_cursor();
 }
 
-void Button_Anim_continuous_prev(int btn)
+/// Render a frame in the cache before it has to be displayed.
+///
+/// Only free space in the cache is used. The screen still displays the
+/// current frame when returning.
+static void Anim_prerender_frame(int frame)
+{
+  int current = Main.current_layer;
+
+  if (frame == current || Anim_cache.Frame[frame] != NULL || Anim_cache.Frame[current] == NULL)
+    return;
+  if (Anim_cache.Size + Anim_cache.Frame_size > Anim_cache_limit())
+    return;
+  Hide_cursor();
+  Anim_select_frame(frame);
+  // Only draw it: Display_all_screen() would show it right away on the
+  // displays which present each Update_rect() immediately
+  Render_all_screen();
+  Anim_cache_store(frame, 0);
+  Anim_select_frame(current);
+  Anim_cache_copy(Anim_cache.Frame[current], 1);
+  Display_cursor();
+}
+
+/// Play the animation while the mouse button is held
+/// @param step 1 to play forward, -1 to play backward
+static void Anim_play(int btn, int step)
 {
   dword time_start;
   int time_in_current_frame=0;
+  int nb_frames = Main.backups->Pages->Nb_layers;
 
+  Anim_cache.Frame_size = (size_t)Screen_width * Pixel_width * Menu_Y * Pixel_height;
+  Anim_cache.Use_count = 0;
   time_start = GFX2_GetTicks();
-  
+
   do
   {
     int target_frame;
+    int delay;
     dword time_now;
-  
-    Get_input(20);
-    
+
+    // wait until the next frame is due
+    delay = Interpret_delay(Main.backups->Pages->Image[Main.current_layer].Duration) - time_in_current_frame;
+    Get_input(delay < 1 ? 1 : (delay > 20 ? 20 : delay));
+
     time_now=GFX2_GetTicks();
     time_in_current_frame += time_now-time_start;
     time_start=time_now;
     target_frame = Main.current_layer;
-    while (time_in_current_frame > Main.backups->Pages->Image[target_frame].Duration)
+    // skip the frames whose time has already passed
+    while (time_in_current_frame >= Interpret_delay(Main.backups->Pages->Image[target_frame].Duration))
     {
       time_in_current_frame -= Interpret_delay(Main.backups->Pages->Image[target_frame].Duration);
-      target_frame = (target_frame+Main.backups->Pages->Nb_layers-1) % Main.backups->Pages->Nb_layers;
+      target_frame = (target_frame+nb_frames+step) % nb_frames;
     }
     if (target_frame != Main.current_layer)
     {
-      Layer_activate(target_frame,LEFT_SIDE);
+      Anim_show_frame(target_frame);
+      Anim_prerender_frame((target_frame+nb_frames+step) % nb_frames);
     }
-    
+
   } while (Mouse_K);
 
+  Anim_cache_free();
   Hide_cursor();
   Unselect_button(btn);
   Display_cursor();
 }
+
+void Button_Anim_continuous_next(int btn)
+{
+  Anim_play(btn, 1);
+}
+
+void Button_Anim_continuous_prev(int btn)
+{
+  Anim_play(btn, -1);
+}
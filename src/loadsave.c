@@ -340,12 +340,18 @@ void Set_frame_duration(T_IO_Context *context, int duration)
   }
 }
 
+/// The page of the main image which a CONTEXT_MAIN_IMAGE saves
+static T_Page * Context_page(T_IO_Context *context)
+{
+  return (context->Page != NULL) ? context->Page : Main.backups->Pages;
+}
+
 int Get_frame_duration(T_IO_Context *context)
 {
   switch(context->Type)
   {
     case CONTEXT_MAIN_IMAGE:
-      return Main.backups->Pages->Image[context->Current_layer].Duration;
+      return Context_page(context)->Image[context->Current_layer].Duration;
     default:
       return 0;
   }
@@ -368,7 +374,7 @@ void Set_image_mode(T_IO_Context *context, enum IMAGE_MODES mode)
 enum IMAGE_MODES Get_image_mode(T_IO_Context *context)
 {
   if (context->Type == CONTEXT_MAIN_IMAGE)
-    return Main.backups->Pages->Image_mode;
+    return Context_page(context)->Image_mode;
   return IMAGE_MODE_LAYERED;
 }
 
@@ -1565,6 +1571,22 @@ static void Load_ClipBoard_Image(T_IO_Context * context)
         GFX2_Log(GFX2_WARNING, "Failed to load TIFF Clipboard\n");
       break;
 #endif
+    case X11_CLIPBOARD_GIF:
+    case X11_CLIPBOARD_BMP:
+      // the loaders read the clipboard through Open_file_read()
+      context->Memory_data = X11_clipboard;
+      context->Memory_size = X11_clipboard_size;
+      File_error = 0;
+      if (X11_clipboard_type == X11_CLIPBOARD_GIF)
+        Load_GIF(context);
+      else
+        Load_BMP(context);
+      context->Memory_data = NULL;
+      context->Memory_size = 0;
+      if (File_error != 0)
+        GFX2_Log(GFX2_WARNING, "Failed to load %s Clipboard\n",
+                 (X11_clipboard_type == X11_CLIPBOARD_GIF) ? "GIF" : "BMP");
+      break;
     case X11_CLIPBOARD_UTF8STRING:
     case X11_CLIPBOARD_URILIST:
       {
@@ -1732,7 +1754,23 @@ static void Save_ClipBoard_Image(T_IO_Context * context)
     X11_clipboard = NULL;
     X11_clipboard_size = 0;
   }
+#ifndef __no_pnglib__
   Save_PNG_Sub(context, NULL, &X11_clipboard, &X11_clipboard_size);
+  X11_clipboard_type = X11_CLIPBOARD_PNG;
+#else
+  {
+    // without libpng, Save_GIF() writes a GIF to memory through Open_file_write()
+    size_t size = 0;
+
+    context->Memory_output = &X11_clipboard;
+    context->Memory_output_size = &size;
+    Save_GIF(context);
+    context->Memory_output = NULL;
+    context->Memory_output_size = NULL;
+    X11_clipboard_size = size;
+    X11_clipboard_type = X11_CLIPBOARD_GIF;
+  }
+#endif
   if (!File_error)
   {
 #if defined(USE_SDL) || defined(USE_SDL2)
@@ -1954,13 +1992,13 @@ void Set_saving_layer(T_IO_Context *context, int layer)
 
   if (context->Type == CONTEXT_MAIN_IMAGE)
   {
-    if (context->Nb_layers==1 && Main.backups->Pages->Nb_layers!=1)
+    if (context->Nb_layers==1 && Context_page(context)->Nb_layers!=1)
     {
       // Context is set to saving a single layer: do nothing
     }
     else
     {
-      context->Target_address=Main.backups->Pages->Image[layer].Pixels;
+      context->Target_address=Context_page(context)->Image[layer].Pixels;
     }
   }
 }
@@ -2019,6 +2057,19 @@ const int Min_edits_for_safety_backup = 10;
 const int Max_interval_for_safety_backup = 60000;
 const int Max_edits_for_safety_backup = 30;
 
+/// Time spent writing the safety backup at each idle iteration (ms)
+const int Safety_backup_step_time = 10;
+/// Number of pixels compressed between two checks of the time
+#define SAFETY_BACKUP_STEP_PIXELS 4096
+
+/// The safety backup being written
+static struct
+{
+  T_GIF_writer * Writer; ///< NULL when no backup is being written
+  T_IO_Context Context;
+  T_Page * Snapshot;     ///< the page being saved
+} Safety_backup;
+
 ///
 /// Adds a file to Backups_main or Backups_spare lists, if it's a backup.
 ///
@@ -2194,8 +2245,6 @@ if (Create_lock_file(Config_directory))
 void Rotate_safety_backups(void)
 {
   dword now;
-  T_IO_Context context;
-  char file_name[12+1];
 
   if (!Safety_backup_active)
     return;
@@ -2211,38 +2260,93 @@ void Rotate_safety_backups(void)
       (Main.edits_since_safety_backup > 1 &&
       now > Main.time_of_safety_backup + Max_interval_for_safety_backup))
   {
-    char * deleted_file;
-    size_t len = strlen(Config_directory) + strlen(BACKUP_FILE_EXTENSION) + 1 + 6 + 1;
+    Main.safety_backup_pending = 1;
+  }
+}
 
-    deleted_file = GFX2_malloc(len);
-    if (deleted_file == NULL)
-      return;
-    // Clear a previous save (rotating saves)
-    snprintf(deleted_file, len, "%s%c%6.6d" BACKUP_FILE_EXTENSION,
-      Config_directory,
-      Main.safety_backup_prefix,
-      (dword)(Main.safety_number + 1000000l - Rotation_safety_backup) % (dword)1000000l);
-    Remove_path(deleted_file); // no matter if fail
-    free(deleted_file);
-
-    // Reset counters
-    Main.edits_since_safety_backup=0;
-    Main.time_of_safety_backup=now;
-
-    // Create a new file name and save
-    sprintf(file_name, "%c%6.6d" BACKUP_FILE_EXTENSION,
-      Main.safety_backup_prefix,
-      (int)Main.safety_number);
-    Init_context_backup_image(&context, file_name, Config_directory);
-    context.Format=FORMAT_GIF;
-    // Provide original file data, to store as a GIF Application Extension
-    context.Original_file_name = strdup(Main.backups->Pages->Filename);
-    context.Original_file_directory = strdup(Main.backups->Pages->File_directory);
-
-    Save_image(&context);
-    Destroy_context(&context);
+/// Close the safety backup being written
+static void End_safety_backup(void)
+{
+  Save_GIF_end(Safety_backup.Writer);
+  if (File_error)
+    GFX2_Log(GFX2_ERROR, "Failed to write safety backup %s\n", Safety_backup.Context.File_name);
+  Safety_backup.Writer = NULL;
+  Destroy_context(&Safety_backup.Context);
+  Free_snapshot(Safety_backup.Snapshot);
+  Safety_backup.Snapshot = NULL;
+}
+
+byte Safety_backup_in_progress(void)
+{
+  return Safety_backup.Writer != NULL;
+}
 
-    Main.safety_number++;
+void Safety_backup_when_idle(void)
+{
+  char file_name[12+1];
+  char * deleted_file;
+  size_t len;
+  dword start;
+
+  if (Safety_backup.Writer != NULL)
+  {
+    // Continue the backup being written
+    start = GFX2_GetTicks();
+    do
+    {
+      if (Save_GIF_step(Safety_backup.Writer, SAFETY_BACKUP_STEP_PIXELS))
+      {
+        End_safety_backup();
+        break;
+      }
+    } while (GFX2_GetTicks() - start < (dword)Safety_backup_step_time);
+    return;
+  }
+
+  if (!Safety_backup_active || !Main.safety_backup_pending)
+    return;
+
+  len = strlen(Config_directory) + strlen(BACKUP_FILE_EXTENSION) + 1 + 6 + 1;
+  deleted_file = GFX2_malloc(len);
+  if (deleted_file == NULL)
+    return;
+  // Clear a previous save (rotating saves)
+  snprintf(deleted_file, len, "%s%c%6.6d" BACKUP_FILE_EXTENSION,
+    Config_directory,
+    Main.safety_backup_prefix,
+    (dword)(Main.safety_number + 1000000l - Rotation_safety_backup) % (dword)1000000l);
+  Remove_path(deleted_file); // no matter if fail
+  free(deleted_file);
+
+  // Reset counters
+  Main.edits_since_safety_backup=0;
+  Main.time_of_safety_backup=GFX2_GetTicks();
+  Main.safety_backup_pending=0;
+
+  // Create a new file name and start saving. The pages can change before
+  // the end, so the file is saved from a snapshot.
+  sprintf(file_name, "%c%6.6d" BACKUP_FILE_EXTENSION,
+    Main.safety_backup_prefix,
+    (int)Main.safety_number);
+  Main.safety_number++;
+  Safety_backup.Snapshot = Snapshot_page(Main.backups->Pages);
+  if (Safety_backup.Snapshot == NULL)
+    return;
+  Init_context_backup_image(&Safety_backup.Context, file_name, Config_directory);
+  Safety_backup.Context.Format=FORMAT_GIF;
+  Safety_backup.Context.Page = Safety_backup.Snapshot;
+  Safety_backup.Context.Target_address = Safety_backup.Snapshot->Image[0].Pixels;
+  // Provide original file data, to store as a GIF Application Extension
+  Safety_backup.Context.Original_file_name = strdup(Main.backups->Pages->Filename);
+  Safety_backup.Context.Original_file_directory = strdup(Main.backups->Pages->File_directory);
+
+  Safety_backup.Writer = Save_GIF_start(&Safety_backup.Context);
+  if (Safety_backup.Writer == NULL)
+  {
+    GFX2_Log(GFX2_ERROR, "Failed to write safety backup %s\n", file_name);
+    Destroy_context(&Safety_backup.Context);
+    Free_snapshot(Safety_backup.Snapshot);
+    Safety_backup.Snapshot = NULL;
   }
 }
 
@@ -2255,6 +2359,10 @@ void Delete_safety_backups(void)
   if (!Safety_backup_active)
     return;
 
+  // an incomplete backup file is removed
+  if (Safety_backup.Writer != NULL)
+    End_safety_backup();
+
   Backups_main = NULL;
   Backups_spare = NULL;
 
@@ -59,6 +59,16 @@ typedef struct
   word * File_name_unicode;
   char * File_directory;
   byte Format;
+  /// When not NULL, the file is read from this memory block instead of the disk.
+  /// File_name and File_directory are still needed : some formats look at
+  /// the extension or for companion files.
+  const void * Memory_data;
+  unsigned long Memory_size;
+  /// When not NULL, the file is written to memory instead of the disk.
+  /// Once saved, *Memory_output is the data, to be freed by the caller even
+  /// if the save failed, and *Memory_output_size its size.
+  char * * Memory_output;
+  size_t * Memory_output_size;
   
   // Image properties
   
@@ -79,6 +89,9 @@ typedef struct
   byte *Target_address;
   /// Pitch: Difference of addresses between one pixel and the one just "below" it
   long Pitch;
+  /// Page saved for CONTEXT_MAIN_IMAGE, instead of the current page of the
+  /// main image. See Snapshot_page().
+  T_Page * Page;
   
   /// Original file name, stored in GIF file
   char * Original_file_name;
@@ -158,8 +171,21 @@ void Save_image(T_IO_Context *context);
 int Check_recovery(void);
 
 /// Makes a safety backup periodically.
+///
+/// Only checks if a backup is due : it is written later by
+/// Safety_backup_when_idle().
 void Rotate_safety_backups(void);
 
+/// Writes the safety backup of the main page, if one is due.
+///
+/// Called by the main loop when there is no user input and no operation
+/// in progress, so saving doesn't interrupt the drawing. The backup is
+/// saved from a snapshot of the page, a few milliseconds at each call.
+void Safety_backup_when_idle(void);
+
+/// Tells if a safety backup is being written by Safety_backup_when_idle().
+byte Safety_backup_in_progress(void);
+
 /// Remove safety backups. Need to call on normal program exit.
 void Delete_safety_backups(void);
 
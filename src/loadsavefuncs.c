@@ -53,6 +53,9 @@ FILE * Open_file_write(T_IO_Context *context)
 {
   FILE * f;
   char * filename; // filename with full path
+
+  if (context->Memory_output != NULL)
+    return Open_memory_write(context->Memory_output, context->Memory_output_size);
 #if defined(WIN32)
   if (context->File_name_unicode != NULL && context->File_name_unicode[0] != 0)
   {
@@ -114,6 +117,9 @@ FILE * Open_file_write_with_alternate_ext(T_IO_Context *context, const char * ex
   FILE * f;
   char *p;
   char * filename; // filename with full path
+
+  if (context->Memory_output != NULL)
+    return NULL;  // only one file can be written to memory
 #if defined(WIN32)
   if (context->File_name_unicode != NULL && context->File_name_unicode[0] != 0)
   {
@@ -159,6 +165,8 @@ FILE * Open_file_read(T_IO_Context *context)
   FILE * f;
   char * filename; // filename with full path
 
+  if (context->Memory_data != NULL)
+    return Open_memory_read(context->Memory_data, context->Memory_size);
   filename = Filepath_append_to_dir(context->File_directory, context->File_name);
   f = fopen(filename, "rb");
   free(filename);
@@ -292,6 +300,8 @@ void Remove_file(T_IO_Context *context)
 {
   char * filename; // filename with full path
 
+  if (context->Memory_data != NULL || context->Memory_output != NULL)
+    return;
   filename = Filepath_append_to_dir(context->File_directory, context->File_name);
   Remove_path(filename);
   free(filename);
@@ -657,6 +657,12 @@ int Init_program(int argc,char * argv[])
   GFX2_Log(GFX2_DEBUG, "program directory : %s\n", program_directory);
   GFX2_Log(GFX2_DEBUG, "Data directory : %s\n", Data_directory);
   GFX2_Log(GFX2_DEBUG, "Config directory : %s\n", Config_directory);
+  {
+    // Scratch files for big pictures go to the temporary directory, not
+    // to the settings : they can be several hundred megabytes.
+    const char * tmp = getenv("TMPDIR");
+    GFX2_set_scratch_directory((tmp != NULL && tmp[0] != '\0') ? tmp : "/tmp");
+  }
   GFX2_Log(GFX2_DEBUG, "Initial_directory : %s (unicode : %p)\n",
            Main.selector.Directory, Main.selector.Directory_unicode);
   free(program_directory);
@@ -1280,10 +1286,14 @@ void Program_shutdown(void)
   // Free all images
   Set_number_of_backups(-1); // even delete the main page
 
-  FREE_POINTER(Main.visible_image.Image);
-  FREE_POINTER(Spare.visible_image.Image);
-  FREE_POINTER(Main_visible_image_backup.Image);
-  FREE_POINTER(Main_visible_image_depth_buffer.Image);
+  GFX2_free_large(Main.visible_image.Image);
+  Main.visible_image.Image = NULL;
+  GFX2_free_large(Spare.visible_image.Image);
+  Spare.visible_image.Image = NULL;
+  GFX2_free_large(Main_visible_image_backup.Image);
+  Main_visible_image_backup.Image = NULL;
+  GFX2_free_large(Main_visible_image_depth_buffer.Image);
+  Main_visible_image_depth_buffer.Image = NULL;
 
   FREE_POINTER(Main.backups);
   FREE_POINTER(Spare.backups);
@@ -668,15 +668,52 @@ void Zoom_a_line(byte* original_line, byte* zoomed_line,
 {
   byte color;
   word x;
+  word pair;
+  dword quad;
+  int i;
 
-  // Pour chaque pixel
-  for(x=0;x<width;x++){
-    color = *original_line;
-
-    memset(zoomed_line,color,factor);
-    zoomed_line+=factor;
-
-    original_line++;
+  // The usual factors are written with 2 or 4 bytes stores, which is much
+  // faster than a memset() call per pixel
+  switch (factor)
+  {
+    case 1:
+      memcpy(zoomed_line, original_line, width);
+      break;
+    case 2:
+      for(x=0;x<width;x++)
+      {
+        pair = original_line[x] * 0x0101;
+        memcpy(zoomed_line + 2*x, &pair, 2);
+      }
+      break;
+    case 3:
+      for(x=0;x<width;x++)
+        zoomed_line[3*x] = zoomed_line[3*x+1] = zoomed_line[3*x+2] = original_line[x];
+      break;
+    case 4:
+      for(x=0;x<width;x++)
+      {
+        quad = original_line[x] * 0x01010101u;
+        memcpy(zoomed_line + 4*x, &quad, 4);
+      }
+      break;
+    default:
+      // Pour chaque pixel
+      for(x=0;x<width;x++){
+        color = *original_line;
+
+        if ((factor & 3) == 0)
+        {
+          quad = color * 0x01010101u;
+          for (i = 0; i < factor; i += 4)
+            memcpy(zoomed_line + i, &quad, 4);
+        }
+        else
+          memset(zoomed_line,color,factor);
+        zoomed_line+=factor;
+
+        original_line++;
+      }
   }
 }
 
@@ -27,6 +27,7 @@
 #endif
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
 #include <ctype.h>
 #include <math.h>
 #include "struct.h"
@@ -42,6 +43,7 @@
 #include "graph.h"
 #include "bitcount.h"
 #include "loadsavefuncs.h"
+#include "gfx2thread.h"
 
 // I don't have round() in MSVC++ 2010 (_MSC_VER=1600)
 // or in mintlib
@@ -1095,3 +1097,454 @@ void MSX_set_palette(T_Components * palette)
   palette[0].G = 32;
   palette[0].B = 32;
 }
+
+/// Distance between two colors, using the same formula as Best_color()
+static int Constrained_color_distance(const T_Components * c1, int r, int g, int b)
+{
+  int delta_r = (int)c1->R - r;
+  int delta_g = (int)c1->G - g;
+  int delta_b = (int)c1->B - b;
+  int rmean = ((int)c1->R + r) / 2;
+
+  return (((512+rmean)*delta_r*delta_r)>>8) + 4*delta_g*delta_g + (((767-rmean)*delta_b*delta_b)>>8);
+}
+
+/// Index of the nearest color among a set of colors
+static byte Constrained_nearest(const T_Components * palette, const byte * set, int set_size, int r, int g, int b)
+{
+  int i;
+  int best_dist = 0x7fffffff;
+  byte best = set[0];
+
+  for (i = 0; i < set_size; i++)
+  {
+    int dist = Constrained_color_distance(palette + set[i], r, g, b);
+    if (dist < best_dist)
+    {
+      best_dist = dist;
+      best = set[i];
+    }
+  }
+  return best;
+}
+
+/// Clamp a color component with accumulated dithering error
+static int Clamp_component(int v)
+{
+  return (v < 0) ? 0 : ((v > 255) ? 255 : v);
+}
+
+/**
+ * Write the pixels of a cell, using for each row a set of allowed colors.
+ *
+ * With dithering, the error is diffused (Floyd-Steinberg) to the
+ * neighbour pixels inside the cell only, so each cell can be converted
+ * independently.
+ */
+static void Map_constrained_cell(byte * dest, long dest_pitch,
+                                 const T_Components * source, long source_pitch,
+                                 int width, int height,
+                                 const byte (*sets)[4], int set_per_row, int set_size,
+                                 const T_Components * palette, int dither)
+{
+  int x, y;
+  int error[2][8+2][3]; // current and next row, with 1 pixel margins
+
+  memset(error, 0, sizeof(error));
+  for (y = 0; y < height; y++)
+  {
+    const byte * set = sets[set_per_row ? y : 0];
+    for (x = 0; x < width; x++)
+    {
+      const T_Components * pixel = source + x + y * source_pitch;
+      int r = pixel->R, g = pixel->G, b = pixel->B;
+      byte color;
+
+      if (dither)
+      {
+        r = Clamp_component(r + error[0][x+1][0] / 16);
+        g = Clamp_component(g + error[0][x+1][1] / 16);
+        b = Clamp_component(b + error[0][x+1][2] / 16);
+      }
+      color = Constrained_nearest(palette, set, set_size, r, g, b);
+      dest[x + y * dest_pitch] = color;
+      if (dither)
+      {
+        int c, e[3];
+
+        e[0] = r - palette[color].R;
+        e[1] = g - palette[color].G;
+        e[2] = b - palette[color].B;
+        for (c = 0; c < 3; c++)
+        {
+          if (x + 1 < width)
+          {
+            error[0][x+2][c] += e[c] * 7;
+            error[1][x+2][c] += e[c];
+          }
+          if (x > 0)
+            error[1][x][c] += e[c] * 3;
+          error[1][x+1][c] += e[c] * 5;
+        }
+      }
+    }
+    memcpy(error[0], error[1], sizeof(error[0]));
+    memset(error[1], 0, sizeof(error[1]));
+  }
+}
+
+/**
+ * Compute the error of a cell (or part of a cell) with a color set
+ *
+ * @param distances distance of each pixel of the cell to the 16 colors
+ * @param limit stop counting when the error reaches this value
+ */
+static long Constrained_set_error(const int (*distances)[16], int count, const byte * set, int set_size, long limit)
+{
+  int i, j;
+  long error = 0;
+
+  for (i = 0; i < count && error < limit; i++)
+  {
+    int best = distances[i][set[0]];
+    for (j = 1; j < set_size; j++)
+      if (distances[i][set[j]] < best)
+        best = distances[i][set[j]];
+    error += best;
+  }
+  return error;
+}
+
+/// Fill the table of distances between the pixels of a cell and the 16 colors
+static void Constrained_cell_distances(int (*distances)[16],
+                                       const T_Components * source, long source_pitch,
+                                       int width, int height, const T_Components * palette)
+{
+  int x, y, c;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+    {
+      const T_Components * pixel = source + x + y * source_pitch;
+      for (c = 0; c < 16; c++)
+        distances[x + y * width][c] = Constrained_color_distance(palette + c, pixel->R, pixel->G, pixel->B);
+    }
+}
+
+/// Maximum number of threads sharing a conversion
+#define CONSTRAINED_MAX_THREADS 16
+
+/// Function converting the cell rows [first_row, end_row[ of a job
+typedef void (* Func_constrained_rows)(const void * job, int first_row, int end_row);
+
+/// A band of cell rows, converted by one thread
+typedef struct
+{
+  Func_constrained_rows Convert;
+  const void * Job;
+  int First_row;
+  int End_row;
+} T_Constrained_band;
+
+static int Convert_constrained_band(void * data)
+{
+  T_Constrained_band * band = (T_Constrained_band *)data;
+
+  band->Convert(band->Job, band->First_row, band->End_row);
+  return 0;
+}
+
+/**
+ * Split the cell rows of a conversion in bands, and convert each band on
+ * its own thread. The cells must be independent from each other.
+ */
+static void Convert_constrained_rows(Func_constrained_rows convert, const void * job, int nb_rows)
+{
+  T_Constrained_band bands[CONSTRAINED_MAX_THREADS];
+  T_GFX2_Thread * threads[CONSTRAINED_MAX_THREADS];
+  int nb_bands = GFX2_CPU_count();
+  int i;
+
+  if (nb_bands > CONSTRAINED_MAX_THREADS)
+    nb_bands = CONSTRAINED_MAX_THREADS;
+  if (nb_bands > nb_rows)
+    nb_bands = nb_rows;
+  if (nb_bands < 1)
+    nb_bands = 1;
+  for (i = 0; i < nb_bands; i++)
+  {
+    bands[i].Convert = convert;
+    bands[i].Job = job;
+    bands[i].First_row = nb_rows * i / nb_bands;
+    bands[i].End_row = nb_rows * (i + 1) / nb_bands;
+  }
+  // the first band is converted by this thread
+  for (i = 1; i < nb_bands; i++)
+    threads[i] = GFX2_Thread_create(Convert_constrained_band, bands + i);
+  Convert_constrained_band(bands);
+  for (i = 1; i < nb_bands; i++)
+  {
+    if (threads[i] != NULL)
+      GFX2_Thread_wait(threads[i]);
+    else
+      Convert_constrained_band(bands + i);
+  }
+}
+
+/// Parameters of Convert_to_constrained_mode() shared by its threads
+typedef struct
+{
+  byte * Dest;
+  long Dest_pitch;
+  const T_Components * Source;
+  long Source_pitch;
+  word Width;
+  word Height;
+  const T_Components * Palette;
+  int Dither;
+  const byte (*Candidates)[4];
+  int Nb_candidates;
+  int Set_size;
+  int Cell_width;
+  int Cell_height;
+} T_Constrained_job;
+
+/// Convert the cell rows [first_row, end_row[ of a T_Constrained_job
+static void Convert_constrained_cells(const void * data, int first_row, int end_row)
+{
+  const T_Constrained_job * job = (const T_Constrained_job *)data;
+  int x, y;
+
+  for (y = first_row * job->Cell_height; y < end_row * job->Cell_height && y < job->Height; y += job->Cell_height)
+  {
+    for (x = 0; x < job->Width; x += job->Cell_width)
+    {
+      int distances[8*8][16];
+      int w = (x + job->Cell_width > job->Width) ? job->Width - x : job->Cell_width;
+      int h = (y + job->Cell_height > job->Height) ? job->Height - y : job->Cell_height;
+      const T_Components * source = job->Source + x + y * job->Source_pitch;
+      long best_error = LONG_MAX;
+      int best = 0;
+      int i;
+
+      Constrained_cell_distances(distances, source, job->Source_pitch, w, h, job->Palette);
+      for (i = 0; i < job->Nb_candidates && best_error > 0; i++)
+      {
+        long error = Constrained_set_error((const int (*)[16])distances, w * h, job->Candidates[i], job->Set_size, best_error);
+        if (error < best_error)
+        {
+          best_error = error;
+          best = i;
+        }
+      }
+      Map_constrained_cell(job->Dest + x + y * job->Dest_pitch, job->Dest_pitch,
+                           source, job->Source_pitch, w, h,
+                           job->Candidates + best, 0, job->Set_size, job->Palette, job->Dither);
+    }
+  }
+}
+
+int Convert_to_constrained_mode(enum IMAGE_MODES mode, byte * dest, long dest_pitch,
+                                const T_Components * source, long source_pitch,
+                                word width, word height,
+                                const T_Components * palette, int dither)
+{
+  T_Constrained_job job;
+  byte (*candidates)[4];
+  int nb_candidates = 0;
+  int set_size;
+  int cell_width = 8, cell_height = 8;
+  int a, b, c;
+
+  // list all the color combinations allowed in a cell
+  candidates = (byte (*)[4])malloc(sizeof(byte[4]) * 15*14*13/6);
+  if (candidates == NULL)
+    return -1;
+  switch (mode)
+  {
+    case IMAGE_MODE_ZX:
+      // 2 colors with the same brightness
+      set_size = 2;
+      for (a = 0; a < 16; a++)
+        for (b = a + 1; b < ((a & 8) + 8); b++)
+        {
+          candidates[nb_candidates][0] = a;
+          candidates[nb_candidates++][1] = b;
+        }
+      break;
+    case IMAGE_MODE_THOMSON:
+      cell_height = 1;
+      // fall through
+    case IMAGE_MODE_C64HIRES:
+      // 2 colors
+      set_size = 2;
+      for (a = 0; a < 16; a++)
+        for (b = a + 1; b < 16; b++)
+        {
+          candidates[nb_candidates][0] = a;
+          candidates[nb_candidates++][1] = b;
+        }
+      break;
+    case IMAGE_MODE_C64MULTI:
+      // the background color #0 + 3 colors
+      cell_width = 4;
+      set_size = 4;
+      for (a = 1; a < 16; a++)
+        for (b = a + 1; b < 16; b++)
+          for (c = b + 1; c < 16; c++)
+          {
+            candidates[nb_candidates][0] = 0;
+            candidates[nb_candidates][1] = a;
+            candidates[nb_candidates][2] = b;
+            candidates[nb_candidates++][3] = c;
+          }
+      break;
+    default:
+      free(candidates);
+      return -1;
+  }
+
+  job.Dest = dest;
+  job.Dest_pitch = dest_pitch;
+  job.Source = source;
+  job.Source_pitch = source_pitch;
+  job.Width = width;
+  job.Height = height;
+  job.Palette = palette;
+  job.Dither = dither;
+  job.Candidates = (const byte (*)[4])candidates;
+  job.Nb_candidates = nb_candidates;
+  job.Set_size = set_size;
+  job.Cell_width = cell_width;
+  job.Cell_height = cell_height;
+  Convert_constrained_rows(Convert_constrained_cells, &job, (height + cell_height - 1) / cell_height);
+  free(candidates);
+  return 0;
+}
+
+/// Parameters of C64_truecolor_to_FLI() shared by its threads
+typedef struct
+{
+  byte * Pixels;
+  long Pitch;
+  byte * Color_ram;
+  const byte * Background;
+  const byte * Nearest;
+  const T_Components * Source;
+  long Source_pitch;
+  const T_Components * Palette;
+  int Dither;
+} T_FLI_job;
+
+/// Convert the rows of 4x8 blocks [first_row, end_row[ of a T_FLI_job
+static void Convert_FLI_blocks(const void * data, int first_row, int end_row)
+{
+  const T_FLI_job * job = (const T_FLI_job *)data;
+  byte * color_ram = job->Color_ram;
+  int bx, by, cx, cy;
+
+  for (by = first_row; by < end_row; by++)
+  {
+    for (bx = 0; bx < 40; bx++)
+    {
+      word usage[16];
+      int distances[4][16];
+      byte sets[8][4];
+
+      // Color RAM : most used color of the 4x8 block, besides the backgrounds
+      memset(usage, 0, sizeof(usage));
+      for (cy = 0; cy < 8; cy++)
+        for (cx = 0; cx < 4; cx++)
+        {
+          byte col = job->Nearest[bx*4+cx + (by*8+cy) * 160];
+          if (col != job->Background[by*8+cy])
+            usage[col]++;
+        }
+      color_ram[bx + by*40] = 0;
+      for (cx = 1; cx < 16; cx++)
+        if (usage[cx] > usage[color_ram[bx + by*40]])
+          color_ram[bx + by*40] = cx;
+
+      // Screen RAM : best 2 colors for each 4x1 line of the block
+      for (cy = 0; cy < 8; cy++)
+      {
+        const T_Components * line = job->Source + bx*4 + (by*8+cy) * job->Source_pitch;
+        long best_error = LONG_MAX;
+        int a, b;
+
+        Constrained_cell_distances(distances, line, job->Source_pitch, 4, 1, job->Palette);
+        sets[cy][0] = job->Background[by*8+cy];
+        sets[cy][1] = color_ram[bx + by*40];
+        for (a = 0; a < 16 && best_error > 0; a++)
+          for (b = a; b < 16 && best_error > 0; b++)
+          {
+            byte set[4];
+            long error;
+
+            set[0] = sets[cy][0];
+            set[1] = sets[cy][1];
+            set[2] = a;
+            set[3] = b;
+            error = Constrained_set_error((const int (*)[16])distances, 4, set, 4, best_error);
+            if (error < best_error)
+            {
+              best_error = error;
+              sets[cy][2] = a;
+              sets[cy][3] = b;
+            }
+          }
+      }
+      Map_constrained_cell(job->Pixels + bx*4 + by*8*job->Pitch, job->Pitch,
+                           job->Source + bx*4 + by*8*job->Source_pitch, job->Source_pitch, 4, 8,
+                           (const byte (*)[4])sets, 1, 4, job->Palette, job->Dither);
+    }
+  }
+}
+
+int C64_truecolor_to_FLI(byte * pixels, long pitch, byte * color_ram, byte * background,
+                         const T_Components * source, long source_pitch,
+                         const T_Components * palette, int dither)
+{
+  T_FLI_job job;
+  byte * nearest;
+  int cx;
+  int x, y;
+  static const byte all_colors[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+  nearest = (byte *)malloc(160*200);
+  if (nearest == NULL)
+    return -1;
+  for (y = 0; y < 200; y++)
+    for (x = 0; x < 160; x++)
+    {
+      const T_Components * pixel = source + x + y * source_pitch;
+      nearest[x + y * 160] = Constrained_nearest(palette, all_colors, 16, pixel->R, pixel->G, pixel->B);
+    }
+
+  // background : most used color of each line
+  for (y = 0; y < 200; y++)
+  {
+    word usage[16];
+
+    memset(usage, 0, sizeof(usage));
+    for (x = 0; x < 160; x++)
+      usage[nearest[x + y * 160]]++;
+    background[y] = 0;
+    for (cx = 1; cx < 16; cx++)
+      if (usage[cx] > usage[background[y]])
+        background[y] = cx;
+  }
+
+  job.Pixels = pixels;
+  job.Pitch = pitch;
+  job.Color_ram = color_ram;
+  job.Background = background;
+  job.Nearest = nearest;
+  job.Source = source;
+  job.Source_pitch = source_pitch;
+  job.Palette = palette;
+  job.Dither = dither;
+  Convert_constrained_rows(Convert_FLI_blocks, &job, 25);
+  free(nearest);
+  return 0;
+}
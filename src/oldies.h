@@ -77,6 +77,29 @@ int C64_FLI(T_IO_Context * context, byte *bitmap, byte *screen_ram, byte *color_
  */
 int C64_pixels_to_FLI(byte *bitmap, byte *screen_ram, byte *color_ram, byte *background, const byte * pixels, long pitch, int errmode);
 
+/**
+ * Convert a truecolor picture to pixels respecting the C64 FLI constraints
+ *
+ * The background of each line and the Color RAM value of each 4x8 block
+ * are the most used colors. Then for each 4x1 block the 2 other
+ * colors giving the lowest error are chosen. The rows of 4x8 blocks are
+ * shared between threads.
+ * The resulting pixels can be passed to C64_pixels_to_FLI() without error.
+ *
+ * @param pixels 160x200 buffer receiving the color indexes (0-15)
+ * @param pitch bytes per line of the pixels buffer
+ * @param color_ram a 1000 byte buffer to store the color RAM
+ * @param background a 200 byte buffer to store the background colors
+ * @param source 160x200 truecolor picture
+ * @param source_pitch pixels per line of the source
+ * @param palette the 16 colors of the C64
+ * @param dither 0 for the nearest colors, 1 for error diffusion inside blocks
+ * @return 0 for success, -1 for a memory allocation error
+ */
+int C64_truecolor_to_FLI(byte * pixels, long pitch, byte * color_ram, byte * background,
+                         const T_Components * source, long source_pitch,
+                         const T_Components * palette, int dither);
+
 /**
  * Set the 16 colors Commodore 64 palette
  */
@@ -307,4 +330,33 @@ void DHGR_set_palette(T_Components * palette);
  */
 void MSX_set_palette(T_Components * palette);
 
+/**
+ * Convert a truecolor picture to a mode with color constraints per block.
+ *
+ * For each block, all the allowed color combinations are tried and
+ * the one giving the lowest error is kept.
+ * Blocks are independent from each other : the rows of blocks are shared
+ * between as many threads as there are CPUs.
+ *
+ * Supported modes are IMAGE_MODE_ZX (2 colors of the same brightness per
+ * 8x8 block), IMAGE_MODE_C64HIRES (2 colors per 8x8 block),
+ * IMAGE_MODE_C64MULTI (color #0 + 3 colors per 4x8 block) and
+ * IMAGE_MODE_THOMSON (2 colors per 8x1 block).
+ *
+ * @param mode the constraint mode
+ * @param dest buffer receiving the color indexes (0-15)
+ * @param dest_pitch bytes per line of dest
+ * @param source truecolor picture
+ * @param source_pitch pixels per line of the source
+ * @param width picture width
+ * @param height picture height
+ * @param palette the 16 colors of the machine
+ * @param dither 0 for the nearest colors, 1 for error diffusion inside blocks
+ * @return 0 for success, -1 for an unsupported mode or a memory allocation error
+ */
+int Convert_to_constrained_mode(enum IMAGE_MODES mode, byte * dest, long dest_pitch,
+                                const T_Components * source, long source_pitch,
+                                word width, word height,
+                                const T_Components * palette, int dither);
+
 #endif
@@ -212,6 +212,31 @@ void Freehand_mode1_1_0(void)
 }
 
 
+/// Draws the continuous line through all the cursor positions merged by the
+/// last Get_input(), from (start_x, start_y) to the current paintbrush.
+static void Draw_freehand_stroke(short start_x, short start_y, byte color)
+{
+  short x, y;
+  int drawn = 0;
+  int i;
+
+  // The last sample is the current position, drawn below
+  for (i = 0; i < Input_samples_count - 1; i++)
+  {
+    Compute_sample_paintbrush_coordinates(Input_samples[i].X, Input_samples[i].Y, &x, &y);
+    if ( (start_y!=y) || (start_x!=x) )
+    {
+      Draw_line_permanent(start_x,start_y,x,y,color);
+      start_x = x;
+      start_y = y;
+      drawn = 1;
+    }
+  }
+  if ( !drawn || (start_y!=Paintbrush_Y) || (start_x!=Paintbrush_X) )
+    Draw_line_permanent(start_x,start_y,Paintbrush_X,Paintbrush_Y,color);
+}
+
+
 void Freehand_mode1_1_2(void)
 //  Opération   : OPERATION_CONTINUOUS_DRAW
 //  Click Souris: 1
@@ -229,7 +254,7 @@ void Freehand_mode1_1_2(void)
   {
     Hide_cursor();
     Print_coordinates();
-    Draw_line_permanent(start_x,start_y,Paintbrush_X,Paintbrush_Y,Fore_color);
+    Draw_freehand_stroke(start_x,start_y,Fore_color);
     Display_cursor();
   }
 
@@ -287,7 +312,7 @@ void Freehand_mode1_2_2(void)
   {
     Print_coordinates();
     Hide_cursor();
-    Draw_line_permanent(start_x,start_y,Paintbrush_X,Paintbrush_Y,Back_color);
+    Draw_freehand_stroke(start_x,start_y,Back_color);
     Display_cursor();
   }
 
@@ -1984,6 +2009,7 @@ void Airbrush_1_0(void)
   Init_start_operation();
   Backup();
   Shade_table=Shade_table_left;
+  Airbrush_seed((dword)rand() ^ GFX2_GetTicks());
 
   if (GFX2_GetTicks()>Airbrush_next_time)
   {
@@ -2010,6 +2036,7 @@ void Airbrush_2_0(void)
   Init_start_operation();
   Backup();
   Shade_table=Shade_table_right;
+  Airbrush_seed((dword)rand() ^ GFX2_GetTicks());
   if (GFX2_GetTicks()>Airbrush_next_time)
   {
     Airbrush(RIGHT_SIDE);
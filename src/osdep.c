@@ -31,6 +31,7 @@
 #include <SDL.h>
 #elif !defined(WIN32)
 #include <sys/time.h>
+#include <time.h>
 #endif
 
 #if defined(WIN32)
@@ -96,6 +97,12 @@ dword GFX2_GetTicks(void)
   return GetTickCount();
 #else
   struct timeval tv;
+#if defined(CLOCK_MONOTONIC)
+  // not affected by changes of the system time
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
   if (gettimeofday(&tv, NULL) < 0)
     return 0;
   return tv.tv_sec * 1000 + tv.tv_usec / 1000;
@@ -0,0 +1,214 @@
+/* vim:expandtab:ts=2 sw=2:
+*/
+/*  Grafx2 - The Ultimate 256-color bitmap paint program
+
+    Copyright 2026 GrafX2 contributors
+
+    Grafx2 is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; version 2
+    of the License.
+
+    Grafx2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Grafx2; if not, see <http://www.gnu.org/licenses/>
+*/
+
+///@file overview.c
+/// Reduced copies of the picture, for the overview window.
+
+#include <stdlib.h>
+#include "overview.h"
+
+/// One reduced copy of the picture
+typedef struct
+{
+  byte * Pixels;
+  word Width;
+  word Height;
+} T_Overview_level;
+
+/// Levels 1 to Nb_levels. Level 0 is the picture itself.
+static T_Overview_level Levels[OVERVIEW_MAX_LEVEL+1];
+static int Nb_levels = 0;
+/// The picture the levels were computed from
+static const byte * Source = NULL;
+static word Source_width = 0;
+static word Source_height = 0;
+/// Area of the picture modified since the last update, end excluded
+static int Dirty = 0;
+static int Dirty_x1, Dirty_y1, Dirty_x2, Dirty_y2;
+
+void Overview_invalidate(int x, int y, int width, int height)
+{
+  if (width <= 0 || height <= 0)
+    return;
+  if (!Dirty)
+  {
+    Dirty = 1;
+    Dirty_x1 = x;
+    Dirty_y1 = y;
+    Dirty_x2 = x + width;
+    Dirty_y2 = y + height;
+    return;
+  }
+  if (x < Dirty_x1)
+    Dirty_x1 = x;
+  if (y < Dirty_y1)
+    Dirty_y1 = y;
+  if (x + width > Dirty_x2)
+    Dirty_x2 = x + width;
+  if (y + height > Dirty_y2)
+    Dirty_y2 = y + height;
+}
+
+void Overview_invalidate_all(void)
+{
+  Dirty = 1;
+  Dirty_x1 = 0;
+  Dirty_y1 = 0;
+  Dirty_x2 = 0x10000;
+  Dirty_y2 = 0x10000;
+}
+
+/// Dominant color of a 2x2 block : the most frequent one, the top-left
+/// pixel in case of a tie.
+static byte Dominant_color(byte a, byte b, byte c, byte d)
+{
+  if (a == b || a == c || a == d)
+    return a;
+  if (b == c || b == d)
+    return b;
+  if (c == d)
+    return c;
+  return a;
+}
+
+/// Reduce the blocks (x1,y1)-(x2,y2) of a level into the next one.
+/// A single row or column on the right or bottom edge counts twice.
+static void Reduce(const byte * src, word src_width, word src_height,
+                   T_Overview_level * dest, int x1, int y1, int x2, int y2)
+{
+  int x, y;
+
+  for (y = y1; y < y2; y++)
+  {
+    const byte * row0 = src + (2 * y) * src_width;
+    const byte * row1 = (2 * y + 1 < src_height) ? row0 + src_width : row0;
+    byte * out = dest->Pixels + y * dest->Width;
+
+    for (x = x1; x < x2; x++)
+    {
+      int left = 2 * x;
+      int right = (left + 1 < src_width) ? left + 1 : left;
+
+      out[x] = Dominant_color(row0[left], row0[right], row1[left], row1[right]);
+    }
+  }
+}
+
+void Overview_free(void)
+{
+  int level;
+
+  for (level = 1; level <= Nb_levels; level++)
+  {
+    free(Levels[level].Pixels);
+    Levels[level].Pixels = NULL;
+  }
+  Nb_levels = 0;
+  Source = NULL;
+  Source_width = 0;
+  Source_height = 0;
+}
+
+/// Compute the levels again in the modified area, then add the missing
+/// levels down to the one requested.
+/// @return 0 if out of memory
+static int Update_levels(const byte * image, int level)
+{
+  int n;
+
+  if (Dirty)
+  {
+    int x1 = Dirty_x1 < 0 ? 0 : Dirty_x1;
+    int y1 = Dirty_y1 < 0 ? 0 : Dirty_y1;
+    int x2 = Dirty_x2 > Source_width ? Source_width : Dirty_x2;
+    int y2 = Dirty_y2 > Source_height ? Source_height : Dirty_y2;
+
+    for (n = 1; n <= Nb_levels && x1 < x2 && y1 < y2; n++)
+    {
+      const byte * src = (n == 1) ? image : Levels[n-1].Pixels;
+      word src_width = (n == 1) ? Source_width : Levels[n-1].Width;
+      word src_height = (n == 1) ? Source_height : Levels[n-1].Height;
+
+      x1 >>= 1;
+      y1 >>= 1;
+      x2 = (x2 + 1) >> 1;
+      y2 = (y2 + 1) >> 1;
+      Reduce(src, src_width, src_height, &Levels[n], x1, y1, x2, y2);
+    }
+    Dirty = 0;
+  }
+  for (n = Nb_levels + 1; n <= level; n++)
+  {
+    const byte * src = (n == 1) ? image : Levels[n-1].Pixels;
+    word src_width = (n == 1) ? Source_width : Levels[n-1].Width;
+    word src_height = (n == 1) ? Source_height : Levels[n-1].Height;
+
+    Levels[n].Width = (src_width + 1) >> 1;
+    Levels[n].Height = (src_height + 1) >> 1;
+    Levels[n].Pixels = malloc((size_t)Levels[n].Width * Levels[n].Height);
+    if (Levels[n].Pixels == NULL)
+      return 0;
+    Reduce(src, src_width, src_height, &Levels[n], 0, 0, Levels[n].Width, Levels[n].Height);
+    Nb_levels = n;
+  }
+  return 1;
+}
+
+const byte * Overview_get_level(const byte * image, word width, word height,
+                                int level, word * level_width, word * level_height)
+{
+  if (level > OVERVIEW_MAX_LEVEL)
+    level = OVERVIEW_MAX_LEVEL;
+  if (level <= 0)
+  {
+    *level_width = width;
+    *level_height = height;
+    return image;
+  }
+  if (image != Source || width != Source_width || height != Source_height)
+  {
+    Overview_free();
+    Source = image;
+    Source_width = width;
+    Source_height = height;
+    Dirty = 0;
+  }
+  if (!Update_levels(image, level))
+  {
+    Overview_free();
+    return NULL;
+  }
+  *level_width = Levels[level].Width;
+  *level_height = Levels[level].Height;
+  return Levels[level].Pixels;
+}
+
+int Overview_level_for_size(word width, word height, word max_width, word max_height)
+{
+  int level = 0;
+
+  while ((width > max_width || height > max_height) && level < OVERVIEW_MAX_LEVEL)
+  {
+    width = (width + 1) >> 1;
+    height = (height + 1) >> 1;
+    level++;
+  }
+  return level;
+}
@@ -0,0 +1,80 @@
+/* vim:expandtab:ts=2 sw=2:
+*/
+/*  Grafx2 - The Ultimate 256-color bitmap paint program
+
+    Copyright 2026 GrafX2 contributors
+
+    Grafx2 is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; version 2
+    of the License.
+
+    Grafx2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Grafx2; if not, see <http://www.gnu.org/licenses/>
+*/
+
+///@file overview.h
+/// Reduced copies of the picture, for the overview window.
+///
+/// Level n of the pyramid is the picture reduced 2^n times in each
+/// direction. Each pixel takes the dominant color of the 2x2 block it
+/// replaces in the previous level, so the reduced pictures only use
+/// indices of the palette and small details don't blend into new colors.
+/// The levels are kept between calls, and only the areas marked with
+/// Overview_invalidate() are computed again.
+
+#ifndef OVERVIEW_H_INCLUDED
+#define OVERVIEW_H_INCLUDED
+
+#include "struct.h"
+
+/// Highest level that can be computed. 2^16 is more than the maximum picture size.
+#define OVERVIEW_MAX_LEVEL 16
+
+/**
+ * Mark an area of the picture as modified.
+ *
+ * The coordinates are in picture pixels, and may exceed the picture.
+ */
+void Overview_invalidate(int x, int y, int width, int height);
+
+/**
+ * Mark the whole picture as modified.
+ */
+void Overview_invalidate_all(void);
+
+/**
+ * Get a reduced copy of a picture.
+ *
+ * The pyramid is (re)built if the picture size changed, otherwise only the
+ * invalidated areas are computed again.
+ *
+ * @param image the pixels of the picture, width*height bytes
+ * @param width width of the picture
+ * @param height height of the picture
+ * @param level 0 for the picture itself, n for a 2^n reduction
+ * @param level_width receives the width of the returned level
+ * @param level_height receives the height of the returned level
+ * @return the pixels of the level, or NULL if out of memory
+ */
+const byte * Overview_get_level(const byte * image, word width, word height,
+                                int level, word * level_width, word * level_height);
+
+/**
+ * Find the smallest reduction of a picture that fits in a given area.
+ *
+ * @return the level to use with Overview_get_level()
+ */
+int Overview_level_for_size(word width, word height, word max_width, word max_height);
+
+/**
+ * Free the memory used by the reduced copies.
+ */
+void Overview_free(void);
+
+#endif
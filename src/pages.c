@@ -41,6 +41,9 @@
 #include "graph.h"
 #include "layers.h"
 #include "unicode.h"
+#include "gfx2log.h"
+#include "rle.h"
+#include "overview.h"
 
 // -- Layers data
 
@@ -62,9 +65,13 @@ long Stats_pages_number=0;
 /// Total memory used by bitmaps (layers, animation frames, backups)
 long long Stats_pages_memory=0;
 
+/// Pages made by Snapshot_page(), linked by their Next field
+static T_Page * Snapshots = NULL;
+
 /// Allocate and initialize a new page.
 T_Page * New_page(int nb_layers)
 {
+  static dword serial = 0;
   T_Page * page;
   
   page = (T_Page *)GFX2_malloc(sizeof(T_Page)+nb_layers*sizeof(T_Image));
@@ -90,6 +97,7 @@ T_Page * New_page(int nb_layers)
     page->Transparent_color = 0; // Default transparent color
     page->Background_transparent = 0;
     page->Next = page->Prev = NULL;
+    page->Serial = ++serial;
   }
   return page;
 }
@@ -97,60 +105,452 @@ T_Page * New_page(int nb_layers)
 // ==============================================================
 // Layers allocation functions.
 //
-// Layers are made of a "number of users" (short), followed by
+// Layers are made of a header (T_Layer_header), followed by
 // the actual pixel data (a large number of bytes).
 // Every time a layer is 'duplicated' as a reference, the number
 // of users is incremented.
 // Every time a layer is freed, the number of users is decreased,
 // and only when it reaches zero the pixel data is freed.
+//
+// The layers of old undo pages are packed (see Update_packed_pages()) :
+// then the data following the header is RLE packed pixels, or the RLE
+// packed XOR of the pixels with a "base" layer, usually the same layer
+// one step later. Such a delta layer holds a reference to its base.
 // ==============================================================
 
+/// Header stored before the pixel data of each layer
+typedef struct
+{
+  byte * Base;      ///< For a delta layer, the layer whose pixels the packed data is XORed with
+  long Packed_size; ///< 0 for pixels, LAYER_NOT_PACKABLE, or the size of the packed pixels
+  short Users;      ///< Number of pages and delta layers using this layer
+  short Chain;      ///< Length of the longest chain of delta layers based on this one
+} T_Layer_header;
+
+/// T_Layer_header::Packed_size of a layer which doesn't pack well, so it is
+/// not tried again.
+#define LAYER_NOT_PACKABLE -1
+
+#define LAYER_HEADER(pixels) (((T_Layer_header *)(pixels)) - 1)
+
+/// Number of pages at the start of each list whose layers are not packed :
+/// the current page, and the previous steps read by the drawing operations.
+#define UNPACKED_PAGES 3
+
+/// Maximum number of delta layers to apply in order to get the pixels of a
+/// packed layer. Past this, layers are packed whole.
+#define MAX_DELTA_CHAIN 8
+
 /// Allocate a new layer
 byte * New_layer(long pixel_size)
 {
-  short * ptr = GFX2_malloc(sizeof(short)+pixel_size);
-  if (ptr==NULL)
+  T_Layer_header * header = GFX2_malloc_large(sizeof(T_Layer_header)+pixel_size);
+  if (header==NULL)
     return NULL;
     
   // Stats
   Stats_pages_number++;
   Stats_pages_memory+=pixel_size;
   
-  *ptr = 1;
-  return (byte *)(ptr+1);
+  header->Base = NULL;
+  header->Packed_size = 0;
+  header->Users = 1;
+  header->Chain = 0;
+  return (byte *)(header+1);
+}
+
+/// Remove a reference to a layer, and free it when it is no longer used
+static void Release_layer(byte * pixels, long size)
+{
+  T_Layer_header * header = LAYER_HEADER(pixels);
+
+  if (-- header->Users)
+    return;
+  if (header->Base != NULL)
+    Release_layer(header->Base, size);
+
+  // Stats
+  Stats_pages_number--;
+  Stats_pages_memory -= (header->Packed_size > 0) ? header->Packed_size : size;
+
+  if (header->Packed_size > 0)
+    free(header);
+  else
+    GFX2_free_large(header);
 }
 
 /// Free a layer
 void Free_layer(T_Page * page, int layer)
 {
-  short * ptr;
   if (page->Image[layer].Pixels==NULL)
     return;
-    
-  ptr = (short *)(page->Image[layer].Pixels);
-  if (-- (*(ptr-1))) // Users--
-    return;
-  else {
-    free(ptr-1);
-  }
-    
-  // Stats
-  Stats_pages_number--;
-  Stats_pages_memory-=page->Width * page->Height;
+
+  Release_layer(page->Image[layer].Pixels, (long)page->Width * page->Height);
 }
 
 /// Duplicate a layer (new reference)
 byte * Dup_layer(byte * layer)
 {
-  short * ptr = (short *)(layer);
-  
   if (layer==NULL)
     return NULL;
   
-  (*(ptr-1)) ++; // Users ++
+  LAYER_HEADER(layer)->Users++;
   return layer;
 }
 
+static void Xor_pixels(byte * pixels, const byte * reference, long size)
+{
+  long i;
+
+  for (i = 0; i < size; i++)
+    pixels[i] ^= reference[i];
+}
+
+/// Get the pixels of a layer, packed or not.
+///
+/// @return 0 for success, -1 if the packed data is corrupted
+static int Get_layer_pixels(byte * dest, byte * pixels, long size)
+{
+  T_Layer_header * header = LAYER_HEADER(pixels);
+
+  if (header->Packed_size <= 0)
+  {
+    memcpy(dest, pixels, size);
+    return 0;
+  }
+  if (header->Base == NULL)
+    return RLE_unpack(dest, size, pixels, header->Packed_size);
+  if (Get_layer_pixels(dest, header->Base, size) < 0)
+    return -1;
+  return RLE_unpack_xor(dest, size, pixels, header->Packed_size);
+}
+
+/// Pack the pixels of a layer.
+///
+/// @param base layer of the same size to pack the difference with, or NULL
+/// @return the packed layer, or NULL if the layer is left unchanged
+static byte * Pack_layer(byte * pixels, long size, byte * base)
+{
+  T_Layer_header * header = LAYER_HEADER(pixels);
+  T_Layer_header * packed;
+  T_Layer_header * shrunk;
+  long max_size = size - size / 4; // only worth it if it saves 25%
+  long packed_size = 0;
+  const byte * reference = base;
+  byte * unpacked_base = NULL;
+
+  if (base != NULL)
+  {
+    T_Layer_header * node;
+    int depth = 1;
+
+    // Number of delta layers to unpack to get the pixels of this one
+    for (node = LAYER_HEADER(base); node->Base != NULL && node != header; node = LAYER_HEADER(node->Base))
+      depth++;
+    if (node == header || header->Chain + depth > MAX_DELTA_CHAIN)
+      base = NULL; // keyframe
+  }
+  packed = malloc(sizeof(T_Layer_header) + max_size);
+  if (packed == NULL)
+    return NULL;
+  if (base != NULL && LAYER_HEADER(base)->Packed_size > 0)
+  {
+    unpacked_base = malloc(size);
+    if (unpacked_base == NULL || Get_layer_pixels(unpacked_base, base, size) < 0)
+      base = NULL;
+    reference = unpacked_base;
+  }
+  if (base != NULL)
+  {
+    // the layer is freed after packing, so XOR it in place
+    Xor_pixels(pixels, reference, size);
+    packed_size = RLE_pack((byte *)(packed + 1), max_size, pixels, size);
+    if (packed_size == 0)
+    {
+      Xor_pixels(pixels, reference, size);
+      base = NULL;
+    }
+  }
+  free(unpacked_base);
+  if (base == NULL)
+    packed_size = RLE_pack((byte *)(packed + 1), max_size, pixels, size);
+  if (packed_size == 0)
+  {
+    free(packed);
+    header->Packed_size = LAYER_NOT_PACKABLE;
+    return NULL;
+  }
+  shrunk = realloc(packed, sizeof(T_Layer_header) + packed_size);
+  if (shrunk != NULL)
+    packed = shrunk;
+  packed->Base = base;
+  packed->Packed_size = packed_size;
+  packed->Users = header->Users;
+  packed->Chain = header->Chain;
+  if (base != NULL)
+  {
+    T_Layer_header * node;
+    short chain = header->Chain + 1;
+
+    LAYER_HEADER(base)->Users++;
+    for (node = LAYER_HEADER(base); node != NULL; node = node->Base ? LAYER_HEADER(node->Base) : NULL)
+    {
+      if (node->Chain < chain)
+        node->Chain = chain;
+      chain++;
+    }
+  }
+  GFX2_free_large(header);
+  Stats_pages_memory += packed_size - size;
+  return (byte *)(packed + 1);
+}
+
+/// Unpack the pixels of a packed layer.
+///
+/// @return the unpacked layer, or NULL in case of error
+static byte * Unpack_layer(byte * pixels, long size)
+{
+  T_Layer_header * header = LAYER_HEADER(pixels);
+  T_Layer_header * unpacked;
+
+  unpacked = GFX2_malloc_large(sizeof(T_Layer_header) + size);
+  if (unpacked == NULL)
+    return NULL;
+  if (Get_layer_pixels((byte *)(unpacked + 1), pixels, size) < 0)
+  {
+    GFX2_Log(GFX2_ERROR, "Unpack_layer() corrupted layer data\n");
+    GFX2_free_large(unpacked);
+    return NULL;
+  }
+  unpacked->Base = NULL;
+  unpacked->Packed_size = 0;
+  unpacked->Users = header->Users;
+  unpacked->Chain = header->Chain;
+  Stats_pages_memory += size - header->Packed_size;
+  if (header->Base != NULL)
+    Release_layer(header->Base, size);
+  free(header);
+  return (byte *)(unpacked + 1);
+}
+
+/// A layer which has been packed or unpacked
+typedef struct
+{
+  byte * Old; ///< first, for Compare_layer_pointers()
+  byte * New;
+} T_Layer_move;
+
+/// A layer to pack
+typedef struct
+{
+  byte * Pixels; ///< first, for Compare_layer_pointers()
+  T_Page * Page; ///< The most recent page using the layer
+  int Layer;     ///< Index of the layer in Page
+} T_Layer_ref;
+
+static int Compare_layer_pointers(const void * a, const void * b)
+{
+  const byte * p1 = *(byte * const *)a;
+  const byte * p2 = *(byte * const *)b;
+  return (p1 < p2) ? -1 : (p1 > p2);
+}
+
+/// Update the pages of a list, and the delta layers, which use layers that
+/// have been (un)packed
+static void Apply_layer_moves(T_List_of_pages * list, T_Layer_move * moves, int nb_moves)
+{
+  T_Page * page = list->Pages;
+  int i;
+
+  if (nb_moves == 0)
+    return;
+  qsort(moves, nb_moves, sizeof(T_Layer_move), Compare_layer_pointers);
+  do
+  {
+    for (i = 0; i < page->Nb_layers; i++)
+    {
+      T_Layer_header * header;
+      T_Layer_move * move = bsearch(&page->Image[i].Pixels, moves, nb_moves, sizeof(T_Layer_move), Compare_layer_pointers);
+      if (move != NULL)
+        page->Image[i].Pixels = move->New;
+      if (page->Image[i].Pixels == NULL)
+        continue;
+      // Every layer still in use can be reached from a page through the
+      // bases of the delta layers
+      for (header = LAYER_HEADER(page->Image[i].Pixels); header->Base != NULL; header = LAYER_HEADER(header->Base))
+      {
+        move = bsearch(&header->Base, moves, nb_moves, sizeof(T_Layer_move), Compare_layer_pointers);
+        if (move != NULL)
+          header->Base = move->New;
+      }
+    }
+    page = page->Next;
+  } while (page != list->Pages);
+}
+
+/// Find the layer to use as a base for packing a layer of an old page
+/// as a delta : the same layer in the following step.
+///
+/// @return the base layer, or NULL to pack the layer whole
+static byte * Delta_base(T_List_of_pages * list, T_Page * page, int layer)
+{
+  T_Page * newer = page->Prev;
+  byte * base;
+  int i;
+
+  // The list is circular : don't wrap from its end to the current page.
+  // After several undos, the newest redo page follows the oldest undo
+  // page in the list, so also check that the base is really more recent.
+  if (page == list->Pages->Prev || newer->Serial < page->Serial)
+    return NULL;
+  if (newer == list->Pages || layer >= newer->Nb_layers
+    || newer->Width != page->Width || newer->Height != page->Height)
+    return NULL;
+  base = newer->Image[layer].Pixels;
+  if (base == NULL || base == page->Image[layer].Pixels)
+    return NULL;
+  // The layers of the current page are modified by the drawing operations
+  for (i = 0; i < list->Pages->Nb_layers; i++)
+    if (list->Pages->Image[i].Pixels == base)
+      return NULL;
+  return base;
+}
+
+/// Pack the layers of the old pages of a list, and unpack the layers of the
+/// recent ones.
+///
+/// The current page and the ones before it (up to ::UNPACKED_PAGES) use
+/// plain pixels, which the rest of the program reads directly. The page to
+/// redo is not packed either, so undo/redo back and forth stays fast.
+/// Then, if the memory used is over Config.Undo_memory, the oldest pages
+/// are freed.
+static void Update_packed_pages(T_List_of_pages * list)
+{
+  T_Page * page;
+  byte ** hot_layers;
+  T_Layer_ref * cold_layers;
+  int nb_hot_layers = 0;
+  int nb_cold_layers = 0;
+  int total_layers = 0;
+  int depth, i;
+
+  if (list == NULL || list->Pages == NULL)
+    return;
+
+  // Unpack the layers of the recent pages
+  page = list->Pages;
+  for (depth = 0; depth < UNPACKED_PAGES && depth < list->List_size; depth++, page = page->Next)
+  {
+    for (i = 0; i < page->Nb_layers; i++)
+    {
+      T_Layer_move move;
+      long size = (long)page->Width * page->Height;
+
+      move.Old = page->Image[i].Pixels;
+      if (move.Old == NULL || LAYER_HEADER(move.Old)->Packed_size <= 0)
+        continue;
+      move.New = Unpack_layer(move.Old, size);
+      while (move.New == NULL && list->List_size > UNPACKED_PAGES)
+      {
+        // Make room by forgetting the oldest step
+        Free_last_page_of_list(list);
+        move.New = Unpack_layer(move.Old, size);
+      }
+      if (move.New == NULL)
+      {
+        GFX2_Log(GFX2_ERROR, "Update_packed_pages() failed to unpack a layer\n");
+        continue;
+      }
+      // also update the other pages using this layer
+      Apply_layer_moves(list, &move, 1);
+    }
+  }
+
+  page = list->Pages;
+  do
+  {
+    total_layers += page->Nb_layers;
+    page = page->Next;
+  } while (page != list->Pages);
+  for (page = Snapshots; page != NULL; page = page->Next)
+    total_layers += page->Nb_layers;
+  hot_layers = malloc(total_layers * sizeof(byte *));
+  cold_layers = malloc(total_layers * sizeof(T_Layer_ref));
+  if (hot_layers == NULL || cold_layers == NULL)
+  {
+    free(hot_layers);
+    free(cold_layers);
+    return;
+  }
+
+  // Pack the layers which are only used by old pages
+  page = list->Pages;
+  for (depth = 0; depth < list->List_size; depth++, page = page->Next)
+  {
+    if (depth < UNPACKED_PAGES || page == list->Pages->Prev)
+      for (i = 0; i < page->Nb_layers; i++)
+        hot_layers[nb_hot_layers++] = page->Image[i].Pixels;
+  }
+  // Packing frees the pixels, which the snapshots read
+  for (page = Snapshots; page != NULL; page = page->Next)
+    for (i = 0; i < page->Nb_layers; i++)
+      hot_layers[nb_hot_layers++] = page->Image[i].Pixels;
+  page = list->Pages;
+  qsort(hot_layers, nb_hot_layers, sizeof(byte *), Compare_layer_pointers);
+  for (depth = 0; depth < list->List_size; depth++, page = page->Next)
+  {
+    if (depth < UNPACKED_PAGES || page == list->Pages->Prev)
+      continue;
+    for (i = 0; i < page->Nb_layers; i++)
+    {
+      byte * pixels = page->Image[i].Pixels;
+
+      if (pixels != NULL && LAYER_HEADER(pixels)->Packed_size == 0
+        && bsearch(&pixels, hot_layers, nb_hot_layers, sizeof(byte *), Compare_layer_pointers) == NULL)
+      {
+        cold_layers[nb_cold_layers].Pixels = pixels;
+        cold_layers[nb_cold_layers].Page = page;
+        cold_layers[nb_cold_layers++].Layer = i;
+      }
+    }
+  }
+  // Sorted by address, each layer once, from its most recent page
+  // (qsort() isn't stable, so compare the positions in the list)
+  qsort(cold_layers, nb_cold_layers, sizeof(T_Layer_ref), Compare_layer_pointers);
+  for (i = 0; i < nb_cold_layers; i++)
+  {
+    T_Layer_ref * ref = cold_layers + i;
+    T_Page * newest;
+    T_Layer_move move;
+    int j;
+
+    if (i > 0 && cold_layers[i].Pixels == cold_layers[i - 1].Pixels)
+      continue;
+    for (j = i + 1; j < nb_cold_layers && cold_layers[j].Pixels == ref->Pixels; j++)
+    {
+      for (newest = list->Pages; newest != ref->Page && newest != cold_layers[j].Page; newest = newest->Next)
+        ;
+      if (newest == cold_layers[j].Page)
+        ref = cold_layers + j;
+    }
+    // Packed one at a time, so the base is always a valid layer. It can be
+    // a layer packed just before : the moves also update the delta layers.
+    move.Old = ref->Pixels;
+    move.New = Pack_layer(ref->Pixels, (long)ref->Page->Width * ref->Page->Height,
+      Delta_base(list, ref->Page, ref->Layer));
+    if (move.New != NULL)
+      Apply_layer_moves(list, &move, 1);
+  }
+  free(hot_layers);
+  free(cold_layers);
+
+  if (Config.Undo_memory > 0)
+  {
+    while (list->List_size > 2 && Stats_pages_memory > ((long long)Config.Undo_memory << 20))
+      Free_last_page_of_list(list);
+  }
+}
+
 // ==============================================================
 
 /// Adds a shared reference to the gradient data of another page. Pass NULL for new.
@@ -203,8 +603,106 @@ void Download_infos_page_main(T_Page * page)
   
 }
 
+/// Number of pixels composited at a time by Flatten_layers(), so the
+/// working buffers stay in the processor cache while all layers go over
+/// them.
+#define FLATTEN_TILE 4096
+
+/// Composite layers over each other.
+///
+/// The layers are processed tile by tile, from the top one down, and
+/// stop as soon as all pixels of the tile are known. The loops have no
+/// branch so the compiler can vectorize them.
+///
+/// @param page the layers
+/// @param layers bit mask of the layers to use
+/// @param size number of pixels in each layer
+/// @param dest receives the colors, or NULL. May be the bottom layer itself.
+/// @param depth receives the index of the layer showing at each pixel, or NULL
+/// @param depth_skip layer ignored for the depth buffer (the current one), or -1
+/// @return the bottom layer, or -1 if there was no layer to use
+static int Flatten_layers(const T_Page * page, dword layers, long size,
+                          byte * dest, byte * depth, int depth_skip)
+{
+  int list[MAX_NB_LAYERS];
+  int nb_layers = 0;
+  int bottom = -1;
+  int layer;
+  int k;
+  long start;
+  byte transparent = page->Transparent_color;
+  byte color_done[FLATTEN_TILE];
+  byte depth_done[FLATTEN_TILE];
+
+  for (layer = 0; layer < page->Nb_layers; layer++)
+  {
+    if (!(layers & (1 << layer)))
+      continue;
+    if (bottom < 0)
+      bottom = layer;
+    else
+      list[nb_layers++] = layer;
+  }
+  if (bottom < 0)
+    return -1;
+
+  for (start = 0; start < size; start += FLATTEN_TILE)
+  {
+    long n = (size - start < FLATTEN_TILE) ? size - start : FLATTEN_TILE;
+    byte * color_tile = (dest != NULL) ? dest + start : NULL;
+    byte * depth_tile = (depth != NULL) ? depth + start : NULL;
+    int colors_left = (dest != NULL);
+    int depths_left = (depth != NULL);
+    long i;
+
+    // The bottom layer shows where no other layer is opaque
+    if (dest != NULL && dest != page->Image[bottom].Pixels)
+      memcpy(color_tile, page->Image[bottom].Pixels + start, n);
+    if (depth != NULL)
+      memset(depth_tile, bottom, n);
+    memset(color_done, 0, n);
+    memset(depth_done, 0, n);
+
+    for (k = nb_layers - 1; k >= 0 && (colors_left || depths_left); k--)
+    {
+      const byte * src = page->Image[list[k]].Pixels + start;
+
+      if (colors_left)
+      {
+        byte all_done = 0xFF;
+
+        for (i = 0; i < n; i++)
+        {
+          byte take = (byte)(-(src[i] != transparent)) & ~color_done[i];
+
+          color_tile[i] = (color_tile[i] & ~take) | (src[i] & take);
+          color_done[i] |= take;
+          all_done &= color_done[i];
+        }
+        colors_left = (all_done != 0xFF);
+      }
+      if (depths_left && list[k] != depth_skip)
+      {
+        byte all_done = 0xFF;
+
+        for (i = 0; i < n; i++)
+        {
+          byte take = (byte)(-(src[i] != transparent)) & ~depth_done[i];
+
+          depth_tile[i] = (depth_tile[i] & ~take) | ((byte)list[k] & take);
+          depth_done[i] |= take;
+          all_done &= depth_done[i];
+        }
+        depths_left = (all_done != 0xFF);
+      }
+    }
+  }
+  return bottom;
+}
+
 void Redraw_layered_image(void)
 {
+  Overview_invalidate_all();
   if (Main.backups->Pages->Image_mode != IMAGE_MODE_ANIMATION)
   {
     // Re-construct the image with the visible layers
@@ -235,25 +733,12 @@ void Redraw_layered_image(void)
     }
     else
     {
-      for (layer=0; layer<Main.backups->Pages->Nb_layers; layer++)
-      {
-        if ((1<<layer) & Main.layers_visible)
-        {
-           // Copy it in Main_visible_image
-           memcpy(Main.visible_image.Image,
-             Main.backups->Pages->Image[layer].Pixels,
-             Main.image_width*Main.image_height);
-           
-           // Initialize the depth buffer
-           memset(Main_visible_image_depth_buffer.Image,
-             layer,
-             Main.image_width*Main.image_height);
-           
-           // skip all other layers
-           layer++;
-           break;
-        }
-      }
+      // All visible layers at once
+      Flatten_layers(Main.backups->Pages, Main.layers_visible,
+        (long)Main.image_width*Main.image_height,
+        Main.visible_image.Image, Main_visible_image_depth_buffer.Image,
+        Main.current_layer);
+      layer = Main.backups->Pages->Nb_layers;
     }
     // subsequent layer(s)
     for (; layer<Main.backups->Pages->Nb_layers; layer++)
@@ -288,43 +773,9 @@ void Update_depth_buffer(void)
     // Re-construct the depth buffer with the visible layers.
     // This function doesn't touch the visible buffer, it assumes
     // that it was already up-to-date. (Ex. user only changed active layer)
-  
-    int layer;  
-    // First layer
-    for (layer=0; layer<Main.backups->Pages->Nb_layers; layer++)
-    {
-      if ((1<<layer) & Main.layers_visible)
-      {
-         // Initialize the depth buffer
-         memset(Main_visible_image_depth_buffer.Image,
-           layer,
-           Main.image_width*Main.image_height);
-         
-         // skip all other layers
-         layer++;
-         break;
-      }
-    }
-    // subsequent layer(s)
-    for (; layer<Main.backups->Pages->Nb_layers; layer++)
-    {
-      // skip the current layer, whenever we reach it
-      if (layer == Main.current_layer)
-        continue;
-        
-      if ((1<<layer) & Main.layers_visible)
-      {
-        int i;
-        for (i=0; i<Main.image_width*Main.image_height; i++)
-        {
-          byte color = *(Main.backups->Pages->Image[layer].Pixels+i);
-          if (color != Main.backups->Pages->Transparent_color) // transparent color
-          {
-            *(Main_visible_image_depth_buffer.Image+i) = layer;
-          }
-        }
-      }
-    }
+    Flatten_layers(Main.backups->Pages, Main.layers_visible,
+      (long)Main.image_width*Main.image_height,
+      NULL, Main_visible_image_depth_buffer.Image, Main.current_layer);
   }
   Update_FX_feedback(Config.FX_Feedback);
 }
@@ -334,50 +785,16 @@ void Redraw_spare_image(void)
   if (Spare.backups->Pages->Image_mode != IMAGE_MODE_ANIMATION)
   {
     // Re-construct the image with the visible layers
-    byte layer;  
-    // First layer
-    for (layer=0; layer<Spare.backups->Pages->Nb_layers; layer++)
-    {
-      if ((1<<layer) & Spare.layers_visible)
-      {
-         // Copy it in Spare_visible_image
-         memcpy(Spare.visible_image.Image,
-           Spare.backups->Pages->Image[layer].Pixels,
-           Spare.image_width*Spare.image_height);
-         
-         // No depth buffer in the spare
-         //memset(Spare_visible_image_depth_buffer.Image,
-         //  layer,
-         //  Spare.image_width*Spare.image_height);
-         
-         // skip all other layers
-         layer++;
-         break;
-      }
-    }
-    // subsequent layer(s)
-    for (; layer<Spare.backups->Pages->Nb_layers; layer++)
-    {
-      if ((1<<layer) & Spare.layers_visible)
-      {
-        int i;
-        for (i=0; i<Spare.image_width*Spare.image_height; i++)
-        {
-          byte color = *(Spare.backups->Pages->Image[layer].Pixels+i);
-          if (color != Spare.backups->Pages->Transparent_color) // transparent color
-          {
-            *(Spare.visible_image.Image+i) = color;
-            //if (layer != Spare.current_layer)
-            //  *(Spare_visible_image_depth_buffer.Image+i) = layer;
-          }
-        }
-      }
-    }
+    // No depth buffer in the spare
+    Flatten_layers(Spare.backups->Pages, Spare.layers_visible,
+      (long)Spare.image_width*Spare.image_height,
+      Spare.visible_image.Image, NULL, -1);
   }
 }
 
 void Redraw_current_layer(void)
 {
+  Overview_invalidate_all();
   if (Main.backups->Pages->Image_mode != IMAGE_MODE_ANIMATION)
   {
     int i;
@@ -461,7 +878,10 @@ void Clear_page(T_Page * page)
 
 void Copy_S_page(T_Page * dest, T_Page * source)
 {
+  dword serial = dest->Serial;
+
   *dest = *source;
+  dest->Serial = serial; // the copy is a newer page
   dest->Gradients = Dup_gradient(source);
   if (source->File_directory != NULL)
     dest->File_directory = strdup(source->File_directory);
@@ -471,6 +891,45 @@ void Copy_S_page(T_Page * dest, T_Page * source)
     dest->Filename_unicode = Unicode_strdup(source->Filename_unicode);
 }
 
+T_Page * Snapshot_page(T_Page * page)
+{
+  T_Page * snapshot;
+  int i;
+
+  snapshot = New_page(page->Nb_layers);
+  if (snapshot == NULL)
+    return NULL;
+  Copy_S_page(snapshot, page);
+  for (i = 0; i < page->Nb_layers; i++)
+  {
+    snapshot->Image[i].Pixels = Dup_layer(page->Image[i].Pixels);
+    snapshot->Image[i].Duration = page->Image[i].Duration;
+  }
+  snapshot->Prev = NULL;
+  snapshot->Next = Snapshots;
+  Snapshots = snapshot;
+  return snapshot;
+}
+
+void Free_snapshot(T_Page * snapshot)
+{
+  T_Page ** link;
+
+  for (link = &Snapshots; *link != NULL; link = &(*link)->Next)
+  {
+    if (*link == snapshot)
+    {
+      *link = snapshot->Next;
+      break;
+    }
+  }
+  Clear_page(snapshot);
+  free(snapshot->File_directory);
+  free(snapshot->Filename);
+  free(snapshot->Filename_unicode);
+  free(snapshot);
+}
+
 
   ///
   /// GESTION DES LISTES DE PAGES
@@ -546,9 +1005,11 @@ void Backward_in_list_of_pages(T_List_of_pages * list)
       page0->Prev = page1;
       page1->Next = page0;
       list->Pages = page0;
+      Update_packed_pages(list);
       return;
   }
   list->Pages = list->Pages->Next;
+  Update_packed_pages(list);
 }
 
 void Advance_in_list_of_pages(T_List_of_pages * list)
@@ -585,9 +1046,11 @@ void Advance_in_list_of_pages(T_List_of_pages * list)
       page0->Next = page1;
       page1->Prev = page0;
       list->Pages = page1;
+      Update_packed_pages(list);
       return;
   }
   list->Pages = list->Pages->Prev;
+  Update_packed_pages(list);
 }
 
 void Free_last_page_of_list(T_List_of_pages * list)
@@ -653,7 +1116,8 @@ int Create_new_page(T_Page * new_page, T_List_of_pages * list, int layer)
   list->Pages->Prev = new_page;
   list->Pages = new_page;
   list->List_size++;
-  
+
+  Update_packed_pages(list);
   return 1;
 }
 
@@ -683,6 +1147,7 @@ void Free_page_of_a_list(T_List_of_pages * list)
 
 void Update_screen_targets(void)
 {
+  Overview_invalidate_all();
   if (Main.backups->Pages->Image_mode != IMAGE_MODE_ANIMATION)
   {
     Main_screen=Main.visible_image.Image;
@@ -715,8 +1180,8 @@ int Update_buffers(int width, int height)
     if (Main.visible_image.Width*Main.visible_image.Height != width*height)
     {
       // Current image
-      free(Main.visible_image.Image);
-      Main.visible_image.Image = (byte *)GFX2_malloc(width * height);
+      GFX2_free_large(Main.visible_image.Image);
+      Main.visible_image.Image = (byte *)GFX2_malloc_large(width * height);
       if (Main.visible_image.Image == NULL)
         return 0;
     }
@@ -726,8 +1191,8 @@ int Update_buffers(int width, int height)
     if (Main_visible_image_backup.Width*Main_visible_image_backup.Height != width*height)
     {
       // Previous image
-      free(Main_visible_image_backup.Image);
-      Main_visible_image_backup.Image = (byte *)GFX2_malloc(width * height);
+      GFX2_free_large(Main_visible_image_backup.Image);
+      Main_visible_image_backup.Image = (byte *)GFX2_malloc_large(width * height);
       if (Main_visible_image_backup.Image == NULL)
         return 0;
     }
@@ -737,8 +1202,8 @@ int Update_buffers(int width, int height)
     if (Main_visible_image_depth_buffer.Width*Main_visible_image_depth_buffer.Height != width*height)
     {      
       // Depth buffer
-      free(Main_visible_image_depth_buffer.Image);
-      Main_visible_image_depth_buffer.Image = (byte *)GFX2_malloc(width * height);
+      GFX2_free_large(Main_visible_image_depth_buffer.Image);
+      Main_visible_image_depth_buffer.Image = (byte *)GFX2_malloc_large(width * height);
       if (Main_visible_image_depth_buffer.Image == NULL)
         return 0;
     }
@@ -757,8 +1222,8 @@ int Update_spare_buffers(int width, int height)
     if (Spare.visible_image.Width*Spare.visible_image.Height != width*height)
     {
       // Current image
-      free(Spare.visible_image.Image);
-      Spare.visible_image.Image = (byte *)GFX2_malloc(width * height);
+      GFX2_free_large(Spare.visible_image.Image);
+      Spare.visible_image.Image = (byte *)GFX2_malloc_large(width * height);
       if (Spare.visible_image.Image == NULL)
         return 0;
     }
@@ -823,6 +1288,7 @@ int Init_all_backup_lists(enum IMAGE_MODES image_mode, int width, int height)
     memset(Main.visible_image.Image, 0, width*height);
     memset(Main_visible_image_backup.Image, 0, width*height);
     memset(Main_visible_image_depth_buffer.Image, 0, width*height);
+    Overview_invalidate_all();
   }
   if (Spare.visible_image.Image != NULL)
     memset(Spare.visible_image.Image, 0, width*height);
@@ -990,8 +1456,8 @@ int Backup_in_place(int width,int height)
     if (!new_layer[i])
     {
       // Allocation error
-      for (; i>0; i--)
-        free(new_layer[i]);
+      while (i-- > 0)
+        Release_layer(new_layer[i], (long)width * height);
       free(new_layer);
       return 0;
     }
@@ -1022,8 +1488,8 @@ int Backup_in_place(int width,int height)
     if (Main.visible_image.Width*Main.visible_image.Height != width*height)
     {
       // Current image
-      free(Main.visible_image.Image);
-      Main.visible_image.Image = (byte *)GFX2_malloc(width * height);
+      GFX2_free_large(Main.visible_image.Image);
+      Main.visible_image.Image = (byte *)GFX2_malloc_large(width * height);
       if (Main.visible_image.Image == NULL)
         return 0;
     }
@@ -1033,8 +1499,8 @@ int Backup_in_place(int width,int height)
     if (Main_visible_image_depth_buffer.Width*Main_visible_image_depth_buffer.Height != width*height)
     {      
       // Depth buffer
-      free(Main_visible_image_depth_buffer.Image);
-      Main_visible_image_depth_buffer.Image = (byte *)GFX2_malloc(width * height);
+      GFX2_free_large(Main_visible_image_depth_buffer.Image);
+      Main_visible_image_depth_buffer.Image = (byte *)GFX2_malloc_large(width * height);
       if (Main_visible_image_depth_buffer.Image == NULL)
         return 0;
     }
@@ -1138,6 +1604,7 @@ void Backup_layers(int layer)
                Main.image_width*Main.image_height);
     }
   }
+  Invalidate_cell_summaries();
   // Light up the 'has unsaved changes' indicator
   Main.image_is_modified=1;
   
@@ -1314,6 +1781,7 @@ void End_of_modification(void)
     Update_screen_targets();
   }
   Update_FX_feedback(Config.FX_Feedback);
+  Invalidate_cell_summaries();
 /*  
   Last_backed_up_layers = 0;
   Backup();
@@ -1484,13 +1952,11 @@ byte Delete_layer(T_List_of_pages *list, int layer)
 /// Merges the current layer onto the one below it.
 byte Merge_layer(void)
 {
-  int i;
-  for (i=0; i<Main.image_width*Main.image_height; i++)
-  {
-    byte color = *(Main.backups->Pages->Image[Main.current_layer].Pixels+i);
-    if (color != Main.backups->Pages->Transparent_color) // transparent color
-      *(Main.backups->Pages->Image[Main.current_layer-1].Pixels+i) = color;
-  }
+  // Composite the current layer directly in the one below
+  Flatten_layers(Main.backups->Pages,
+    (1 << Main.current_layer) | (1 << (Main.current_layer-1)),
+    (long)Main.image_width*Main.image_height,
+    Main.backups->Pages->Image[Main.current_layer-1].Pixels, NULL, -1);
   return Delete_layer(Main.backups,Main.current_layer);
 }
 
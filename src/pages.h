@@ -61,6 +61,12 @@ byte Delete_layer(T_List_of_pages *list, int layer);
 byte Merge_layer(void);
 /// Backs up a layer, unless it's already different from previous history step.
 int Dup_layer_if_shared(T_Page * page, int layer);
+/// Make a copy of a page which shares its layers, so they stay as they are
+/// while the image is edited. The layers of a snapshot are never packed.
+/// Returns NULL in case of error.
+T_Page * Snapshot_page(T_Page * page);
+/// Free a page made by Snapshot_page().
+void Free_snapshot(T_Page * snapshot);
 
 void Upload_infos_page(T_Document * doc);
 
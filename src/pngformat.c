@@ -35,6 +35,7 @@
 #include <string.h>
 #include <assert.h>
 #include <png.h>
+#include <zlib.h>
 #if !defined(PNG_HAVE_PLTE)
 #define PNG_HAVE_PLTE 0x02
 #endif
@@ -61,6 +62,7 @@
 #include "io.h"
 #include "misc.h"
 #include "gfx2log.h"
+#include "gfx2thread.h"
 
 #ifndef MIN
 #define MIN(a,b) ((a)<(b)?(a):(b))
@@ -164,35 +166,15 @@ static int PNG_read_unknown_chunk(png_structp ptr, png_unknown_chunkp chunk)
 }
 
 
-/// Private structure used in PNG_memory_read() and PNG_memory_write()
-struct PNG_memory_buffer {
-  char * buffer;
-  unsigned long offset;
-  unsigned long size;
-};
-
 /// read from memory buffer
 static void PNG_memory_read(png_structp png_ptr, png_bytep p, png_size_t count)
 {
-  struct PNG_memory_buffer * buffer = (struct PNG_memory_buffer *)png_get_io_ptr(png_ptr);
+  T_Memory_buffer * buffer = (T_Memory_buffer *)png_get_io_ptr(png_ptr);
   GFX2_Log(GFX2_DEBUG, "PNG_memory_read(%p, %p, %u) (io_ptr=%p)\n", png_ptr, p, count, buffer);
   if (buffer == NULL || p == NULL)
     return;
-  if (buffer->offset + count <= buffer->size)
-  {
-    memcpy(p, buffer->buffer + buffer->offset, count);
-    buffer->offset += count;
-  }
-  else
-  {
-    unsigned long available_count = buffer->size - buffer->offset;
-    GFX2_Log(GFX2_DEBUG, "PNG_memory_read(): only %lu bytes available\n", available_count);
-    if (available_count > 0)
-    {
-      memcpy(p, buffer->buffer + buffer->offset, available_count);
-      buffer->offset += available_count;
-    }
-  }
+  if (Memory_read(buffer, p, count) != count)
+    GFX2_Log(GFX2_DEBUG, "PNG_memory_read(): end of buffer reached\n");
 }
 
 
@@ -213,7 +195,7 @@ void Load_PNG_Sub(T_IO_Context * context, FILE * file, const char * memory_buffe
       png_byte color_type;
       png_byte bit_depth;
       byte bpp;
-      struct PNG_memory_buffer buffer;
+      T_Memory_buffer buffer;
 
       // Setup a return point. If a pnglib loading error occurs
       // in this if(), the else will be executed.
@@ -224,9 +206,8 @@ void Load_PNG_Sub(T_IO_Context * context, FILE * file, const char * memory_buffe
           png_init_io(png_ptr, file);
         else
         {
-          buffer.buffer = (char *)memory_buffer;
-          buffer.offset = 8;  // skip header
-          buffer.size = memory_buffer_size;
+          Memory_buffer_init_read(&buffer, memory_buffer, memory_buffer_size);
+          buffer.Offset = 8;  // skip header
           png_set_read_fn(png_ptr, &buffer, PNG_memory_read);
         }
         // Inform pnglib we already loaded the header.
@@ -573,33 +554,233 @@ void Load_PNG(T_IO_Context * context)
 /// Write to memory buffer
 static void PNG_memory_write(png_structp png_ptr, png_bytep p, png_size_t count)
 {
-  struct PNG_memory_buffer * buffer = (struct PNG_memory_buffer *)png_get_io_ptr(png_ptr);
+  T_Memory_buffer * buffer = (T_Memory_buffer *)png_get_io_ptr(png_ptr);
   GFX2_Log(GFX2_DEBUG, "PNG_memory_write(%p, %p, %u) (io_ptr=%p)\n", png_ptr, p, count, buffer);
-  if (buffer->size < buffer->offset + count)
+  if (!Memory_write(buffer, p, count))
   {
-    char * tmp = realloc(buffer->buffer, buffer->offset + count + 1024);
-    if (tmp == NULL)
-    {
-      GFX2_Log(GFX2_ERROR, "PNG_memory_write() Failed to allocate %u bytes of memory\n", buffer->offset + count + 1024);
-      File_error = 1;
-      return;
-    }
-    buffer->buffer = tmp;
-    buffer->size = buffer->offset + count + 1024;
+    GFX2_Log(GFX2_ERROR, "PNG_memory_write() Failed to write %u bytes\n", count);
+    File_error = 1;
   }
-  memcpy(buffer->buffer + buffer->offset, p, count);
-  buffer->offset += count;
 }
 
 /// do nothing
 static void PNG_memory_flush(png_structp png_ptr)
 {
-  struct PNG_memory_buffer * buffer = (struct PNG_memory_buffer *)png_get_io_ptr(png_ptr);
+  T_Memory_buffer * buffer = (T_Memory_buffer *)png_get_io_ptr(png_ptr);
   GFX2_Log(GFX2_DEBUG, "PNG_memory_flush(%p) (io_ptr=%p)\n", png_ptr, buffer);
 }
 
 
+/// Size of the blocks of filtered rows deflated independently
+#define PNG_DEFLATE_BLOCK_SIZE (128*1024)
+/// Maximum number of threads deflating the pixels of a PNG
+#define PNG_MAX_THREADS 16
+/// Maximum size of the IDAT chunks written by Save_PNG_Sub()
+#define PNG_IDAT_SIZE (1024*1024)
+
+/// zlib compression level selected by the PNG_compression setting
+static int PNG_Compression_level(void)
+{
+  switch (Config.PNG_compression)
+  {
+    case 1: // fast
+      return Z_BEST_SPEED;
+    case 2: // best
+      return Z_BEST_COMPRESSION;
+    default: // libpng defaults
+      return Z_DEFAULT_COMPRESSION;
+  }
+}
+
+/// zlib memory level selected by the PNG_compression setting
+static int PNG_Compression_mem_level(void)
+{
+  return (Config.PNG_compression == 2) ? 9 : 8;
+}
+
+/// A block of filtered rows, deflated on its own thread
+typedef struct
+{
+  const byte * Data;          ///< the filtered rows
+  unsigned long Size;
+  unsigned long Dictionary_size; ///< number of bytes before Data used to prime the compressor
+  int Last;                   ///< the block ends the deflate stream
+  int Level;
+  int Mem_level;
+  byte * Output;              ///< raw deflate data
+  unsigned long Output_size;
+  uLong Adler;                ///< Adler-32 of the block
+} T_PNG_block;
+
+/// Deflate a block of rows. Runs on a worker thread.
+/// @return 0 for success
+static int PNG_Deflate_block(void * data)
+{
+  T_PNG_block * block = (T_PNG_block *)data;
+  z_stream stream;
+  int result;
+
+  block->Adler = adler32(adler32(0L, Z_NULL, 0), block->Data, block->Size);
+  memset(&stream, 0, sizeof(stream));
+  // raw deflate : Save_PNG_Sub() writes the zlib header and trailer
+  if (deflateInit2(&stream, block->Level, Z_DEFLATED, -15, block->Mem_level, Z_DEFAULT_STRATEGY) != Z_OK)
+    return 1;
+  // room for the empty stored block of the sync flush
+  block->Output_size = deflateBound(&stream, block->Size) + 16;
+  block->Output = (byte *)malloc(block->Output_size);
+  if (block->Output == NULL)
+  {
+    deflateEnd(&stream);
+    return 1;
+  }
+  if (block->Dictionary_size > 0)
+    deflateSetDictionary(&stream, block->Data - block->Dictionary_size, block->Dictionary_size);
+  stream.next_in = (Bytef *)block->Data;
+  stream.avail_in = block->Size;
+  stream.next_out = block->Output;
+  stream.avail_out = block->Output_size;
+  // The sync flush ends the block on a byte boundary, so the output of
+  // the next block can be appended to it.
+  result = deflate(&stream, block->Last ? Z_FINISH : Z_SYNC_FLUSH);
+  block->Output_size = stream.total_out;
+  deflateEnd(&stream);
+  if (block->Last)
+    return result != Z_STREAM_END;
+  return result != Z_OK || stream.avail_in != 0 || stream.avail_out == 0;
+}
+
+/**
+ * Deflate the pixels of a PNG on several threads.
+ *
+ * Like pigz does, the filtered rows are cut in blocks of about
+ * PNG_DEFLATE_BLOCK_SIZE bytes, each one is deflated independently with
+ * the 32KB of rows before it as dictionary, and the outputs are joined in
+ * a single zlib stream. The blocks don't depend on the number of
+ * threads, so neither does the file.
+ *
+ * @param context the IO context
+ * @param size receives the size of the zlib stream
+ * @return the zlib stream (to free), or NULL when there is only one thread
+ *         or one block, or in case of error : libpng then does the work.
+ */
+static byte * PNG_Parallel_deflate(T_IO_Context * context, unsigned long * size)
+{
+  T_GFX2_Thread * threads[PNG_MAX_THREADS];
+  T_PNG_block * blocks;
+  byte * filtered;
+  byte * stream = NULL;
+  unsigned long row_size = (unsigned long)context->Width + 1;
+  unsigned long rows_per_block;
+  uLong adler;
+  byte flevel;
+  int level = PNG_Compression_level();
+  int nb_threads = GFX2_CPU_count();
+  int nb_blocks;
+  int error = 0;
+  int b, i, n;
+  int y;
+
+  rows_per_block = PNG_DEFLATE_BLOCK_SIZE / row_size;
+  if (rows_per_block < 1)
+    rows_per_block = 1;
+  nb_blocks = (int)((context->Height + rows_per_block - 1) / rows_per_block);
+  if (nb_threads > PNG_MAX_THREADS)
+    nb_threads = PNG_MAX_THREADS;
+  if (nb_threads > nb_blocks)
+    nb_threads = nb_blocks;
+  if (nb_threads < 2)
+    return NULL;
+
+  filtered = (byte *)malloc(row_size * context->Height);
+  blocks = (T_PNG_block *)calloc(nb_blocks, sizeof(T_PNG_block));
+  if (filtered == NULL || blocks == NULL)
+  {
+    free(filtered);
+    free(blocks);
+    return NULL;
+  }
+  // The filters don't help with indexed pixels : each row starts with
+  // the filter type "none"
+  for (y = 0; y < context->Height; y++)
+  {
+    filtered[y * row_size] = PNG_FILTER_VALUE_NONE;
+    memcpy(filtered + y * row_size + 1, context->Target_address + y * context->Pitch, context->Width);
+  }
+  for (b = 0; b < nb_blocks; b++)
+  {
+    unsigned long start = b * rows_per_block * row_size;
+
+    blocks[b].Data = filtered + start;
+    blocks[b].Size = MIN(rows_per_block * row_size, row_size * context->Height - start);
+    blocks[b].Dictionary_size = MIN(start, 32768);
+    blocks[b].Last = (b == nb_blocks - 1);
+    blocks[b].Level = level;
+    blocks[b].Mem_level = PNG_Compression_mem_level();
+  }
+
+  // Deflate the blocks by groups of nb_threads
+  for (b = 0; b < nb_blocks && !error; b += nb_threads)
+  {
+    n = MIN(nb_threads, nb_blocks - b);
+    // the first block of the group is deflated by this thread
+    for (i = 1; i < n; i++)
+      threads[i] = GFX2_Thread_create(PNG_Deflate_block, blocks + b + i);
+    error |= PNG_Deflate_block(blocks + b);
+    for (i = 1; i < n; i++)
+    {
+      if (threads[i] != NULL)
+        error |= GFX2_Thread_wait(threads[i]);
+      else
+        error |= PNG_Deflate_block(blocks + b + i);
+    }
+  }
+
+  if (!error)
+  {
+    *size = 2 + 4;
+    for (b = 0; b < nb_blocks; b++)
+      *size += blocks[b].Output_size;
+    stream = (byte *)malloc(*size);
+  }
+  if (stream != NULL)
+  {
+    byte * p = stream;
+
+    // zlib header : deflate with a 32KB window, and the compression level
+    if (level == Z_DEFAULT_COMPRESSION)
+      flevel = 2;
+    else
+      flevel = (level < 2) ? 0 : ((level < 6) ? 1 : ((level == 6) ? 2 : 3));
+    *p++ = 0x78;
+    *p = flevel << 6;
+    *p += 31 - ((0x78 << 8) + *p) % 31;
+    p++;
+    adler = blocks[0].Adler;
+    for (b = 0; b < nb_blocks; b++)
+    {
+      memcpy(p, blocks[b].Output, blocks[b].Output_size);
+      p += blocks[b].Output_size;
+      if (b > 0)
+        adler = adler32_combine(adler, blocks[b].Adler, blocks[b].Size);
+    }
+    // zlib trailer : Adler-32 of the whole data, big endian
+    *p++ = (byte)(adler >> 24);
+    *p++ = (byte)(adler >> 16);
+    *p++ = (byte)(adler >> 8);
+    *p++ = (byte)adler;
+  }
+  for (b = 0; b < nb_blocks; b++)
+    free(blocks[b].Output);
+  free(blocks);
+  free(filtered);
+  return stream;
+}
+
 /// Save a PNG to file or memory
+///
+/// When several threads are available, the pixels are deflated by
+/// PNG_Parallel_deflate() and the IDAT chunks are written here, instead
+/// of by png_write_image().
 /// @param context the IO context
 /// @param file the FILE to write to or NULL to write to memory
 /// @param buffer will receive a malloc'ed buffer if writting to memory
@@ -613,10 +794,14 @@ void Save_PNG_Sub(T_IO_Context * context, FILE * file, char * * buffer, unsigned
   png_infop info_ptr;
   png_unknown_chunk crng_chunk;
   byte cycle_data[16*6]; // Storage for color-cycling data, referenced by crng_chunk
-  struct PNG_memory_buffer memory_buffer;
+  T_Memory_buffer memory_buffer;
+  static byte * Idat = NULL;  // static, like Row_pointers, to survive longjmp()
+  static unsigned long Idat_size;
 
   assert((file != NULL) || ((buffer != NULL) && (buffer_size != NULL)));
   memset(&memory_buffer, 0, sizeof(memory_buffer));
+  Row_pointers = NULL;
+  Idat = PNG_Parallel_deflate(context, &Idat_size);
   /* initialisation */
   if ((png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL))
       && (info_ptr = png_create_info_struct(png_ptr)))
@@ -736,29 +921,51 @@ void Save_PNG_Sub(T_IO_Context * context, FILE * file, char * * buffer, unsigned
           png_set_unknown_chunk_location(png_ptr, info_ptr, 0, PNG_HAVE_PLTE);
         }
 
+        // The filters don't help with indexed pixels
+        png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+        png_set_compression_level(png_ptr, PNG_Compression_level());
+        png_set_compression_mem_level(png_ptr, PNG_Compression_mem_level());
 
         png_write_info(png_ptr, info_ptr);
 
-        /* ecriture des pixels de l'image */
-        Row_pointers = (png_bytep*) malloc(sizeof(png_bytep) * context->Height);
-        pixel_ptr = context->Target_address;
-        for (y=0; y<context->Height; y++)
-          Row_pointers[y] = (png_byte*)(pixel_ptr+y*context->Pitch);
+        if (Idat != NULL)
+        {
+          // The pixels are already deflated : write them in IDAT chunks,
+          // then the end of the file.
+          if (!setjmp(png_jmpbuf(png_ptr)))
+          {
+            unsigned long offset;
 
-        if (!setjmp(png_jmpbuf(png_ptr)))
+            for (offset = 0; offset < Idat_size; offset += PNG_IDAT_SIZE)
+              png_write_chunk(png_ptr, (png_bytep)"IDAT", Idat + offset, MIN(PNG_IDAT_SIZE, Idat_size - offset));
+            png_write_chunk(png_ptr, (png_bytep)"IEND", NULL, 0);
+          }
+          else
+            File_error=1;
+        }
+        else
         {
-          png_write_image(png_ptr, Row_pointers);
+          /* ecriture des pixels de l'image */
+          Row_pointers = (png_bytep*) malloc(sizeof(png_bytep) * context->Height);
+          pixel_ptr = context->Target_address;
+          for (y=0; y<context->Height; y++)
+            Row_pointers[y] = (png_byte*)(pixel_ptr+y*context->Pitch);
 
-          /* cloture png */
           if (!setjmp(png_jmpbuf(png_ptr)))
           {
-            png_write_end(png_ptr, NULL);
+            png_write_image(png_ptr, Row_pointers);
+
+            /* cloture png */
+            if (!setjmp(png_jmpbuf(png_ptr)))
+            {
+              png_write_end(png_ptr, NULL);
+            }
+            else
+              File_error=1;
           }
           else
             File_error=1;
         }
-        else
-          File_error=1;
       }
       else
         File_error=1;
@@ -774,14 +981,17 @@ void Save_PNG_Sub(T_IO_Context * context, FILE * file, char * * buffer, unsigned
 
   if (Row_pointers)
     free(Row_pointers);
+  Row_pointers = NULL;
+  free(Idat);
+  Idat = NULL;
   if (File_error == 0 && buffer != NULL)
   {
-    *buffer = memory_buffer.buffer;
+    *buffer = (char *)memory_buffer.Data;
     if (buffer_size != NULL)
-      *buffer_size = memory_buffer.offset;
+      *buffer_size = memory_buffer.Size;
   }
   else
-    free(memory_buffer.buffer);
+    free(memory_buffer.Data);
 }
 
 
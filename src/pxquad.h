@@ -38,10 +38,10 @@
   void Display_brush_mono_quad         (word x_pos,word y_pos,word x_offset,word y_offset,word width,word height,byte transp_color,byte color,word brush_width);
   void Clear_brush_quad                (word x_pos,word y_pos,word x_offset,word y_offset,word width,word height,byte transp_color,word image_width);
   void Remap_screen_quad               (word x_pos,word y_pos,word width,word height,byte * conversion_table);
-  void Display_part_of_screen_quad (word width,word height,word image_width);
+  void Display_part_of_screen_quad (word width,word y_start,word y_end,word image_width);
   void Display_line_on_screen_quad   (word x_pos,word y_pos,word width,byte * line);
   void Read_line_screen_quad       (word x_pos,word y_pos,word width,byte * line);
-  void Display_part_of_screen_scaled_quad(word width,word height,word image_width,byte * buffer);
+  void Display_part_of_screen_scaled_quad(word width,word y_start,word y_end,word image_width,byte * buffer);
   void Display_brush_color_zoom_quad   (word x_pos,word y_pos,word x_offset,word y_offset,word width,word end_y_pos,byte transp_color,word brush_width,byte * buffer);
   void Display_brush_mono_zoom_quad    (word x_pos,word y_pos,word x_offset,word y_offset,word width,word end_y_pos,byte transp_color,byte color,word brush_width,byte * buffer);
   void Clear_brush_scaled_quad           (word x_pos,word y_pos,word x_offset,word y_offset,word width,word end_y_pos,byte transp_color,word image_width,byte * buffer);
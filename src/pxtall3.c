@@ -62,14 +62,14 @@ void Block_tall3 (word start_x,word start_y,word width,word height,byte color)
   Screen_FillRect(start_x * ZOOMX, start_y * ZOOMY, width * ZOOMX, height * ZOOMY, color);
 }
 
-void Display_part_of_screen_tall3 (word width,word height,word image_width)
+void Display_part_of_screen_tall3 (word width,word y_start,word y_end,word image_width)
 /* Afficher une partie de l'image telle quelle sur l'écran */
 {
-  byte* src=Main.offset_Y*image_width+Main.offset_X+Main_screen; //Coords de départ ds la source (src)
+  byte* src=(Main.offset_Y+y_start)*image_width+Main.offset_X+Main_screen; //Coords de départ ds la source (src)
   int y;
   int dy;
 
-  for(y = 0; y < height; y++)
+  for(y = y_start; y < y_end; y++)
   // Pour chaque ligne
   {
     byte* dest = Get_Screen_pixel_ptr(0, y * ZOOMY);
@@ -90,7 +90,6 @@ void Display_part_of_screen_tall3 (word width,word height,word image_width)
     // On passe à la ligne suivante
     src+=image_width-width;
   }
-  //Update_rect(0,0,width,height);
 }
 
 void Pixel_preview_normal_tall3 (word x,word y,byte color)
@@ -399,44 +398,29 @@ void Read_line_screen_tall3(word x_pos,word y_pos,word width,byte * line)
 
 void Display_part_of_screen_scaled_tall3(
         word width, // width non zoomée
-        word height, // height zoomée
+        word y_start, // première ligne zoomée
+        word y_end, // ligne zoomée après la dernière
         word image_width,byte * buffer)
 {
-  byte* src = Main_screen + Main.magnifier_offset_Y * image_width
+  byte* src = Main_screen + (Main.magnifier_offset_Y + y_start / Main.magnifier_factor) * image_width
                       + Main.magnifier_offset_X;
-  int y = 0; // Ligne en cours de traitement
+  int y = y_start; // Ligne en cours de traitement
+  int x = Main.magnifier_factor - y_start % Main.magnifier_factor;
 
   // Pour chaque ligne à zoomer
-  while(1)
+  while(y < y_end)
   {
-    int x;
-    
     // On éclate la ligne
     Zoom_a_line(src,buffer,Main.magnifier_factor*ZOOMX,width);
     // On l'affiche Facteur fois, sur des lignes consécutives
-    x = Main.magnifier_factor/**ZOOMY*/;
-    // Pour chaque ligne
-    do{
-      // On affiche la ligne zoomée
+    for (; x > 0 && y < y_end; x--, y++)
       Display_line_on_screen_fast_tall3(
         Main.X_zoom, y, width*Main.magnifier_factor,
         buffer
       );
-      // On passe à la suivante
-      y++;
-      if(y==height/**ZOOMY*/)
-      {
-        Redraw_grid(Main.X_zoom,0,
-          width*Main.magnifier_factor,height);
-        Update_rect(Main.X_zoom,0,
-          width*Main.magnifier_factor,height);
-        return;
-      }
-      x--;
-    }while (x > 0);
+    x = Main.magnifier_factor;
     src += image_width;
   }
-// ATTENTION on n'arrive jamais ici !
 }
 
 // Affiche une partie de la brosse couleur zoomée
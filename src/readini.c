@@ -691,7 +691,7 @@ int Load_INI(T_Config * conf)
 
   if ((return_code=Load_INI_get_values (file,buffer,"Undo_pages",1,values)))
     goto Erreur_Retour;
-  if ((values[0]<1) || (values[0]>99))
+  if ((values[0]<1) || (values[0]>255))
     goto Erreur_ERREUR_INI_CORROMPU;
   conf->Max_undo_pages=values[0];
 
@@ -1056,6 +1056,42 @@ int Load_INI(T_Config * conf)
   {
     conf->MOTO_gamma=(byte)values[0];
   }
+
+  conf->Optimize_GIF_animations=1;
+  // Optional, transparent unchanged pixels in GIF animations (>=2.8)
+  if (!Load_INI_get_values (file,buffer,"Optimize_GIF_animations",1,values))
+  {
+    if ((values[0]<0) || (values[0]>1))
+      goto Erreur_ERREUR_INI_CORROMPU;
+    conf->Optimize_GIF_animations=values[0];
+  }
+
+  conf->Animation_cache_size=64;
+  // Optional, memory for the frames displayed during animation playback (>=2.8)
+  if (!Load_INI_get_values (file,buffer,"Animation_cache_size",1,values))
+  {
+    if ((values[0]<0) || (values[0]>9999))
+      goto Erreur_ERREUR_INI_CORROMPU;
+    conf->Animation_cache_size=values[0];
+  }
+
+  conf->Undo_memory=0;
+  // Optional, memory limit for the images and undo history (>=2.8)
+  if (!Load_INI_get_values (file,buffer,"Undo_memory",1,values))
+  {
+    if ((values[0]<0) || (values[0]>9999))
+      goto Erreur_ERREUR_INI_CORROMPU;
+    conf->Undo_memory=values[0];
+  }
+
+  conf->PNG_compression=0;
+  // Optional, speed/size trade-off when saving PNG files (>=2.8)
+  if (!Load_INI_get_values (file,buffer,"PNG_compression",1,values))
+  {
+    if ((values[0]<0) || (values[0]>2))
+      goto Erreur_ERREUR_INI_CORROMPU;
+    conf->PNG_compression=values[0];
+  }
   
   // Insert new values here
 
@@ -0,0 +1,154 @@
+/* vim:expandtab:ts=2 sw=2:
+*/
+/*  Grafx2 - The Ultimate 256-color bitmap paint program
+
+    Copyright 2026 GrafX2 contributors
+
+    Grafx2 is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; version 2
+    of the License.
+
+    Grafx2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Grafx2; if not, see <http://www.gnu.org/licenses/>
+*/
+
+///@file rle.c
+/// Run length encoding of memory buffers.
+
+#include <string.h>
+#include "rle.h"
+
+/// Write literal bytes to the packed stream
+/// @return the new output position, or -1 if there is not enough room
+static long RLE_pack_literals(byte * dest, long dest_size, long out, const byte * src, long count)
+{
+  while (count > 0)
+  {
+    long n = (count > 128) ? 128 : count;
+
+    if (out + 1 + n > dest_size)
+      return -1;
+    dest[out++] = (byte)(n - 1);
+    memcpy(dest + out, src, n);
+    out += n;
+    src += n;
+    count -= n;
+  }
+  return out;
+}
+
+long RLE_pack(byte * dest, long dest_size, const byte * src, long size)
+{
+  long in = 0;
+  long out = 0;
+  long literal_start = 0;
+
+  while (in < size)
+  {
+    byte value = src[in];
+    long run = 1;
+
+    while (in + run < size && src[in + run] == value)
+      run++;
+    if (run < 3)
+    {
+      // too short, keep it in the literals
+      in += run;
+      continue;
+    }
+    out = RLE_pack_literals(dest, dest_size, out, src + literal_start, in - literal_start);
+    if (out < 0)
+      return 0;
+    if (run <= 129)
+    {
+      if (out + 2 > dest_size)
+        return 0;
+      dest[out++] = (byte)(0x80 + run - 3);
+    }
+    else
+    {
+      if (out + 6 > dest_size)
+        return 0;
+      dest[out++] = 0xFF;
+      dest[out++] = (byte)run;
+      dest[out++] = (byte)(run >> 8);
+      dest[out++] = (byte)(run >> 16);
+      dest[out++] = (byte)(run >> 24);
+    }
+    dest[out++] = value;
+    in += run;
+    literal_start = in;
+  }
+  out = RLE_pack_literals(dest, dest_size, out, src + literal_start, size - literal_start);
+  return (out < 0) ? 0 : out;
+}
+
+/// Decode a packed stream, storing the bytes in dest or XORing them with it
+static int RLE_decode(byte * dest, long size, const byte * src, long packed_size, int xor_dest)
+{
+  long in = 0;
+  long out = 0;
+
+  while (in < packed_size)
+  {
+    byte c = src[in++];
+    long n;
+
+    if (c < 0x80)
+    {
+      n = c + 1;
+      if (in + n > packed_size || out + n > size)
+        return -1;
+      if (xor_dest)
+      {
+        long i;
+        for (i = 0; i < n; i++)
+          dest[out + i] ^= src[in + i];
+      }
+      else
+        memcpy(dest + out, src + in, n);
+      in += n;
+    }
+    else
+    {
+      if (c == 0xFF)
+      {
+        if (in + 4 > packed_size)
+          return -1;
+        n = (long)((dword)src[in] | ((dword)src[in+1] << 8) | ((dword)src[in+2] << 16) | ((dword)src[in+3] << 24));
+        in += 4;
+      }
+      else
+        n = c - 0x80 + 3;
+      if (in >= packed_size || n < 0 || out + n > size)
+        return -1;
+      if (!xor_dest)
+        memset(dest + out, src[in], n);
+      else if (src[in] != 0)
+      {
+        long i;
+        for (i = 0; i < n; i++)
+          dest[out + i] ^= src[in];
+      }
+      in++;
+    }
+    out += n;
+  }
+  return (out == size) ? 0 : -1;
+}
+
+int RLE_unpack(byte * dest, long size, const byte * src, long packed_size)
+{
+  return RLE_decode(dest, size, src, packed_size, 0);
+}
+
+int RLE_unpack_xor(byte * dest, long size, const byte * src, long packed_size)
+{
+  return RLE_decode(dest, size, src, packed_size, 1);
+}
@@ -0,0 +1,68 @@
+/* vim:expandtab:ts=2 sw=2:
+*/
+/*  Grafx2 - The Ultimate 256-color bitmap paint program
+
+    Copyright 2026 GrafX2 contributors
+
+    Grafx2 is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License
+    as published by the Free Software Foundation; version 2
+    of the License.
+
+    Grafx2 is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Grafx2; if not, see <http://www.gnu.org/licenses/>
+*/
+
+///@file rle.h
+/// Run length encoding of memory buffers.
+///
+/// Used to keep the pixels of old undo pages in less memory. The packed
+/// stream is a sequence of :
+/// - 0x00 to 0x7F : n+1 literal bytes follow
+/// - 0x80 to 0xFE : the next byte is repeated n-0x80+3 times
+/// - 0xFF : a 32 bits little endian count, then the byte to repeat
+
+#ifndef RLE_H_INCLUDED
+#define RLE_H_INCLUDED
+
+#include "struct.h"
+
+/**
+ * Pack a buffer.
+ *
+ * @param dest output buffer
+ * @param dest_size size of the output buffer
+ * @param src data to pack
+ * @param size size of the data to pack
+ * @return the size of the packed data, or 0 if it doesn't fit in dest_size bytes
+ */
+long RLE_pack(byte * dest, long dest_size, const byte * src, long size);
+
+/**
+ * Unpack a buffer packed with RLE_pack().
+ *
+ * @param dest output buffer
+ * @param size size of the unpacked data
+ * @param src packed data
+ * @param packed_size size of the packed data
+ * @return 0 for success, -1 if the packed data doesn't match size
+ */
+int RLE_unpack(byte * dest, long size, const byte * src, long packed_size);
+
+/**
+ * Unpack a buffer packed with RLE_pack(), XORing the result with the
+ * content of dest.
+ *
+ * Used to apply a difference between two buffers, packed as the XOR of
+ * both.
+ *
+ * @return 0 for success, -1 if the packed data doesn't match size
+ */
+int RLE_unpack_xor(byte * dest, long size, const byte * src, long packed_size);
+
+#endif
@@ -774,6 +774,22 @@ int Save_INI(const T_Config * conf)
   if ((return_code=Save_INI_set_values (old_file,new_file,buffer,"MOTO_gamma",1,values,0)))
     goto Erreur_Retour;
 
+  values[0]=conf->Optimize_GIF_animations;
+  if ((return_code=Save_INI_set_values (old_file,new_file,buffer,"Optimize_GIF_animations",1,values,1)))
+    goto Erreur_Retour;
+
+  values[0]=conf->Animation_cache_size;
+  if ((return_code=Save_INI_set_values (old_file,new_file,buffer,"Animation_cache_size",1,values,0)))
+    goto Erreur_Retour;
+
+  values[0]=conf->Undo_memory;
+  if ((return_code=Save_INI_set_values (old_file,new_file,buffer,"Undo_memory",1,values,0)))
+    goto Erreur_Retour;
+
+  values[0]=conf->PNG_compression;
+  if ((return_code=Save_INI_set_values (old_file,new_file,buffer,"PNG_compression",1,values,0)))
+    goto Erreur_Retour;
+
   // Insert new values here
   
   Save_INI_flush(old_file, new_file, buffer);
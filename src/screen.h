@@ -83,6 +83,12 @@ void * GFX2_Get_Window_Handle(void);
 int GFX2_Get_X11_Display_Window(Display * * display, Window * window);
 #endif
 
+#if defined(USE_X11)
+/// Returns true if the event is a MIT-SHM completion event, which is then
+/// handled. For the event loop in input.c.
+int X11_Shm_completion(const XEvent * event);
+#endif
+
 /// Set application icon(s)
 void Define_icon(void);
 
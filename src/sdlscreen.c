@@ -78,6 +78,10 @@ static SDL_Window * Window_SDL = NULL;
 static SDL_Renderer * Renderer_SDL = NULL;
 static SDL_Texture * Texture_SDL = NULL;
 static SDL_Surface * icon = NULL;
+/// Screen palette, already in the ARGB8888 format of Texture_SDL
+static Uint32 Palette_ARGB[256];
+/// Set when Texture_SDL was modified since it was last presented
+static int Texture_dirty = 0;
 #endif
 
 volatile int Allow_colorcycling=1;
@@ -167,6 +171,7 @@ void GFX2_Set_mode(int *width, int *height, int fullscreen)
   if (Texture_SDL != NULL)
     SDL_DestroyTexture(Texture_SDL);
   Texture_SDL = SDL_CreateTexture(Renderer_SDL, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, *width, *height);
+  Texture_dirty = 1;
   if (Screen_SDL != NULL)
     SDL_FreeSurface(Screen_SDL);
   Screen_SDL = SDL_CreateRGBSurface(0, *width, *height, 8, 0, 0, 0, 0);
@@ -191,52 +196,114 @@ void GFX2_Set_mode(int *width, int *height, int fullscreen)
 }
 
 #if defined(USE_SDL2)
+/// Converts a rectangle of the 8bit screen directly into the locked
+/// texture, through the ARGB palette.
 static void GFX2_UpdateRect(int x, int y, int width, int height)
 {
   byte * pixels;
   int pitch;
   int line;
-  static SDL_Surface *RGBcopy = NULL;
-  SDL_Rect source_rect;
-
-  source_rect.x = x;
-  source_rect.y = y;
-  if (width == 0 && height == 0) {
-    source_rect.w = Screen_SDL->w;
-    source_rect.h = Screen_SDL->h;
-  } else {
-    source_rect.w = width;
-    source_rect.h = height;
-  }
+  SDL_Rect rect;
 
-  if (RGBcopy != NULL && (Screen_SDL->w > RGBcopy->w || Screen_SDL->h > RGBcopy->h))
+  if (width == 0 && height == 0)
   {
-    SDL_FreeSurface(RGBcopy);
-    RGBcopy = NULL;
+    x = 0;
+    y = 0;
+    width = Screen_SDL->w;
+    height = Screen_SDL->h;
   }
-
-  if (RGBcopy == NULL)
+  // clip to the screen
+  if (x < 0)
+  {
+    width += x;
+    x = 0;
+  }
+  if (y < 0)
   {
-    RGBcopy = SDL_CreateRGBSurface(0,
-    Screen_SDL->w, Screen_SDL->h,
-    32, 0, 0, 0, 0);
+    height += y;
+    y = 0;
   }
-  // conversion ARGB
-  SDL_BlitSurface(Screen_SDL, &source_rect, RGBcopy, &source_rect);
-  // upload texture
-  SDL_LockTexture(Texture_SDL, &source_rect, (void **)(&pixels), &pitch );
-  for (line = 0; line < source_rect.h; line++)
+  if (x + width > Screen_SDL->w)
+    width = Screen_SDL->w - x;
+  if (y + height > Screen_SDL->h)
+    height = Screen_SDL->h - y;
+  if (width <= 0 || height <= 0)
+    return;
+
+  rect.x = x;
+  rect.y = y;
+  rect.w = width;
+  rect.h = height;
+  if (SDL_LockTexture(Texture_SDL, &rect, (void **)(&pixels), &pitch) < 0)
+    return;
+  for (line = 0; line < height; line++)
   {
-     memcpy(pixels + line * pitch, (const byte *)RGBcopy->pixels + source_rect.x * 4 + (source_rect.y+line)* RGBcopy->pitch, source_rect.w * 4 );
+    const byte * src = (const byte *)Screen_SDL->pixels + (y + line) * Screen_SDL->pitch + x;
+    Uint32 * dest = (Uint32 *)(pixels + line * pitch);
+    int i = width;
+
+    for (; i >= 4; i -= 4)
+    {
+      dest[0] = Palette_ARGB[src[0]];
+      dest[1] = Palette_ARGB[src[1]];
+      dest[2] = Palette_ARGB[src[2]];
+      dest[3] = Palette_ARGB[src[3]];
+      src += 4;
+      dest += 4;
+    }
+    for (; i > 0; i--)
+      *dest++ = Palette_ARGB[*src++];
   }
   SDL_UnlockTexture(Texture_SDL);
-  //SDL_RenderCopy(Renderer_SDL, Texture_SDL, &source_rect, &source_rect);
+  Texture_dirty = 1;
+}
+
+/// Converts again the smallest rectangle which contains all the pixels
+/// using a changed color.
+static void Refresh_palette_colors(const byte * changed)
+{
+  int x, y;
+  int min_x = Screen_SDL->w, max_x = -1;
+  int min_y = Screen_SDL->h, max_y = -1;
+
+  for (y = 0; y < Screen_SDL->h; y++)
+  {
+    const byte * src = (const byte *)Screen_SDL->pixels + y * Screen_SDL->pitch;
+    int line_min = -1;
+    int line_max = -1;
+
+    for (x = 0; x < Screen_SDL->w; x++)
+    {
+      if (changed[src[x]])
+      {
+        if (line_min < 0)
+          line_min = x;
+        line_max = x;
+      }
+    }
+    if (line_min >= 0)
+    {
+      if (line_min < min_x)
+        min_x = line_min;
+      if (line_max > max_x)
+        max_x = line_max;
+      if (min_y > y)
+        min_y = y;
+      max_y = y;
+    }
+  }
+  if (max_y >= 0)
+    GFX2_UpdateRect(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
 }
 
 void GFX2_UpdateScreen(void)
 {
+  // Nothing was drawn since the last frame
+  if (!Texture_dirty)
+    return;
   SDL_RenderCopy(Renderer_SDL, Texture_SDL, NULL, NULL);
   SDL_RenderPresent(Renderer_SDL);
+  Texture_dirty = 0;
 }
 #endif
 
@@ -485,11 +552,28 @@ int GFX2_SetPalette(const T_Components * colors, int firstcolor, int ncolors)
 #if defined(USE_SDL)
   return SDL_SetPalette(Screen_SDL, SDL_PHYSPAL | SDL_LOGPAL, PaletteSDL, firstcolor, ncolors);
 #else
-  // When using SDL2, we need to force screen update so the
-  // 8bit => True color conversion will be performed
-  i = SDL_SetPaletteColors(Screen_SDL->format->palette, PaletteSDL, firstcolor, ncolors);
-  if (i == 0)
-    Update_rect(0, 0, Screen_SDL->w, Screen_SDL->h);
+  {
+    byte changed[256];
+    int count = 0;
+
+    memset(changed, 0, sizeof(changed));
+    for (i = 0; i < ncolors; i++)
+    {
+      Uint32 value = 0xff000000 | ((Uint32)colors[i].R << 16)
+                   | ((Uint32)colors[i].G << 8) | (Uint32)colors[i].B;
+      if (Palette_ARGB[firstcolor + i] != value)
+      {
+        Palette_ARGB[firstcolor + i] = value;
+        changed[firstcolor + i] = 1;
+        count++;
+      }
+    }
+    i = SDL_SetPaletteColors(Screen_SDL->format->palette, PaletteSDL, firstcolor, ncolors);
+    // When using SDL2, the 8bit => True color conversion has to be done
+    // again, but only where the modified colors are used.
+    if (count > 0)
+      Refresh_palette_colors(changed);
+  }
   return i;
 #endif
 }
@@ -37,6 +37,7 @@
 #include "gfx2log.h"
 #include "gfx2mem.h"
 #include "packbits.h"
+#include "bitplanes.h"
 
 /**
  * @defgroup atarist Atari ST picture formats
@@ -69,26 +70,7 @@
  */
 static void PI1_8b_to_16p(const byte * src, byte * dest)
 {
-  int  i;           // index du pixel à calculer
-  word byte_mask;      // Masque de decodage
-  word w0,w1,w2,w3; // Les 4 words bien ordonnés de la source
-
-  byte_mask=0x8000;
-  w0=(((word)src[0])<<8) | src[1];
-  w1=(((word)src[2])<<8) | src[3];
-  w2=(((word)src[4])<<8) | src[5];
-  w3=(((word)src[6])<<8) | src[7];
-  for (i=0;i<16;i++)
-  {
-    // Pour décoder le pixel n°i, il faut traiter les 4 words sur leur bit
-    // correspondant à celui du masque
-
-    dest[i]=((w0 & byte_mask)?0x01:0x00) |
-           ((w1 & byte_mask)?0x02:0x00) |
-           ((w2 & byte_mask)?0x04:0x00) |
-           ((w3 & byte_mask)?0x08:0x00);
-    byte_mask>>=1;
-  }
+  Planar_to_chunky(src, dest, 16, 4, 2);
 }
 
 /**
@@ -100,18 +82,7 @@ static void PI1_8b_to_16p(const byte * src, byte * dest)
  */
 static void PI2_4b_to_16p(const byte * src, byte * dest)
 {
-  int  i;           // index du pixel à calculer
-  word mask;      // Masque de decodage
-  word w0,w1;
-
-  w0=(((word)src[0])<<8) | src[1];
-  w1=(((word)src[2])<<8) | src[3];
-  mask=0x8000;
-  for (i = 0; i < 16; i++)
-  {
-    dest[i] = ((w0 & mask) ? 0x01 : 0) | ((w1 & mask) ? 0x02 : 0);
-    mask >>= 1;
-  }
+  Planar_to_chunky(src, dest, 16, 2, 2);
 }
 
 /**
@@ -123,31 +94,7 @@ static void PI2_4b_to_16p(const byte * src, byte * dest)
  */
 static void PI1_16p_to_8b(const byte * src, byte * dest)
 {
-  int  i;           // index du pixel à calculer
-  word byte_mask;      // Masque de codage
-  word w0,w1,w2,w3; // Les 4 words bien ordonnés de la destination
-
-  byte_mask=0x8000;
-  w0=w1=w2=w3=0;
-  for (i=0;i<16;i++)
-  {
-    // Pour coder le pixel n°i, il faut modifier les 4 words sur leur bit
-    // correspondant à celui du masque
-
-    w0|=(src[i] & 0x01)?byte_mask:0x00;
-    w1|=(src[i] & 0x02)?byte_mask:0x00;
-    w2|=(src[i] & 0x04)?byte_mask:0x00;
-    w3|=(src[i] & 0x08)?byte_mask:0x00;
-    byte_mask>>=1;
-  }
-  dest[0]=w0 >> 8;
-  dest[1]=w0 & 0x00FF;
-  dest[2]=w1 >> 8;
-  dest[3]=w1 & 0x00FF;
-  dest[4]=w2 >> 8;
-  dest[5]=w2 & 0x00FF;
-  dest[6]=w3 >> 8;
-  dest[7]=w3 & 0x00FF;
+  Chunky_to_planar(src, dest, 16, 4, 2);
 }
 
 /**
@@ -386,10 +333,7 @@ void Load_PI1(T_IO_Context * context)
           ptr += 4;
           break;
         case 2:
-          for (i = 0; i < 8; i++)
-            pixels[i] = (ptr[0] & (0x80 >> i)) ? 1 : 0;
-          for (; i < 16; i++)
-            pixels[i] = (ptr[1] & (0x80 >> (i - 8))) ? 1 : 0;
+          Planar_to_chunky(ptr, pixels, 16, 1, 2);
           ptr += 2;
       }
       for (i = 0; i < 16; i++)
@@ -442,11 +386,8 @@ void Save_PI1(T_IO_Context * context)
           pixels[x_pos]=Get_pixel(context, x_pos,y_pos);
       }
 
-      for (x_pos=0;x_pos<(320>>4);x_pos++)
-      {
-        PI1_16p_to_8b(pixels+(x_pos<<4),ptr);
-        ptr+=8;
-      }
+      Chunky_to_planar(pixels, ptr, 320, 4, 2);
+      ptr+=160;
     }
 
     if (Write_bytes(file,buffer,32034))
@@ -480,88 +421,6 @@ void Save_PI1(T_IO_Context * context)
 
 //////////////////////////////////// PC1 ////////////////////////////////////
 
-/**
- * 4bpp planar to chunky conversion.
- * Converts 1 line (320 pixels) at a time.
- *
- * @param src0 40 bytes for plane 0
- * @param src1 40 bytes for plane 1
- * @param src2 40 bytes for plane 2
- * @param src3 40 bytes for plane 3
- * @param dest 320 bytes destination buffer
- */
-static void PC1_4bp_to_1line(const byte * src0, const byte * src1,
-                             const byte * src2, const byte * src3, byte * dest)
-{
-  int  i,j;         // Compteurs
-  int  ip;          // index du pixel à calculer
-  byte byte_mask;      // Masque de decodage
-  byte b0,b1,b2,b3; // Les 4 octets des plans bits sources
-
-  ip=0;
-  // Pour chacun des 40 octets des plans de bits
-  for (i=0;i<40;i++)
-  {
-    b0=src0[i];
-    b1=src1[i];
-    b2=src2[i];
-    b3=src3[i];
-    // Pour chacun des 8 bits des octets
-    byte_mask=0x80;
-    for (j=0;j<8;j++)
-    {
-      dest[ip++]=((b0 & byte_mask)?0x01:0x00) |
-                ((b1 & byte_mask)?0x02:0x00) |
-                ((b2 & byte_mask)?0x04:0x00) |
-                ((b3 & byte_mask)?0x08:0x00);
-      byte_mask>>=1;
-    }
-  }
-}
-
-// Transformation d'1 ligne de pixels en 4 plans de bits
-
-/**
- * Convert 1 line of 320 pixel from chunky to 4bpp planar.
- *
- * @param src 320 bytes buffer
- * @param dst0 40 bytes buffer for plane 0
- * @param dst1 40 bytes buffer for plane 1
- * @param dst2 40 bytes buffer for plane 2
- * @param dst3 40 bytes buffer for plane 3
- */
-static void PC1_1line_to_4bp(const byte * src,
-                             byte * dst0, byte * dst1,
-                             byte * dst2, byte * dst3)
-{
-  int  i,j;         // Compteurs
-  int  ip;          // index du pixel à calculer
-  byte byte_mask;      // Masque de decodage
-  byte b0,b1,b2,b3; // Les 4 octets des plans bits sources
-
-  ip=0;
-  // Pour chacun des 40 octets des plans de bits
-  for (i=0;i<40;i++)
-  {
-    // Pour chacun des 8 bits des octets
-    byte_mask=0x80;
-    b0=b1=b2=b3=0;
-    for (j=0;j<8;j++)
-    {
-      b0|=(src[ip] & 0x01)?byte_mask:0x00;
-      b1|=(src[ip] & 0x02)?byte_mask:0x00;
-      b2|=(src[ip] & 0x04)?byte_mask:0x00;
-      b3|=(src[ip] & 0x08)?byte_mask:0x00;
-      ip++;
-      byte_mask>>=1;
-    }
-    dst0[i]=b0;
-    dst1[i]=b1;
-    dst2[i]=b2;
-    dst3[i]=b3;
-  }
-}
-
 
 /// Test for Degas Elite Compressed format
 void Test_PC1(T_IO_Context * context, FILE * file)
@@ -667,30 +526,16 @@ void Load_PC1(T_IO_Context * context)
     switch (resolution)
     {
       case 0x8000:  // Low Res
-        PC1_4bp_to_1line(ptr,ptr+40,ptr+80,ptr+120,pixels);
+        Planar_to_chunky(ptr, pixels, 320, 4, 40);
         ptr+=160;
         break;
       case 0x8001:  // Med Res
-        x_pos = 0;
-        while (x_pos < width)
-        {
-          int i;
-          for (i = 7; i >= 0; i--, x_pos++)
-            pixels[x_pos] =  ((ptr[0] >> i) & 1)
-                            | (((ptr[80] >> i) << 1) & 2);
-          ptr++;
-        }
-        ptr += 80;
+        Planar_to_chunky(ptr, pixels, width, 2, 80);
+        ptr += 160;
         break;
       case 0x8002:  // High Res
-        x_pos = 0;
-        while (x_pos < width)
-        {
-          int i;
-          for (i = 7; i >= 0; i--)
-            pixels[x_pos++] = (*ptr >> i) & 1;
-          ptr++;
-        }
+        Planar_to_chunky(ptr, pixels, width, 1, 80);
+        ptr += 80;
     }
     for (x_pos=0;x_pos<width;x_pos++)
       Set_pixel(context, x_pos, y_pos, pixels[x_pos]);
@@ -748,7 +593,7 @@ void Save_PC1(T_IO_Context * context)
       }
 
       // Encodage de la scanline
-      PC1_1line_to_4bp(pixels,ptr,ptr+40,ptr+80,ptr+120);
+      Chunky_to_planar(pixels, ptr, 320, 4, 40);
       ptr+=160;
     }
 
@@ -974,10 +819,7 @@ void Load_NEO(T_IO_Context * context)
           ptr += 4;
           break;
         case 2:
-          for (i = 0; i < 8; i++)
-            pixels[i] = (ptr[0] & (0x80 >> i)) ? 1 : 0;
-          for (; i < 16; i++)
-            pixels[i] = (ptr[1] & (0x80 >> (i - 8))) ? 1 : 0;
+          Planar_to_chunky(ptr, pixels, 16, 1, 2);
           ptr += 2;
           break;
         default:
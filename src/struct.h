@@ -65,7 +65,7 @@ typedef void (* Func_pixel) (word,word,byte); ///< Set pixel at position (x,y) t
 typedef void (* Func_pixel_opt_preview) (word,word,byte,int); ///< Set pixel at position (x,y) to color c. With optional preview.
 typedef byte (* Func_read)   (word,word); ///< Read a pixel at position (x,y) on something. Used for example in save to tell if the data is a brush or a picture
 typedef void (* Func_clear)  (byte);
-typedef void (* Func_display)   (word,word,word);
+typedef void (* Func_display)   (word,word,word,word); ///< Draw the lines [y_start, y_end[ of the picture view: (width, y_start, y_end, image_width)
 typedef byte (* Func_effect)     (word,word,byte); ///< Called by all drawing tools to draw with a special effect (smooth, transparency, shade, ...)
 typedef void (* Func_block)     (word,word,word,word,byte);
 typedef void (* Func_line_XOR) (word,word,word); ///< Draw an XOR line on the picture view of the screen. Use a different function when in magnify mode.
@@ -74,7 +74,7 @@ typedef void (* Func_display_brush_mono)  (word,word,word,word,word,word,byte,by
 typedef void (* Func_gradient)   (long,short,short);
 typedef void (* Func_remap)     (word,word,word,word,byte *);
 typedef void (* Func_procsline) (word,word,word,byte *);
-typedef void (* Func_display_zoom) (word,word,word,byte *);
+typedef void (* Func_display_zoom) (word,word,word,word,byte *); ///< Draw the lines [y_start, y_end[ of the magnifier: (width, y_start, y_end, image_width, line buffer)
 typedef void (* Func_display_brush_color_zoom) (word,word,word,word,word,word,byte,word,byte *);
 typedef void (* Func_display_brush_mono_zoom)  (word,word,word,word,word,word,byte,byte,word,byte *);
 typedef void (* Func_draw_brush) (byte *,word,word,word,word,word,word,byte,word);
@@ -383,6 +383,10 @@ typedef struct
   byte Use_virtual_keyboard;             ///< 0: Auto, 1: On, 2: Off
   byte Default_mode_layers;              ///< Indicates if default new image has layers (alternative is animation)
   byte MOTO_gamma;                       ///< Number, 10 x the Gamma used for converting MO6/TO8/TO9 palette
+  byte Optimize_GIF_animations;          ///< Boolean, true to save unchanged pixels of GIF animation frames as transparent
+  word Animation_cache_size;             ///< Memory used to keep the displayed frames during animation playback, in MB
+  word Undo_memory;                      ///< Memory limit for the images and their undo history, in MB (0 for no limit)
+  byte PNG_compression;                  ///< zlib settings when saving PNG : 0 for default, 1 for fast, 2 for best
 
 } T_Config;
 
@@ -423,6 +427,7 @@ typedef struct T_Page
   byte      Background_transparent; ///< Boolean, true if Layer 0 should have transparent pixels
   byte      Transparent_color; ///< Index of transparent color. 0 to 255.
   int       Nb_layers; ///< Number of layers
+  dword     Serial;    ///< Creation order of the pages, to tell which step is the most recent
 #if __GNUC__ < 3
   // gcc2 doesn't suport [], but supports [0] which does the same thing.
   T_Image    Image[0];  ///< Pixel data for the (first layer of) image.
@@ -613,6 +618,8 @@ typedef struct
   long edits_since_safety_backup;
   /// SDL Time of the previous safety backup
   dword time_of_safety_backup;
+  /// True when a safety backup is due, it is written when the user is idle
+  byte safety_backup_pending;
   /// Letter prefix for the filenames of safety backups. a or b
   byte safety_backup_prefix;
   /// Tilemap mode
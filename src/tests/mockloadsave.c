@@ -26,6 +26,7 @@
 #include "../loadsave.h"
 #include "../global.h"
 #include "../gfx2log.h"
+#include "../gfx2mem.h"
 
 void Pre_load(T_IO_Context *context, short width, short height, long file_size, int format, enum PIXEL_RATIO ratio, byte bpp)
 {
@@ -33,12 +34,21 @@ void Pre_load(T_IO_Context *context, short width, short height, long file_size,
          context, width, height, file_size, format, ratio, bpp);
   context->Width = width;
   context->Height = height;
-  if (bpp > 8) {
+  if (bpp > 8 && context->Type != CONTEXT_SURFACE) {
     fprintf(stderr, "Truecolor not supported yet\n");
     File_error = 1;
   }
   if (context->Type == CONTEXT_SURFACE)
   {
+    // truecolor pictures are kept in Buffer_image_24b, without conversion
+    free(context->Buffer_image_24b);
+    context->Buffer_image_24b = NULL;
+    if (bpp > 8)
+    {
+      context->Buffer_image_24b = GFX2_malloc((long)width * height * sizeof(T_Components));
+      if (context->Buffer_image_24b == NULL)
+        File_error = 1;
+    }
     if (context->Surface)
       Free_GFX2_Surface(context->Surface);
     context->Surface = New_GFX2_Surface(width, height);
@@ -87,12 +97,16 @@ void Set_pixel(T_IO_Context *context, short x, short y, byte c)
 
 void Set_pixel_24b(T_IO_Context *context, short x, short y, byte r, byte g, byte b)
 {
-  (void)context;
-  (void)x;
-  (void)y;
-  (void)r;
-  (void)g;
-  (void)b;
+  T_Components * pixel;
+
+  if (context->Buffer_image_24b == NULL)
+    return;
+  if ((x < 0) || (x >= context->Width) || (y < 0) || (y >= context->Height))
+    return;
+  pixel = context->Buffer_image_24b + (long)y * context->Width + x;
+  pixel->R = r;
+  pixel->G = g;
+  pixel->B = b;
 }
 
 void Fill_canvas(T_IO_Context *context, byte color)
@@ -100,9 +114,17 @@ void Fill_canvas(T_IO_Context *context, byte color)
   printf("Fill_canvas(%p, %hhu)\n", context, color);
 }
 
+/// Layers of the picture saved by a test, NULL when it has only one
+T_GFX2_Surface ** Mock_saving_layers = NULL;
+
 void Set_saving_layer(T_IO_Context *context, int layer)
 {
   printf("Set_saving_layer(%p, %d)\n", context, layer);
+  if (Mock_saving_layers != NULL)
+  {
+    context->Target_address = Mock_saving_layers[layer]->pixels;
+    context->Pitch = Mock_saving_layers[layer]->w;
+  }
 }
 
 void Set_loading_layer(T_IO_Context *context, int layer)
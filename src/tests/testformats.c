@@ -32,10 +32,14 @@
 #include <unistd.h>
 #include "../global.h"
 #include "../fileformats.h"
+#include "../io.h"
 #include "../gfx2log.h"
 #include "../gfx2mem.h"
 #include "tests.h"
 
+// see mockloadsave.c
+extern T_GFX2_Surface ** Mock_saving_layers;
+
 // Load_IFF/Save_IFF does for both LBM and PBM (and Load_IFF also loads ACBM format)
 #define Load_ACBM Load_IFF
 #define Load_LBM Load_IFF
@@ -395,6 +399,342 @@ ret:
   return ok;
 }
 
+/**
+ * Test Save_IFF() in HAM6 and HAM8 modes
+ *
+ * The test picture only uses the first 16 colors of the palette, so the
+ * HAM pictures reload without any loss.
+ */
+int Test_Save_HAM(char * errmsg)
+{
+  T_IO_Context context;
+  char path[256];
+  int ok = 0;
+  int ham;
+  long i;
+  word x, y;
+  T_GFX2_Surface * testpic16 = NULL;
+
+  memset(&context, 0, sizeof(context));
+  context.Type = CONTEXT_SURFACE;
+  context.Nb_layers = 1;
+  // build the test picture : 16 colors with 12 bits components, like
+  // the HAM6 base colors, in bands and runs of different lengths
+  testpic16 = New_GFX2_Surface(96, 64);
+  if (testpic16 == NULL)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "Failed to allocate the test picture");
+    goto ret;
+  }
+  memset(testpic16->palette, 0, sizeof(T_Palette));
+  for (i = 0; i < 16; i++)
+  {
+    testpic16->palette[i].R = (byte)(i * 0x11);
+    testpic16->palette[i].G = (byte)((15 - i) * 0x11);
+    testpic16->palette[i].B = (byte)(((i * 5) & 15) * 0x11);
+  }
+  for (y = 0; y < testpic16->h; y++)
+    for (x = 0; x < testpic16->w; x++)
+      testpic16->pixels[y * testpic16->w + x] = (byte)(((x / (1 + y % 5)) + (y / 8)) & 15);
+
+  ok = 1;
+  for (ham = 6; ok && ham <= 8; ham += 2)
+  {
+    snprintf(path, sizeof(path), "%s/test.ham%d", tmpdir, ham);
+    context_set_file_path(&context, path);
+    context.Surface = testpic16;
+    context.Target_address = testpic16->pixels;
+    context.Pitch = testpic16->w;
+    context.Width = testpic16->w;
+    context.Height = testpic16->h;
+    context.Ratio = PIXEL_SIMPLE;
+    memcpy(context.Palette, testpic16->palette, sizeof(T_Palette));
+    context.Format = FORMAT_LBM;
+    File_error = 0;
+    Save_IFF(&context);
+    context.Surface = NULL;
+    if (File_error != 0)
+    {
+      snprintf(errmsg, ERRMSG_LENGTH, "Save_IFF failed for HAM%d", ham);
+      ok = 0;
+      break;
+    }
+    memset(context.Palette, -1, sizeof(T_Palette));
+    Load_IFF(&context);
+    if (File_error != 0 || context.Buffer_image_24b == NULL)
+    {
+      snprintf(errmsg, ERRMSG_LENGTH, "Load_IFF failed for file %s", path);
+      ok = 0;
+      break;
+    }
+    if (context.Width != testpic16->w || context.Height != testpic16->h)
+    {
+      snprintf(errmsg, ERRMSG_LENGTH, "Saved %hux%hu, reloaded %hux%hu from %s",
+               testpic16->w, testpic16->h, context.Width, context.Height, path);
+      ok = 0;
+    }
+    // HAM pictures are reloaded as truecolor
+    for (i = 0; ok && i < (long)testpic16->w * testpic16->h; i++)
+    {
+      const T_Components * c1 = testpic16->palette + testpic16->pixels[i];
+      const T_Components * c2 = context.Buffer_image_24b + i;
+      if (c1->R != c2->R || c1->G != c2->G || c1->B != c2->B)
+      {
+        snprintf(errmsg, ERRMSG_LENGTH, "HAM%d: pixel %ld is %02x%02x%02x instead of %02x%02x%02x",
+                 ham, i, c2->R, c2->G, c2->B, c1->R, c1->G, c1->B);
+        ok = 0;
+      }
+    }
+    Free_GFX2_Surface(context.Surface);
+    context.Surface = NULL;
+    free(context.Buffer_image_24b);
+    context.Buffer_image_24b = NULL;
+    if (ok && unlink(path) < 0)
+      perror("unlink");
+  }
+ret:
+  if (testpic16)
+    Free_GFX2_Surface(testpic16);
+  free(context.File_name);
+  free(context.File_directory);
+  return ok;
+}
+
+/**
+ * Build a 256 colors test picture : bands on the left half, noise on
+ * the right half, so the LZW alphabet of the GIF encoder fills up.
+ */
+static T_GFX2_Surface * New_test_picture_256(word width, word height)
+{
+  T_GFX2_Surface * surface;
+  dword seed = 1;
+  word x, y;
+  int i;
+
+  surface = New_GFX2_Surface(width, height);
+  if (surface == NULL)
+    return NULL;
+  for (i = 0; i < 256; i++)
+  {
+    surface->palette[i].R = (byte)i;
+    surface->palette[i].G = (byte)(255 - i);
+    surface->palette[i].B = (byte)(i * 7);
+  }
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+    {
+      seed = seed * 1103515245 + 12345;
+      if (x < width / 2)
+        surface->pixels[y * width + x] = (byte)((x / 8 + y / 8) * 9);
+      else
+        surface->pixels[y * width + x] = (byte)(seed >> 16);
+    }
+  return surface;
+}
+
+/**
+ * Test the saving of a GIF with several layers
+ *
+ * Save_GIF() compresses the layers on several threads, the file must be
+ * the same as the one written layer after layer by Save_GIF_step().
+ */
+int Test_Save_GIF_layers(char * errmsg)
+{
+  T_IO_Context context;
+  T_GFX2_Surface * layers[4];
+  char path[256];
+  char path_step[256];
+  T_GIF_writer * writer;
+  FILE * f1 = NULL;
+  FILE * f2 = NULL;
+  int i;
+  int ok = 0;
+  long x, y;
+
+  memset(layers, 0, sizeof(layers));
+  memset(&context, 0, sizeof(context));
+  context.Type = CONTEXT_SURFACE;
+  layers[0] = New_test_picture_256(320, 256);
+  if (layers[0] == NULL)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "Failed to build the test picture");
+    goto ret;
+  }
+  memcpy(context.Palette, layers[0]->palette, sizeof(T_Palette));
+  // each layer changes a different area of the previous one
+  for (i = 1; i < 4; i++)
+  {
+    layers[i] = New_GFX2_Surface(layers[0]->w, layers[0]->h);
+    if (layers[i] == NULL)
+    {
+      snprintf(errmsg, ERRMSG_LENGTH, "Failed to allocate layer %d", i);
+      goto ret;
+    }
+    memcpy(layers[i]->pixels, layers[i-1]->pixels, (size_t)layers[0]->w * layers[0]->h);
+    for (y = i * 10; y < layers[0]->h / 2 + i * 10; y++)
+      for (x = i * 20; x < layers[0]->w / 2 + i * 20 && x < layers[0]->w; x++)
+        layers[i]->pixels[y * layers[0]->w + x] ^= (byte)(i * 37);
+  }
+
+  Mock_saving_layers = layers;
+  context.Nb_layers = 4;
+  context.Width = layers[0]->w;
+  context.Height = layers[0]->h;
+  context.Format = FORMAT_GIF;
+  snprintf(path, sizeof(path), "%s/layers.gif", tmpdir);
+  context_set_file_path(&context, path);
+  Save_GIF(&context);
+  if (File_error != 0)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "Save_GIF failed for %s", path);
+    goto ret;
+  }
+  snprintf(path_step, sizeof(path_step), "%s/layers_step.gif", tmpdir);
+  context_set_file_path(&context, path_step);
+  writer = Save_GIF_start(&context);
+  if (writer == NULL)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "Save_GIF_start failed for %s", path_step);
+    goto ret;
+  }
+  while (!Save_GIF_step(writer, 1000))
+    ;
+  Save_GIF_end(writer);
+  if (File_error != 0)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "Save_GIF_step failed for %s", path_step);
+    goto ret;
+  }
+
+  f1 = fopen(path, "rb");
+  f2 = fopen(path_step, "rb");
+  if (f1 == NULL || f2 == NULL)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "Failed to open %s or %s", path, path_step);
+    goto ret;
+  }
+  ok = 1;
+  for (x = 0; ok; x++)
+  {
+    int c1 = fgetc(f1);
+    int c2 = fgetc(f2);
+    if (c1 != c2)
+    {
+      snprintf(errmsg, ERRMSG_LENGTH, "%s and %s differ at offset %ld", path, path_step, x);
+      ok = 0;
+    }
+    else if (c1 == EOF)
+      break;
+  }
+  if (ok)
+  {
+    unlink(path);
+    unlink(path_step);
+  }
+ret:
+  Mock_saving_layers = NULL;
+  if (f1 != NULL)
+    fclose(f1);
+  if (f2 != NULL)
+    fclose(f2);
+  for (i = 0; i < 4; i++)
+    if (layers[i] != NULL)
+      Free_GFX2_Surface(layers[i]);
+  free(context.File_name);
+  free(context.File_directory);
+  return ok;
+}
+
+/**
+ * Test the saving to memory and the loading from memory
+ */
+int Test_Save_to_memory(char * errmsg)
+{
+  T_IO_Context context;
+  char path[256];
+  char * data = NULL;
+  size_t size = 0;
+  int ok = 0;
+  long i;
+  T_GFX2_Surface * testpic256 = NULL;
+
+  memset(&context, 0, sizeof(context));
+  context.Type = CONTEXT_SURFACE;
+  context.Nb_layers = 1;
+  testpic256 = New_test_picture_256(320, 256);
+  if (testpic256 == NULL)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "Failed to build the test picture");
+    goto ret;
+  }
+  memcpy(context.Palette, testpic256->palette, sizeof(T_Palette));
+
+  // the file name is kept, but nothing is written on the disk
+  snprintf(path, sizeof(path), "%s/memory.gif", tmpdir);
+  context_set_file_path(&context, path);
+  context.Target_address = testpic256->pixels;
+  context.Pitch = testpic256->w;
+  context.Width = testpic256->w;
+  context.Height = testpic256->h;
+  context.Format = FORMAT_GIF;
+  context.Memory_output = &data;
+  context.Memory_output_size = &size;
+  Save_GIF(&context);
+  context.Memory_output = NULL;
+  context.Memory_output_size = NULL;
+  if (File_error != 0 || data == NULL || size == 0)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "Save_GIF to memory failed");
+    goto ret;
+  }
+  if (File_exists(path))
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "Save_GIF to memory wrote %s", path);
+    goto ret;
+  }
+
+  memset(context.Palette, -1, sizeof(T_Palette));
+  context.Memory_data = data;
+  context.Memory_size = size;
+  Load_GIF(&context);
+  context.Memory_data = NULL;
+  if (File_error != 0 || context.Surface == NULL)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "Load_GIF from memory failed (%lu bytes)", (unsigned long)size);
+    goto ret;
+  }
+  if (context.Surface->w != testpic256->w || context.Surface->h != testpic256->h)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "Saved %hux%hu, reloaded %hux%hu from memory",
+             testpic256->w, testpic256->h, context.Surface->w, context.Surface->h);
+    goto ret;
+  }
+  ok = 1;
+  for (i = 0; ok && i < (long)testpic256->w * testpic256->h; i++)
+  {
+    if (context.Surface->pixels[i] != testpic256->pixels[i])
+    {
+      snprintf(errmsg, ERRMSG_LENGTH, "pixel %ld is %u instead of %u",
+               i, context.Surface->pixels[i], testpic256->pixels[i]);
+      ok = 0;
+    }
+  }
+  if (ok && memcmp(context.Palette, testpic256->palette, sizeof(T_Palette)) != 0)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "palette differs after reload from memory");
+    ok = 0;
+  }
+ret:
+  free(data);
+  if (context.Surface)
+    Free_GFX2_Surface(context.Surface);
+  if (testpic256)
+    Free_GFX2_Surface(testpic256);
+  free(context.File_name);
+  free(context.File_directory);
+  return ok;
+}
+
 int Test_C64_Formats(char * errmsg)
 {
   int i, j;
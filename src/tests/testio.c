@@ -224,6 +224,125 @@ int Test_Read_Write_bytes(char * errmsg)
   return 1;
 }
 
+int Test_Memory_buffer(char * errmsg)
+{
+  T_Memory_buffer buffer;
+  FILE * f;
+  dword dw = 0;
+  unsigned long i;
+  byte b;
+
+  memset(&buffer, 0, sizeof(buffer));
+  // lots of small writes
+  for (i = 0; i < 100000; i++)
+  {
+    b = (byte)i;
+    if (!Memory_write(&buffer, &b, 1))
+    {
+      snprintf(errmsg, ERRMSG_LENGTH, "Memory_write() failed at offset %lu", i);
+      free(buffer.Data);
+      return 0;
+    }
+  }
+  // seek past the end, then write : the gap is filled with zeros
+  if (!Memory_seek(&buffer, 100010) || !Memory_write(&buffer, "\x12\x34\x56\x78", 4))
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "Memory_seek() / Memory_write() failed");
+    free(buffer.Data);
+    return 0;
+  }
+  if (buffer.Size != 100014 || buffer.Alloc_size < buffer.Size)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "bad size %lu (allocated %lu)", buffer.Size, buffer.Alloc_size);
+    free(buffer.Data);
+    return 0;
+  }
+  for (i = 0; i < 100000; i++)
+  {
+    if (buffer.Data[i] != (byte)i)
+    {
+      snprintf(errmsg, ERRMSG_LENGTH, "data mismatch at offset %lu", i);
+      free(buffer.Data);
+      return 0;
+    }
+  }
+  for (; i < 100010; i++)
+  {
+    if (buffer.Data[i] != 0)
+    {
+      snprintf(errmsg, ERRMSG_LENGTH, "gap not filled with 0 at offset %lu", i);
+      free(buffer.Data);
+      return 0;
+    }
+  }
+  // read it back as a FILE
+  f = Open_memory_read(buffer.Data, buffer.Size);
+  if (f == NULL)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "Open_memory_read() failed");
+    free(buffer.Data);
+    return 0;
+  }
+  if (File_length_file(f) != buffer.Size)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "File_length_file() = %lu, expected %lu", File_length_file(f), buffer.Size);
+    fclose(f);
+    free(buffer.Data);
+    return 0;
+  }
+  if (fseek(f, 100010, SEEK_SET) < 0 || !Read_dword_le(f, &dw) || dw != 0x78563412)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "read back failed : %08x", (unsigned)dw);
+    fclose(f);
+    free(buffer.Data);
+    return 0;
+  }
+  fclose(f);
+  free(buffer.Data);
+  return 1;
+}
+
+/**
+ * Test GFX2_malloc_large() for a small buffer and for one big enough for
+ * a scratch file
+ */
+int Test_Malloc_large(char * errmsg)
+{
+  static const size_t sizes[] = { 1000, GFX2_SCRATCH_MIN_SIZE };
+  unsigned int i;
+  size_t j;
+  byte * p;
+
+  GFX2_set_scratch_directory(tmpdir);
+  for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+  {
+    p = GFX2_malloc_large(sizes[i]);
+    if (p == NULL)
+    {
+      snprintf(errmsg, ERRMSG_LENGTH, "GFX2_malloc_large(%lu) failed", (unsigned long)sizes[i]);
+      GFX2_set_scratch_directory(NULL);
+      return 0;
+    }
+    for (j = 0; j < sizes[i]; j += 997)
+      p[j] = (byte)j;
+    p[sizes[i] - 1] = 42;
+    for (j = 0; j < sizes[i] - 1; j += 997)
+    {
+      if (p[j] != (byte)j)
+      {
+        snprintf(errmsg, ERRMSG_LENGTH, "GFX2_malloc_large(%lu) : bad byte at %lu",
+                 (unsigned long)sizes[i], (unsigned long)j);
+        GFX2_free_large(p);
+        GFX2_set_scratch_directory(NULL);
+        return 0;
+      }
+    }
+    GFX2_free_large(p);
+  }
+  GFX2_set_scratch_directory(NULL);
+  return 1;
+}
+
 /**
  * data structure for For_each_directory_entry() callback
  */
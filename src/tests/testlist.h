@@ -5,6 +5,8 @@ TEST(Read_Write_byte)
 TEST(Read_Write_word)
 TEST(Read_Write_dword)
 TEST(Read_Write_bytes)
+TEST(Memory_buffer)
+TEST(Malloc_large)
 TEST(Realpath)
 TEST(File_exists)
 TEST(Calculate_relative_path)
@@ -12,8 +14,16 @@ TEST(Calculate_relative_path)
 TEST(MOTO_MAP_pack)
 TEST(CPC_compare_colors)
 TEST(Packbits)
+TEST(RLE)
+TEST(Bitplanes)
+TEST(HAM)
+TEST(Overview)
+TEST(Constrained_conversion)
 TEST(Convert_24b_bitmap_to_256)
 TEST(Formats)
 TEST(Load)
 TEST(Save)
+TEST(Save_HAM)
+TEST(Save_GIF_layers)
+TEST(Save_to_memory)
 TEST(C64_Formats)
@@ -35,6 +35,11 @@
 #include "../struct.h"
 #include "../oldies.h"
 #include "../packbits.h"
+#include "../rle.h"
+#include "../bitplanes.h"
+#include "../ham.h"
+#include "../overview.h"
+#include "../bitcount.h"
 #include "../io.h"
 #include "../gfx2log.h"
 
@@ -252,3 +257,531 @@ int Test_Packbits(char * errmsg)
   unlink(tempfilename);
   return 1; // test OK
 }
+
+/**
+ * Tests for Planar_to_chunky() and Chunky_to_planar()
+ *
+ * Results are compared with a simple bit by bit conversion.
+ */
+/**
+ * Tests for the RLE packing of memory buffers
+ */
+int Test_RLE(char * errmsg)
+{
+  static const long sizes[] = { 1, 2, 3, 130, 131, 70000, 100000 };
+  const long max_size = 100000;
+  byte * src;
+  byte * packed;
+  byte * unpacked;
+  long packed_size;
+  unsigned int i, pass;
+  long j;
+  int ok = 0;
+
+  src = malloc(max_size);
+  packed = malloc(max_size * 2);
+  unpacked = malloc(max_size);
+  if (src == NULL || packed == NULL || unpacked == NULL)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "memory allocation failed");
+    goto cleanup;
+  }
+  for (pass = 0; pass < 4; pass++)
+  {
+    for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++)
+    {
+      long size = sizes[i];
+
+      for (j = 0; j < size; j++)
+      {
+        switch (pass)
+        {
+          case 0: // random
+            src[j] = (byte)random();
+            break;
+          case 1: // single run
+            src[j] = 42;
+            break;
+          case 2: // short runs mixed with literals
+            src[j] = (byte)((j % 7) < 3 ? 5 : j);
+            break;
+          default: // long runs with a few isolated bytes
+            src[j] = (byte)((j % 1000) == 999 ? j : j / 66000);
+        }
+      }
+      packed_size = RLE_pack(packed, max_size * 2, src, size);
+      if (packed_size <= 0)
+      {
+        snprintf(errmsg, ERRMSG_LENGTH, "RLE_pack() failed for pass %u, size %ld", pass, size);
+        goto cleanup;
+      }
+      if (pass == 1 && packed_size > 6)
+      {
+        snprintf(errmsg, ERRMSG_LENGTH, "a run of %ld bytes was packed in %ld bytes", size, packed_size);
+        goto cleanup;
+      }
+      memset(unpacked, 0xAA, size);
+      if (RLE_unpack(unpacked, size, packed, packed_size) != 0
+          || memcmp(unpacked, src, size) != 0)
+      {
+        snprintf(errmsg, ERRMSG_LENGTH, "RLE round trip failed for pass %u, size %ld", pass, size);
+        goto cleanup;
+      }
+      // the unpacked size must match exactly
+      if (RLE_unpack(unpacked, size - 1, packed, packed_size) == 0)
+      {
+        snprintf(errmsg, ERRMSG_LENGTH, "RLE_unpack() accepted a smaller output for pass %u, size %ld", pass, size);
+        goto cleanup;
+      }
+    }
+  }
+  // difference between two buffers, packed as their XOR
+  for (j = 0; j < max_size; j++)
+  {
+    src[j] = (byte)random();
+    unpacked[j] = (j >= 5000 && j < 5100) ? (byte)random() : src[j];
+    packed[max_size + j] = src[j] ^ unpacked[j];
+  }
+  packed_size = RLE_pack(packed, max_size, packed + max_size, max_size);
+  if (packed_size <= 0 || packed_size > 200
+      || RLE_unpack_xor(unpacked, max_size, packed, packed_size) != 0
+      || memcmp(unpacked, src, max_size) != 0)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "RLE_unpack_xor() failed (packed size %ld)", packed_size);
+    goto cleanup;
+  }
+  // random data doesn't fit in less than its size
+  if (RLE_pack(packed, max_size / 2, src, max_size) != 0)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "RLE_pack() didn't detect the output buffer overflow");
+    goto cleanup;
+  }
+  ok = 1;
+
+cleanup:
+  free(src);
+  free(packed);
+  free(unpacked);
+  return ok;
+}
+
+int Test_Bitplanes(char * errmsg)
+{
+  static const int widths[] = { 1, 7, 8, 15, 16, 17, 33, 320, 0 };
+  static const int interleaves[] = { 1, 2, 5, 40, 0 };
+  byte chunky[336];
+  byte chunky2[336];
+  byte planar[320];
+  byte planar2[320];
+  int w, il, nb_planes, i, n, p;
+
+  for (w = 0; widths[w]; w++)
+  {
+    int width = widths[w];
+    int plane_bytes = (width + 7) / 8;
+    for (il = 0; interleaves[il]; il++)
+    {
+      int interleave = interleaves[il];
+      if (interleave > 1 && plane_bytes % interleave != 0)
+        continue;
+      for (nb_planes = 1; nb_planes <= 8; nb_planes++)
+      {
+        // reference chunky to planar
+        for (i = 0; i < width; i++)
+          chunky[i] = (byte)random();
+        memset(planar, 0, sizeof(planar));
+        for (i = 0; i < width; i++)
+        {
+          n = i >> 3;
+          for (p = 0; p < nb_planes; p++)
+          {
+            if (chunky[i] & (1 << p))
+              planar[(n / interleave) * interleave * nb_planes + p * interleave + (n % interleave)] |= 0x80 >> (i & 7);
+          }
+        }
+        memset(planar2, 0, sizeof(planar2));
+        Chunky_to_planar(chunky, planar2, width, nb_planes, interleave);
+        if (memcmp(planar, planar2, plane_bytes * nb_planes) != 0)
+        {
+          GFX2_LogHexDump(GFX2_ERROR, "expected ", planar, 0, plane_bytes * nb_planes);
+          GFX2_LogHexDump(GFX2_ERROR, "result   ", planar2, 0, plane_bytes * nb_planes);
+          snprintf(errmsg, ERRMSG_LENGTH, "Chunky_to_planar() failed for width=%d planes=%d interleave=%d",
+                   width, nb_planes, interleave);
+          return 0;
+        }
+        // planar to chunky should give back the pixels
+        memset(chunky2, 0xff, sizeof(chunky2));
+        Planar_to_chunky(planar, chunky2, width, nb_planes, interleave);
+        for (i = 0; i < width; i++)
+        {
+          if (chunky2[i] != (chunky[i] & ((1 << nb_planes) - 1)))
+          {
+            snprintf(errmsg, ERRMSG_LENGTH, "Planar_to_chunky() failed for width=%d planes=%d interleave=%d pixel %d",
+                     width, nb_planes, interleave, i);
+            return 0;
+          }
+        }
+        if (chunky2[width] != 0xff)
+        {
+          snprintf(errmsg, ERRMSG_LENGTH, "Planar_to_chunky() wrote past width=%d", width);
+          return 0;
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+/**
+ * Tests for HAM_Decode() and HAM_Encode_line()
+ */
+int Test_HAM(char * errmsg)
+{
+  static const byte bitplanes_list[2] = { 6, 8 };
+  T_Components palette[64];
+  T_HAM_encoder encoder;
+  dword base[64];
+  dword line[320];
+  dword decoded[320];
+  byte codes[320];
+  int i, b;
+
+  for (i = 0; i < 64; i++)
+  {
+    palette[i].R = (byte)((random() & 15) * 0x11);
+    palette[i].G = (byte)((random() & 15) * 0x11);
+    palette[i].B = (byte)((random() & 15) * 0x11);
+  }
+  HAM_Pack_palette(base, palette, 64);
+
+  for (b = 0; b < 2; b++)
+  {
+    byte bitplanes = bitplanes_list[b];
+    int base_count = 1 << (bitplanes - 2);
+
+    // each control code, compared with the description of the format
+    for (i = 0; i < (1 << bitplanes); i++)
+    {
+      byte code = (byte)i;
+      dword expected, result;
+      int op = code >> (bitplanes - 2);
+      int value = code & (base_count - 1);
+
+      if (bitplanes == 6)
+        value *= 0x11;
+      else
+        value = (value << 2) | (value >> 4);
+      switch (op)
+      {
+        case 1: expected = 0x123400 | value; break;
+        case 2: expected = 0x003456 | (value << 16); break;
+        case 3: expected = 0x120056 | (value << 8); break;
+        default: expected = base[code];
+      }
+      result = HAM_Decode(&code, decoded, 1, bitplanes, base, 0x123456);
+      if (result != expected || decoded[0] != expected)
+      {
+        snprintf(errmsg, ERRMSG_LENGTH, "HAM%d code %02x : %06x instead of %06x",
+                 bitplanes, code, (unsigned)result, (unsigned)expected);
+        return 0;
+      }
+    }
+
+    // a line using only colors reachable from the previous pixel
+    // should be encoded without any loss
+    HAM_Encoder_init(&encoder, palette, bitplanes);
+    line[0] = base[random() % base_count];
+    for (i = 1; i < 320; i++)
+    {
+      int level = (int)(random() % base_count);
+      int value = (bitplanes == 6) ? level * 0x11 : ((level << 2) | (level >> 4));
+      switch (random() & 3)
+      {
+        case 0: line[i] = base[random() % base_count]; break;
+        case 1: line[i] = (line[i-1] & 0xFFFF00) | value; break;
+        case 2: line[i] = (line[i-1] & 0x00FFFF) | (value << 16); break;
+        default: line[i] = (line[i-1] & 0xFF00FF) | (value << 8);
+      }
+    }
+    HAM_Encode_line(&encoder, line, codes, 320);
+    // decoding in 2 spans
+    HAM_Decode(codes + 100, decoded + 100, 220, bitplanes, base,
+               HAM_Decode(codes, decoded, 100, bitplanes, base, base[0]));
+    for (i = 0; i < 320; i++)
+    {
+      if (decoded[i] != line[i])
+      {
+        snprintf(errmsg, ERRMSG_LENGTH, "HAM%d encoding pixel %d : %06x instead of %06x",
+                 bitplanes, i, (unsigned)decoded[i], (unsigned)line[i]);
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/// Reference reduction of a picture : each pixel is the most frequent
+/// color of its 2x2 block, the first one in reading order for a tie.
+static void Overview_reference(const byte * src, int width, int height, byte * dest)
+{
+  int x, y, i, j;
+
+  for (y = 0; y < (height + 1) / 2; y++)
+  {
+    for (x = 0; x < (width + 1) / 2; x++)
+    {
+      byte block[4];
+      int best = 0, best_count = 0;
+      int x1 = (2 * x + 1 < width) ? 2 * x + 1 : 2 * x;
+      int y1 = (2 * y + 1 < height) ? 2 * y + 1 : 2 * y;
+
+      block[0] = src[2 * y * width + 2 * x];
+      block[1] = src[2 * y * width + x1];
+      block[2] = src[y1 * width + 2 * x];
+      block[3] = src[y1 * width + x1];
+      for (i = 0; i < 4; i++)
+      {
+        int count = 0;
+        for (j = 0; j < 4; j++)
+          if (block[j] == block[i])
+            count++;
+        if (count > best_count)
+        {
+          best = i;
+          best_count = count;
+        }
+      }
+      dest[y * ((width + 1) / 2) + x] = block[best];
+    }
+  }
+}
+
+/// Compare all levels of the overview pyramid to the reference
+static int Overview_check(const byte * image, int width, int height, char * errmsg)
+{
+  byte * ref;
+  byte * ref2;
+  int level, w, h;
+  int ok = 1;
+
+  ref = malloc(width * height);
+  ref2 = malloc(width * height);
+  if (ref == NULL || ref2 == NULL)
+  {
+    free(ref);
+    free(ref2);
+    snprintf(errmsg, ERRMSG_LENGTH, "memory allocation failed");
+    return 0;
+  }
+  memcpy(ref, image, width * height);
+  w = width;
+  h = height;
+  for (level = 1; ok && level <= Overview_level_for_size(width, height, 1, 1); level++)
+  {
+    const byte * pixels;
+    word level_width, level_height;
+    byte * tmp;
+
+    Overview_reference(ref, w, h, ref2);
+    w = (w + 1) / 2;
+    h = (h + 1) / 2;
+    pixels = Overview_get_level(image, width, height, level, &level_width, &level_height);
+    if (pixels == NULL || level_width != w || level_height != h)
+    {
+      snprintf(errmsg, ERRMSG_LENGTH, "%dx%d level %d : bad size", width, height, level);
+      ok = 0;
+    }
+    else if (memcmp(pixels, ref2, w * h) != 0)
+    {
+      snprintf(errmsg, ERRMSG_LENGTH, "%dx%d level %d : pixels differ", width, height, level);
+      ok = 0;
+    }
+    tmp = ref;
+    ref = ref2;
+    ref2 = tmp;
+  }
+  free(ref);
+  free(ref2);
+  return ok;
+}
+
+/**
+ * Tests for the reduced pictures of the overview window
+ */
+int Test_Overview(char * errmsg)
+{
+  static const word sizes[][2] = { { 1, 1 }, { 2, 1 }, { 5, 3 }, { 37, 21 }, { 64, 64 }, { 320, 200 } };
+  byte * image;
+  unsigned int i;
+  int pass, x, y;
+  int ok = 1;
+
+  if (Overview_level_for_size(320, 200, 256, 128) != 1
+   || Overview_level_for_size(256, 128, 256, 128) != 0
+   || Overview_level_for_size(1024, 100, 256, 128) != 2)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "Overview_level_for_size() failed");
+    return 0;
+  }
+  image = malloc(320 * 200);
+  if (image == NULL)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "memory allocation failed");
+    return 0;
+  }
+  for (i = 0; ok && i < sizeof(sizes)/sizeof(sizes[0]); i++)
+  {
+    int width = sizes[i][0];
+    int height = sizes[i][1];
+
+    // few colors, so blocks often have a dominant one
+    for (x = 0; x < width * height; x++)
+      image[x] = (byte)(random() & 3);
+    ok = Overview_check(image, width, height, errmsg);
+    // modify some areas, only those are computed again
+    for (pass = 0; ok && pass < 8; pass++)
+    {
+      int x1 = random() % width;
+      int y1 = random() % height;
+      int w = 1 + random() % (width - x1);
+      int h = 1 + random() % (height - y1);
+
+      for (y = y1; y < y1 + h; y++)
+        for (x = x1; x < x1 + w; x++)
+          image[y * width + x] = (byte)(random() & 3);
+      Overview_invalidate(x1, y1, w, h);
+      ok = Overview_check(image, width, height, errmsg);
+    }
+  }
+  Overview_free();
+  free(image);
+  return ok;
+}
+
+/**
+ * Tests for Convert_to_constrained_mode() and C64_truecolor_to_FLI()
+ */
+int Test_Constrained_conversion(char * errmsg)
+{
+  T_Components palette[256];
+  T_Components * source;
+  byte * pixels;
+  byte bitmap[8000], screen_ram[8192], color_ram[1000], background[200];
+  int x, y, x2, y2;
+  int dither;
+
+  source = (T_Components *)malloc(320 * 200 * sizeof(T_Components));
+  pixels = (byte *)malloc(320 * 200);
+  if (source == NULL || pixels == NULL)
+  {
+    snprintf(errmsg, ERRMSG_LENGTH, "memory allocation error");
+    free(source);
+    free(pixels);
+    return 0;
+  }
+
+  // a picture already respecting the C64 HiRes constraints is not changed
+  C64_set_palette(palette);
+  for (y = 0; y < 200; y += 8)
+    for (x = 0; x < 320; x += 8)
+    {
+      byte c[2];
+      c[0] = random() & 15;
+      c[1] = random() & 15;
+      for (y2 = 0; y2 < 8; y2++)
+        for (x2 = 0; x2 < 8; x2++)
+          source[x + x2 + (y + y2) * 320] = palette[c[random() & 1]];
+    }
+  Convert_to_constrained_mode(IMAGE_MODE_C64HIRES, pixels, 320, source, 320, 320, 200, palette, 0);
+  for (y = 0; y < 200; y++)
+    for (x = 0; x < 320; x++)
+      if (memcmp(palette + pixels[x + y * 320], source + x + y * 320, sizeof(T_Components)) != 0)
+      {
+        snprintf(errmsg, ERRMSG_LENGTH, "C64 HiRes pixel (%d,%d) changed to %u", x, y, pixels[x + y * 320]);
+        free(source);
+        free(pixels);
+        return 0;
+      }
+
+  // random pictures
+  for (y = 0; y < 200; y++)
+    for (x = 0; x < 320; x++)
+    {
+      source[x + y * 320].R = random() & 255;
+      source[x + y * 320].G = random() & 255;
+      source[x + y * 320].B = random() & 255;
+    }
+  for (dither = 0; dither < 2; dither++)
+  {
+    // C64 multicolor : 4x8 blocks with #0 + 3 colors
+    Convert_to_constrained_mode(IMAGE_MODE_C64MULTI, pixels, 160, source, 320, 160, 200, palette, dither);
+    for (y = 0; y < 200; y += 8)
+      for (x = 0; x < 160; x += 4)
+      {
+        word used = 0;
+        for (y2 = 0; y2 < 8; y2++)
+          for (x2 = 0; x2 < 4; x2++)
+            used |= 1 << pixels[x + x2 + (y + y2) * 160];
+        used &= ~1;
+        if (count_set_bits(used) > 3)
+        {
+          snprintf(errmsg, ERRMSG_LENGTH, "C64 multicolor block (%d,%d) uses colors %04x", x, y, used);
+          free(source);
+          free(pixels);
+          return 0;
+        }
+      }
+    // C64 FLI
+    memset(bitmap, 0, sizeof(bitmap));
+    memset(screen_ram, 0, sizeof(screen_ram));
+    C64_truecolor_to_FLI(pixels, 160, color_ram, background, source, 320, palette, dither);
+    if (C64_pixels_to_FLI(bitmap, screen_ram, color_ram, background, pixels, 160, 1) != 0)
+    {
+      snprintf(errmsg, ERRMSG_LENGTH, "C64 FLI conversion doesn't respect the constraints (dither=%d)", dither);
+      free(source);
+      free(pixels);
+      return 0;
+    }
+    // ZX Spectrum : 8x8 blocks with 2 colors of the same brightness
+    memset(palette, 0, sizeof(palette));
+    ZX_Spectrum_set_palette(palette);
+    Convert_to_constrained_mode(IMAGE_MODE_ZX, pixels, 256, source, 320, 256, 192, palette, dither);
+    for (y = 0; y < 192; y += 8)
+      for (x = 0; x < 256; x += 8)
+      {
+        word used = 0;
+        for (y2 = 0; y2 < 8; y2++)
+          for (x2 = 0; x2 < 8; x2++)
+            used |= 1 << pixels[x + x2 + (y + y2) * 256];
+        if (count_set_bits(used) > 2 || ((used & 0xff) != 0 && (used & 0xff00) != 0))
+        {
+          snprintf(errmsg, ERRMSG_LENGTH, "ZX Spectrum block (%d,%d) uses colors %04x", x, y, used);
+          free(source);
+          free(pixels);
+          return 0;
+        }
+      }
+    // Thomson 40 columns : 8x1 blocks with 2 colors
+    MOTO_set_TO7_palette(palette);
+    Convert_to_constrained_mode(IMAGE_MODE_THOMSON, pixels, 320, source, 320, 320, 200, palette, dither);
+    for (y = 0; y < 200; y++)
+      for (x = 0; x < 320; x += 8)
+      {
+        word used = 0;
+        for (x2 = 0; x2 < 8; x2++)
+          used |= 1 << pixels[x + x2 + y * 320];
+        if (count_set_bits(used) > 2)
+        {
+          snprintf(errmsg, ERRMSG_LENGTH, "Thomson block (%d,%d) uses colors %04x", x, y, used);
+          free(source);
+          free(pixels);
+          return 0;
+        }
+      }
+    memset(palette, 0, sizeof(palette));
+    C64_set_palette(palette);
+  }
+  free(source);
+  free(pixels);
+  return 1;
+}
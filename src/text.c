@@ -461,9 +461,72 @@ int TrueType_is_supported()
   #endif
 }
 
+#ifndef NOTTF
+/// Number of TrueType fonts kept open between two renderings
+#define TTF_CACHE_SIZE 4
+
+/// Open TrueType fonts, by name, size and style.
+/// SDL_ttf keeps the glyphs it has rasterized (and their kerning) in
+/// each open font, so the text tool preview only rasterizes the new
+/// characters instead of reloading the font file at each keystroke.
+static struct
+{
+  TTF_Font * Font;
+  const char * Name;  ///< pointer in the font list
+  int Size;
+  int Style;
+  dword Last_use;
+} TTF_cache[TTF_CACHE_SIZE];
+
+static dword TTF_cache_clock = 0;
+
+/// Returns an open font from the cache, opening it if needed.
+/// The font must not be closed by the caller.
+static TTF_Font * Get_TTF_font(const char * name, int size, int style)
+{
+  int i;
+  int lru = 0;
+
+  TTF_cache_clock++;
+  for (i = 0; i < TTF_CACHE_SIZE; i++)
+  {
+    if (TTF_cache[i].Font != NULL && TTF_cache[i].Name == name
+        && TTF_cache[i].Size == size && TTF_cache[i].Style == style)
+    {
+      TTF_cache[i].Last_use = TTF_cache_clock;
+      return TTF_cache[i].Font;
+    }
+    if (TTF_cache[i].Font == NULL)
+      lru = i;
+    else if (TTF_cache[lru].Font != NULL && TTF_cache[i].Last_use < TTF_cache[lru].Last_use)
+      lru = i;
+  }
+  // Replace the least recently used one
+  if (TTF_cache[lru].Font != NULL)
+    TTF_CloseFont(TTF_cache[lru].Font);
+  TTF_cache[lru].Font = TTF_OpenFont(name, size);
+  if (TTF_cache[lru].Font == NULL)
+    return NULL;
+  TTF_SetFontStyle(TTF_cache[lru].Font, style);
+  TTF_cache[lru].Name = name;
+  TTF_cache[lru].Size = size;
+  TTF_cache[lru].Style = style;
+  TTF_cache[lru].Last_use = TTF_cache_clock;
+  return TTF_cache[lru].Font;
+}
+#endif
+
 void Uninit_text(void)
 {
 #ifndef NOTTF
+  int i;
+
+  for (i = 0; i < TTF_CACHE_SIZE; i++)
+  {
+    if (TTF_cache[i].Font != NULL)
+      TTF_CloseFont(TTF_cache[i].Font);
+    TTF_cache[i].Font = NULL;
+  }
   TTF_Quit();
 #if defined(USE_FC)
   FcFini();
@@ -489,20 +552,19 @@ byte *Render_text_TTF(const char *str, int font_number, int size, int antialias,
   SDL_Color fg_color;
   SDL_Color bg_color;
 
-  // Chargement de la fonte
-  font=TTF_OpenFont(Font_name(font_number), size);
-  if (!font)
-  {
-    return NULL;
-  }
-  
   // Style
   style=0;
   if (italic)
     style|=TTF_STYLE_ITALIC;
   if (bold)
     style|=TTF_STYLE_BOLD;
-  TTF_SetFontStyle(font, style);
+
+  // Chargement de la fonte
+  font=Get_TTF_font(Font_name(font_number), size, style);
+  if (!font)
+  {
+    return NULL;
+  }
   
   // Colors: Text will be generated as white on black.
   fg_color.r=fg_color.g=fg_color.b=255;
@@ -528,7 +590,6 @@ byte *Render_text_TTF(const char *str, int font_number, int size, int antialias,
   #endif
   if (!text_surface)
   {
-    TTF_CloseFont(font);
     return NULL;
   }
     
@@ -536,7 +597,6 @@ byte *Render_text_TTF(const char *str, int font_number, int size, int antialias,
   if (!new_brush)
   {
     SDL_FreeSurface(text_surface);
-    TTF_CloseFont(font);
     return NULL;
   }
   
@@ -612,7 +672,6 @@ byte *Render_text_TTF(const char *str, int font_number, int size, int antialias,
   *width=text_surface->w;
   *height=text_surface->h;
   SDL_FreeSurface(text_surface);
-  TTF_CloseFont(font);
   return new_brush;
 }
 #endif
@@ -472,90 +472,57 @@ void Load_TIFF_Sub(T_IO_Context * context, TIFF * tif, unsigned long file_size)
     Set_image_mode(context, mode);
 }
 
-struct memory_buffer
-{
-  char * buffer;
-  unsigned long offset;
-  unsigned long size;
-  unsigned long alloc_size;
-};
-
 tsize_t lTIFF_read(thandle_t p, void * data, tsize_t size)
 {
-  struct memory_buffer * mbuffer = (struct memory_buffer *)p;
+  T_Memory_buffer * mbuffer = (T_Memory_buffer *)p;
   GFX2_Log(GFX2_DEBUG, "lTIFF_read(%p, %p, %u)\n", p, data, size);
-  memcpy(data, mbuffer->buffer + mbuffer->offset, size);
-  mbuffer->offset += size;
-  return size;
+  return Memory_read(mbuffer, data, size);
 }
 
 tsize_t lTIFF_write(thandle_t p, void * data, tsize_t size)
 {
-  struct memory_buffer * mbuffer = (struct memory_buffer *)p;
+  T_Memory_buffer * mbuffer = (T_Memory_buffer *)p;
   GFX2_Log(GFX2_DEBUG, "lTIFF_write(%p, %p, %u)\n", p, data, size);
-  if (mbuffer->offset + size > mbuffer->alloc_size)
+  if (!Memory_write(mbuffer, data, size))
   {
-    char * tmp = realloc(mbuffer->buffer, mbuffer->offset + size + 1024);
-    if (tmp == NULL)
-    {
-      GFX2_Log(GFX2_ERROR, "lTIFF_write() failed to allocate %u bytes of memory\n", mbuffer->offset + size + 1024);
-      return -1;
-    }
-    mbuffer->buffer = tmp;
-    mbuffer->alloc_size = mbuffer->offset + size + 1024;
+    GFX2_Log(GFX2_ERROR, "lTIFF_write() failed to write %u bytes\n", size);
+    return -1;
   }
-  memcpy(mbuffer->buffer + mbuffer->offset, data, size);
-  mbuffer->offset += size;
-  if (mbuffer->offset > mbuffer->size)
-    mbuffer->size = mbuffer->offset;
   return size;
 }
 
 toff_t lTIFF_seek(thandle_t p, toff_t offset, int whence)
 {
-  struct memory_buffer * mbuffer = (struct memory_buffer *)p;
+  T_Memory_buffer * mbuffer = (T_Memory_buffer *)p;
   switch (whence)
   {
     case SEEK_SET:
-      mbuffer->offset = offset;
       break;
     case SEEK_CUR:
-      mbuffer->offset += offset;
+      offset += mbuffer->Offset;
       break;
     case SEEK_END:
-      mbuffer->offset = mbuffer->size - offset;
+      offset += mbuffer->Size;
       break;
     default:
       return -1;
   }
-  GFX2_Log(GFX2_DEBUG, "lTIFF_seek(%p, %u, %d) new offset=%u (size=%u)\n",
-           p, offset, whence, mbuffer->offset, mbuffer->size);
-  if (mbuffer->offset > mbuffer->alloc_size)
+  GFX2_Log(GFX2_DEBUG, "lTIFF_seek(%p, %u, %d) (size=%u)\n",
+           p, offset, whence, mbuffer->Size);
+  if (!Memory_seek(mbuffer, offset))
   {
-    char * tmp = realloc(mbuffer->buffer, mbuffer->offset + 1024);
-    if (tmp == NULL)
-    {
-      GFX2_Log(GFX2_ERROR, "lTIFF_seek() failed to allocate %u bytes of memory\n", mbuffer->offset + 1024);
-      return -1;
-    }
-    mbuffer->buffer = tmp;
-    mbuffer->alloc_size = mbuffer->offset + 1024;
+    GFX2_Log(GFX2_ERROR, "lTIFF_seek() cannot seek to %u\n", offset);
+    return -1;
   }
-  if (mbuffer->offset > mbuffer->size)
-  {
-    memset(mbuffer->buffer + mbuffer->size, 0, mbuffer->offset - mbuffer->size);
-    GFX2_Log(GFX2_ERROR, "  seeking %d bytes after end of buffer, filling with 0s\n", mbuffer->offset - mbuffer->size);
-    mbuffer->size = mbuffer->offset;
-  }
-  return mbuffer->offset;
+  return mbuffer->Offset;
 }
 
 
 toff_t lTIFF_size(thandle_t p)
 {
-  struct memory_buffer * mbuffer = (struct memory_buffer *)p;
-  GFX2_Log(GFX2_DEBUG, "lTIFF_size(%p) = %u\n", p, mbuffer->size);
-  return mbuffer->size;
+  T_Memory_buffer * mbuffer = (T_Memory_buffer *)p;
+  GFX2_Log(GFX2_DEBUG, "lTIFF_size(%p) = %u\n", p, mbuffer->Size);
+  return mbuffer->Size;
 }
 
 int lTIFF_close(thandle_t p)
@@ -566,10 +533,10 @@ int lTIFF_close(thandle_t p)
 
 int lTIFF_map(thandle_t p, void ** base, toff_t * size)
 {
-  struct memory_buffer * mbuffer = (struct memory_buffer *)p;
+  T_Memory_buffer * mbuffer = (T_Memory_buffer *)p;
   GFX2_Log(GFX2_DEBUG, "lTIFF_map(%p, %p, %p)\n", p, base, size);
-  *base = mbuffer->buffer;
-  *size = mbuffer->size;
+  *base = mbuffer->Data;
+  *size = mbuffer->Size;
   return 1;
 }
 
@@ -583,12 +550,9 @@ void lTIFF_unmap(thandle_t p, void *base, toff_t size)
 void Load_TIFF_from_memory(T_IO_Context * context, const void * buffer, unsigned long size)
 {
   TIFF * tif;
-  struct memory_buffer memory_buffer;
+  T_Memory_buffer memory_buffer;
 
-  memory_buffer.buffer = (char *)buffer;
-  memory_buffer.offset = 0;
-  memory_buffer.size = size;
-  memory_buffer.alloc_size = 0; // unused for read
+  Memory_buffer_init_read(&memory_buffer, buffer, size);
 
   TIFF_Init();
   tif = TIFFClientOpen("memory.tiff", "r", &memory_buffer,
@@ -607,9 +571,17 @@ void Load_TIFF(T_IO_Context * context)
   TIFF * tif;
 #if !defined(WIN32)
   FILE * file;
+#else
+  char * filename; // filename with full path
+#endif
 
   File_error = 1;
-
+  if (context->Memory_data != NULL)
+  {
+    Load_TIFF_from_memory(context, context->Memory_data, context->Memory_size);
+    return;
+  }
+#if !defined(WIN32)
   file = Open_file_read(context);
   if (file != NULL)
   {
@@ -623,9 +595,6 @@ void Load_TIFF(T_IO_Context * context)
     fclose(file);
   }
 #else
-  char * filename; // filename with full path
-
-  File_error = 1;
   filename = Filepath_append_to_dir(context->File_directory, context->File_name);
   TIFF_Init();
   tif = TIFFOpen(filename, "r");
@@ -755,12 +724,9 @@ void Save_TIFF_Sub(T_IO_Context * context, TIFF * tif)
 void Save_TIFF_to_memory(T_IO_Context * context, void * * buffer, unsigned long * size)
 {
   TIFF * tif;
-  struct memory_buffer memory_buffer;
+  T_Memory_buffer memory_buffer;
 
-  memory_buffer.buffer = NULL;
-  memory_buffer.offset = 0;
-  memory_buffer.size = 0;
-  memory_buffer.alloc_size = 0;
+  memset(&memory_buffer, 0, sizeof(memory_buffer));
 
   TIFF_Init();
   tif = TIFFClientOpen("memory.tiff", "w", &memory_buffer,
@@ -770,9 +736,11 @@ void Save_TIFF_to_memory(T_IO_Context * context, void * * buffer, unsigned long
   {
     Save_TIFF_Sub(context, tif);
     TIFFClose(tif);
-    *buffer = memory_buffer.buffer;
-    *size = memory_buffer.size;
+    *buffer = memory_buffer.Data;
+    *size = memory_buffer.Size;
   }
+  else
+    free(memory_buffer.Data);
 }
 
 /// Save TIFF
@@ -0,0 +1 @@
+const char SVN_revision[]="";
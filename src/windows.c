@@ -56,6 +56,7 @@
 #include "unicode.h"
 #include "keycodes.h"
 #include "keyboard.h"
+#include "gfx2thread.h"
 
 #ifndef MIN
 #define MIN(a,b) ((a)<(b)?(a):(b))
@@ -1962,25 +1963,42 @@ void Compute_limits(void)
 }
 
 
-// -- Calculer les coordonnées du pinceau en fonction du snap et de la loupe -
-void Compute_paintbrush_coordinates(void)
+/// Position in the image of a mouse position, with the magnifier and the
+/// grid, but without the snap axis.
+static void Mouse_to_paintbrush(word mouse_x, word mouse_y, short * x, short * y)
 {
-  if ((Main.magnifier_mode) && (Mouse_X>=Main.X_zoom))
+  if ((Main.magnifier_mode) && (mouse_x>=Main.X_zoom))
   {
-    Paintbrush_X=((Mouse_X-Main.X_zoom)/Main.magnifier_factor)+Main.magnifier_offset_X;
-    Paintbrush_Y=(Mouse_Y/Main.magnifier_factor)+Main.magnifier_offset_Y;
+    *x=((mouse_x-Main.X_zoom)/Main.magnifier_factor)+Main.magnifier_offset_X;
+    *y=(mouse_y/Main.magnifier_factor)+Main.magnifier_offset_Y;
   }
   else
   {
-    Paintbrush_X=Mouse_X+Main.offset_X;
-    Paintbrush_Y=Mouse_Y+Main.offset_Y;
+    *x=mouse_x+Main.offset_X;
+    *y=mouse_y+Main.offset_Y;
   }
 
   if (Snap_mode)
   {
-    Paintbrush_X=(((Paintbrush_X+(Snap_width>>1)-Snap_offset_X)/Snap_width)*Snap_width)+Snap_offset_X;
-    Paintbrush_Y=(((Paintbrush_Y+(Snap_height>>1)-Snap_offset_Y)/Snap_height)*Snap_height)+Snap_offset_Y;
+    *x=(((*x+(Snap_width>>1)-Snap_offset_X)/Snap_width)*Snap_width)+Snap_offset_X;
+    *y=(((*y+(Snap_height>>1)-Snap_offset_Y)/Snap_height)*Snap_height)+Snap_offset_Y;
   }
+}
+
+void Compute_sample_paintbrush_coordinates(word mouse_x, word mouse_y, short * x, short * y)
+{
+  Mouse_to_paintbrush(mouse_x, mouse_y, x, y);
+  // The axis was chosen from the current position
+  if (Snap_axis==2)
+    *y = Snap_axis_origin_Y;
+  else if (Snap_axis==3)
+    *x = Snap_axis_origin_X;
+}
+
+// -- Calculer les coordonnées du pinceau en fonction du snap et de la loupe -
+void Compute_paintbrush_coordinates(void)
+{
+  Mouse_to_paintbrush(Mouse_X, Mouse_Y, &Paintbrush_X, &Paintbrush_Y);
 
   // Handling the snap axis mode, when shift is pressed.
   switch (Current_operation)
@@ -3019,10 +3037,122 @@ void Hide_cursor(void)
 
   // -- Reafficher toute l'image (en prenant en compte le facteur de zoom) --
 
-void Display_all_screen(void)
+/// Maximum number of threads drawing the picture area
+#define RENDER_MAX_THREADS 16
+/// Minimum number of lines per thread : smaller views are drawn by one thread
+#define RENDER_MIN_BAND_HEIGHT 32
+
+/// A horizontal band of the normal view or of the magnifier
+typedef struct
+{
+  word Width;     ///< number of picture pixels per line
+  word Y_start;   ///< first line of the band
+  word Y_end;     ///< line following the band
+  byte Zoomed;    ///< the band belongs to the magnifier
+  byte * Buffer;  ///< line buffer of the magnifier bands
+} T_Render_band;
+
+/// Draw a band. Runs on a worker thread.
+static int Render_band(void * data)
+{
+  T_Render_band * band = (T_Render_band *)data;
+
+  if (band->Zoomed)
+    Display_zoomed_screen(band->Width, band->Y_start, band->Y_end, Main.image_width, band->Buffer);
+  else
+    Display_screen(band->Width, band->Y_start, band->Y_end, Main.image_width);
+  return 0;
+}
+
+/// Set up nb_bands bands sharing the lines of a view
+static void Split_in_bands(T_Render_band * bands, int nb_bands, word width, word height, byte zoomed)
+{
+  int i;
+
+  for (i = 0; i < nb_bands; i++)
+  {
+    bands[i].Width = width;
+    bands[i].Y_start = (word)((long)height * i / nb_bands);
+    bands[i].Y_end = (word)((long)height * (i + 1) / nb_bands);
+    bands[i].Zoomed = zoomed;
+    bands[i].Buffer = NULL;
+  }
+}
+
+/// Draw the normal view and the magnifier in horizontal bands, each one on
+/// its own thread. The bands write in disjoint parts of the screen buffer.
+/// @param width, height size of the normal view, in picture pixels
+/// @param zoom_width, zoom_height picture pixels per line and lines of the
+///        magnifier, or 0 when it is off
+static void Render_views(word width, word height, word zoom_width, word zoom_height)
+{
+  T_Render_band bands[RENDER_MAX_THREADS];
+  T_GFX2_Thread * threads[RENDER_MAX_THREADS];
+  long area = (long)width * height;
+  long zoom_area = (long)zoom_width * Main.magnifier_factor * zoom_height;
+  size_t buffer_size = Pixel_width * ((Screen_width>Main.image_width)?Screen_width:Main.image_width);
+  int nb_threads = GFX2_CPU_count();
+  int nb_zoom = 0;
+  int i;
+
+  if (nb_threads > RENDER_MAX_THREADS)
+    nb_threads = RENDER_MAX_THREADS;
+  if (nb_threads > (height + zoom_height) / RENDER_MIN_BAND_HEIGHT)
+    nb_threads = (height + zoom_height) / RENDER_MIN_BAND_HEIGHT;
+  if (nb_threads < 2)
+  {
+    Display_screen(width, 0, height, Main.image_width);
+    if (zoom_height > 0)
+      Display_zoomed_screen(zoom_width, 0, zoom_height, Main.image_width, Horizontal_line_buffer);
+    return;
+  }
+  // share the threads according to the number of pixels of each view
+  if (zoom_area > 0)
+  {
+    nb_zoom = (int)((nb_threads * zoom_area + (area + zoom_area) / 2) / (area + zoom_area));
+    if (nb_zoom < 1)
+      nb_zoom = 1;
+    if (nb_zoom > nb_threads - 1 && area > 0)
+      nb_zoom = nb_threads - 1;
+  }
+  Split_in_bands(bands, nb_zoom, zoom_width, zoom_height, 1);
+  Split_in_bands(bands + nb_zoom, nb_threads - nb_zoom, width, height, 0);
+
+  // The first band is drawn by this thread
+  for (i = 0; i < nb_threads; i++)
+  {
+    threads[i] = NULL;
+    if (bands[i].Zoomed)
+      bands[i].Buffer = (i == 0) ? Horizontal_line_buffer : (byte *)malloc(buffer_size);
+    if (i > 0 && (!bands[i].Zoomed || bands[i].Buffer != NULL))
+      threads[i] = GFX2_Thread_create(Render_band, bands + i);
+  }
+  Render_band(bands);
+  for (i = 1; i < nb_threads; i++)
+  {
+    if (threads[i] != NULL)
+      GFX2_Thread_wait(threads[i]);
+    else
+    {
+      if (bands[i].Zoomed && bands[i].Buffer == NULL)
+        bands[i].Buffer = Horizontal_line_buffer;
+      Render_band(bands + i);
+    }
+    if (bands[i].Buffer != Horizontal_line_buffer)
+      free(bands[i].Buffer);
+  }
+}
+
+/// Draw the picture, and the magnifier if any, in the screen buffer
+/// without sending the picture area to the display.
+/// Only the separator and the image limits, which don't depend on the
+/// picture content, are updated on screen.
+void Render_all_screen(void)
 {
   word width;
   word height;
+  word zoom_width = 0;
+  word zoom_height = 0;
 
   // ---/\/\/\  Partie non zoomée: /\/\/\---
   if (Main.magnifier_mode)
@@ -3043,7 +3173,25 @@ void Display_all_screen(void)
     height=Main.image_height;
   else
     height=Menu_Y;
-  Display_screen(width,height,Main.image_width);
+
+  if (Main.magnifier_mode)
+  {
+    // Calcul de la largeur visible
+    if (Main.image_width<Main.magnifier_width)
+      zoom_width=Main.image_width;
+    else
+      zoom_width=Main.magnifier_width;
+
+    // Calcul du nombre de lignes visibles de l'image zoomée
+    if (Main.image_height<Main.magnifier_height)
+      zoom_height=Main.image_height*Main.magnifier_factor;
+    else if (Main.image_height<Main.magnifier_offset_Y+Main.magnifier_height)
+      // Omit "last line" if it's outside picture limits
+      zoom_height=Menu_Y/Main.magnifier_factor*Main.magnifier_factor;
+    else
+      zoom_height=Menu_Y;
+  }
+  Render_views(width,height,zoom_width,zoom_height);
 
   // Effacement de la partie non-image dans la partie non zoomée:
   if (Main.magnifier_mode)
@@ -3065,35 +3213,26 @@ void Display_all_screen(void)
     // Affichage de la barre de split
     Display_separator();
 
-    // Calcul de la largeur visible
-    if (Main.image_width<Main.magnifier_width)
-      width=Main.image_width;
-    else
-      width=Main.magnifier_width;
-
-    // Calcul du nombre de lignes visibles de l'image zoomée
-    if (Main.image_height<Main.magnifier_height)
-      height=Main.image_height*Main.magnifier_factor;
-    else if (Main.image_height<Main.magnifier_offset_Y+Main.magnifier_height)
-      // Omit "last line" if it's outside picture limits
-      height=Menu_Y/Main.magnifier_factor*Main.magnifier_factor;
-    else
-      height=Menu_Y;
-
-    Display_zoomed_screen(width,height,Main.image_width,Horizontal_line_buffer);
+    // The grid is drawn once all the bands are done
+    Redraw_grid(Main.X_zoom,0,zoom_width*Main.magnifier_factor,zoom_height);
 
     // Effacement de la partie non-image dans la partie zoomée:
     if (Main.image_width<Main.magnifier_width)
       Block(Main.X_zoom+(Main.image_width*Main.magnifier_factor),0,
             (Main.magnifier_width-Main.image_width)*Main.magnifier_factor,
             Menu_Y,Main.backups->Pages->Transparent_color);
-    if (height<Menu_Y)
-      Block(Main.X_zoom,height,width*Main.magnifier_factor,(Menu_Y-height),Main.backups->Pages->Transparent_color);
+    if (zoom_height<Menu_Y)
+      Block(Main.X_zoom,zoom_height,zoom_width*Main.magnifier_factor,(Menu_Y-zoom_height),Main.backups->Pages->Transparent_color);
   }
 
   // ---/\/\/\ Affichage des limites /\/\/\---
   if (Config.Display_image_limits)
     Display_image_limits();
+}
+
+void Display_all_screen(void)
+{
+  Render_all_screen();
   Update_rect(0,0,Screen_width,Menu_Y); // TODO On peut faire plus fin, en évitant de mettre à jour la partie à droite du split quand on est en mode loupe. Mais c'est pas vraiment intéressant ?
 }
 
@@ -48,6 +48,10 @@ void Compute_magnifier_data(void);
 void Clip_magnifier_offsets(short *x_offset, short *y_offset);
 void Compute_limits(void);
 void Compute_paintbrush_coordinates(void);
+/// Position in the image of a past cursor position (see ::Input_samples).
+/// Like Compute_paintbrush_coordinates(), but it doesn't change the snap
+/// axis : the axis locked for the current position is applied.
+void Compute_sample_paintbrush_coordinates(word mouse_x, word mouse_y, short * x, short * y);
 
 void Pixel_in_menu(word bar, word x, word y, byte color);
 void Pixel_in_menu_and_skin(word bar, word x, word y, byte color);
@@ -94,6 +98,7 @@ int Dialog_multiple_choice(const char * title, const T_MultipleChoice * choices,
 /** @} */
 
 void Display_image_limits(void);
+void Render_all_screen(void);
 void Display_all_screen(void);
 void Window_rectangle(word x_pos,word y_pos,word width,word height,byte color);
 void Window_display_frame_generic(word x_pos,word y_pos,word width,word height,
@@ -27,6 +27,11 @@
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
 #include <X11/XKBlib.h>
+#ifndef NO_XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+#endif
 #include "screen.h"
 #include "gfx2surface.h"
 #include "loadsave.h"
@@ -40,6 +45,137 @@ static XTextProperty windowName;
 static GC X11_gc = 0;
 static T_GFX2_Surface * screen = NULL;
 static T_GFX2_Surface * icon = NULL;
+/// screen palette, already in the pixel format of X11_image
+static dword X11_palette[256];
+
+#ifndef NO_XSHM
+/// Maximum number of XShmPutImage() not yet completed by the X server
+#define SHM_MAX_PENDING 4
+
+static XShmSegmentInfo X11_shminfo;
+/// X11_image is in shared memory
+static int X11_shm_used = 0;
+static int X11_shm_completion_type = -1;
+static int X11_shm_pending = 0;
+static int X11_shm_error = 0;
+
+static int X11_shm_error_handler(Display * display, XErrorEvent * event)
+{
+  (void)display;
+  (void)event;
+  X11_shm_error = 1;
+  return 0;
+}
+
+/// Create X11_image in a shared memory segment.
+/// @return 0 when MIT-SHM is not usable (remote display, no extension...)
+static int Create_shm_image(Visual * visual, int depth, int width, int height)
+{
+  int (*old_handler)(Display *, XErrorEvent *);
+
+  if (!XShmQueryExtension(X11_display) || getenv("GFX2_NO_XSHM") != NULL)
+    return 0;
+  X11_image = XShmCreateImage(X11_display, visual, depth, ZPixmap, NULL,
+                              &X11_shminfo, width, height);
+  if (X11_image == NULL)
+    return 0;
+  X11_shminfo.shmid = shmget(IPC_PRIVATE, X11_image->bytes_per_line * X11_image->height, IPC_CREAT | 0600);
+  if (X11_shminfo.shmid < 0)
+  {
+    XDestroyImage(X11_image);
+    X11_image = NULL;
+    return 0;
+  }
+  X11_shminfo.shmaddr = X11_image->data = shmat(X11_shminfo.shmid, NULL, 0);
+  X11_shminfo.readOnly = True;
+  if (X11_shminfo.shmaddr == (char *)-1)
+  {
+    shmctl(X11_shminfo.shmid, IPC_RMID, NULL);
+    X11_image->data = NULL;
+    XDestroyImage(X11_image);
+    X11_image = NULL;
+    return 0;
+  }
+  // The attach fails with an X error when the server is on another machine
+  X11_shm_error = 0;
+  old_handler = XSetErrorHandler(X11_shm_error_handler);
+  XShmAttach(X11_display, &X11_shminfo);
+  XSync(X11_display, False);
+  XSetErrorHandler(old_handler);
+  // The segment is destroyed when both sides have detached
+  shmctl(X11_shminfo.shmid, IPC_RMID, NULL);
+  if (X11_shm_error)
+  {
+    GFX2_Log(GFX2_INFO, "X11: XShmAttach() failed, not using MIT-SHM\n");
+    shmdt(X11_shminfo.shmaddr);
+    X11_image->data = NULL;
+    XDestroyImage(X11_image);
+    X11_image = NULL;
+    return 0;
+  }
+  X11_shm_completion_type = XShmGetEventBase(X11_display) + ShmCompletion;
+  X11_shm_pending = 0;
+  X11_shm_used = 1;
+  memset(X11_image->data, 64, X11_image->bytes_per_line * X11_image->height);
+  GFX2_Log(GFX2_DEBUG, "X11: using MIT-SHM\n");
+  return 1;
+}
+
+static Bool Is_shm_completion(Display * display, XEvent * event, XPointer arg)
+{
+  (void)display;
+  (void)arg;
+  return event->type == X11_shm_completion_type;
+}
+
+/// Wait until the X server has less than max_pending images to read
+static void Wait_shm_completion(int max_pending)
+{
+  XEvent event;
+
+  while (X11_shm_pending > 0 && XCheckIfEvent(X11_display, &event, Is_shm_completion, NULL))
+    X11_shm_pending--;
+  while (X11_shm_pending > max_pending)
+  {
+    XIfEvent(X11_display, &event, Is_shm_completion, NULL);
+    X11_shm_pending--;
+  }
+}
+#endif
+
+int X11_Shm_completion(const XEvent * event)
+{
+#ifndef NO_XSHM
+  if (X11_shm_used && event->type == X11_shm_completion_type)
+  {
+    if (X11_shm_pending > 0)
+      X11_shm_pending--;
+    return 1;
+  }
+#else
+  (void)event;
+#endif
+  return 0;
+}
+
+static void Destroy_image(void)
+{
+  if (X11_image == NULL)
+    return;
+#ifndef NO_XSHM
+  if (X11_shm_used)
+  {
+    Wait_shm_completion(0);
+    XShmDetach(X11_display, &X11_shminfo);
+    XSync(X11_display, False);
+    shmdt(X11_shminfo.shmaddr);
+    X11_image->data = NULL;
+    X11_shm_used = 0;
+  }
+#endif
+  XDestroyImage(X11_image);
+  X11_image = NULL;
+}
 
 void GFX2_Set_mode(int *width, int *height, int fullscreen)
 {
@@ -170,10 +306,13 @@ void GFX2_Set_mode(int *width, int *height, int fullscreen)
     screen->pixels = realloc(screen->pixels, *width * *height);
     screen->w = *width;
     screen->h = *height;
-    XDestroyImage(X11_image);
-    X11_image = NULL;
+    Destroy_image();
   }
 
+#ifndef NO_XSHM
+  if (X11_image == NULL)
+    Create_shm_image(visual, depth, *width, *height);
+#endif
   if (X11_image == NULL)
   {
     char * image_pixels = NULL;
@@ -241,12 +380,93 @@ void Screen_FillRect(int x, int y, int w, int h, byte color)
   }
 }
 
+/// Sends a rectangle of X11_image to the window (physical pixels)
+static void Put_image(int x, int y, int width, int height)
+{
+#ifndef NO_XSHM
+  if (X11_shm_used)
+  {
+    XShmPutImage(X11_display, X11_window, X11_gc, X11_image,
+                 x, y, x, y, width, height, True);
+    X11_shm_pending++;
+  }
+  else
+#endif
+  XPutImage(X11_display, X11_window, X11_gc, X11_image,
+            x, y, x, y, width, height);
+}
+
+/// Re-expands only the pixels which use a changed color, and sends the
+/// rectangle that contains them.
+static void Refresh_palette_colors(const byte * changed)
+{
+  int x, y;
+  int min_x = screen->w, max_x = -1;
+  int min_y = screen->h, max_y = -1;
+
+#ifndef NO_XSHM
+  if (X11_shm_used)
+    Wait_shm_completion(SHM_MAX_PENDING - 1);
+#endif
+  for (y = 0; y < screen->h; y++)
+  {
+    const byte * src = screen->pixels + y * screen->w;
+    dword * dest = (dword *)((byte *)X11_image->data + y * X11_image->bytes_per_line);
+    int line_min = -1;
+    int line_max = -1;
+
+    for (x = 0; x < screen->w; x++)
+    {
+      if (changed[src[x]])
+      {
+        dest[x] = X11_palette[src[x]];
+        if (line_min < 0)
+          line_min = x;
+        line_max = x;
+      }
+    }
+    if (line_min >= 0)
+    {
+      if (line_min < min_x)
+        min_x = line_min;
+      if (line_max > max_x)
+        max_x = line_max;
+      if (min_y > y)
+        min_y = y;
+      max_y = y;
+    }
+  }
+  if (max_y >= 0)
+    Put_image(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
+}
+
 int GFX2_SetPalette(const T_Components * colors, int firstcolor, int ncolors)
 {
+  int i;
+  int count = 0;
+  byte changed[256];
+
   if (screen == NULL) return 0;
   memcpy(screen->palette + firstcolor, colors, ncolors * sizeof(T_Components));
-  // update full screen
-  Update_rect(0, 0, screen->w, screen->h);
+  memset(changed, 0, sizeof(changed));
+  for (i = 0; i < ncolors; i++)
+  {
+    dword value;
+    byte * p = (byte *)&value;
+    p[0] = colors[i].B;
+    p[1] = colors[i].G;
+    p[2] = colors[i].R;
+    p[3] = 0;
+    if (X11_palette[firstcolor + i] != value)
+    {
+      X11_palette[firstcolor + i] = value;
+      changed[firstcolor + i] = 1;
+      count++;
+    }
+  }
+  // Only the pixels of the modified colors need to be refreshed
+  if (count > 0 && X11_image != NULL)
+    Refresh_palette_colors(changed);
   return 1;
 }
 
@@ -269,22 +489,27 @@ void Update_rect(short x, short y, unsigned short width, unsigned short height)
     height = screen->h - y;
   if (x + width > screen->w)
     width = screen->w - x;
+#ifndef NO_XSHM
+  if (X11_shm_used)
+    Wait_shm_completion(SHM_MAX_PENDING - 1);
+#endif
   for (line = y; line < y + height; line++)
   {
 #if 1
     const byte * src = Get_Screen_pixel_ptr(x, line);
-    byte * dest = (byte *)X11_image->data + line * X11_image->bytes_per_line + x * 4;
-    i = width;
-    do
+    dword * dest = (dword *)((byte *)X11_image->data + line * X11_image->bytes_per_line + x * 4);
+    // 4 pixels per iteration, through the precomputed palette
+    for (i = width; i >= 4; i -= 4)
     {
-      dest[0] = screen->palette[*src].B;
-      dest[1] = screen->palette[*src].G;
-      dest[2] = screen->palette[*src].R;
-      dest[3] = 0;
-      src++;
+      dest[0] = X11_palette[src[0]];
+      dest[1] = X11_palette[src[1]];
+      dest[2] = X11_palette[src[2]];
+      dest[3] = X11_palette[src[3]];
+      src += 4;
       dest += 4;
     }
-    while(--i > 0);
+    for (; i > 0; i--)
+      *dest++ = X11_palette[*src++];
 #else
     for (i = 0; i < width; i++)
     {
@@ -294,8 +519,7 @@ void Update_rect(short x, short y, unsigned short width, unsigned short height)
     }
 #endif
   }
-  XPutImage(X11_display, X11_window, X11_gc, X11_image,
-            x, y, x, y, width, height);
+  Put_image(x, y, width, height);
   //XPutImage(X11_display, X11_window, X11_gc, X11_image,
   //          0, 0, 0, 0, X11_image->width, X11_image->height);
   //XSync(X11_display, False);